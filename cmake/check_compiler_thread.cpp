@@ -0,0 +1,6 @@
+
+static __thread int counter = 0;
+
+int main() {
+	return counter++;
+}
@@ -45,6 +45,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <limits>
 #include <algorithm>
+#include <utility>
 
 #include <glm/gtx/norm.hpp>
 
@@ -59,6 +60,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 static const float MIN_RADIUS = 110.0f;
 
+// Rooms on routes up to this much longer than the shortest route are searched
+static const float CORRIDOR_DETOUR = 0.25f;
+static const float CORRIDOR_DETOUR_MIN = 500.0f;
+
 #define frnd() (1.0f - 2 * rnd())
 
 const float PathFinder::HEURISTIC_MIN = 0.0f;
@@ -68,133 +73,125 @@ const float PathFinder::HEURISTIC_DEFAULT = 0.5f;
 const float PathFinder::RADIUS_DEFAULT = 0.0f;
 const float PathFinder::HEIGHT_DEFAULT = 0.0f;
 
-class PathFinder::Node {
-	
-	NodeId id;
-	const Node * parent;
-	
-	float cost;
-	float distance;
-	
-public:
-	
-	Node(long _id, const Node * _parent, float _distance, float _remaining)
-		: id(_id), parent(_parent), cost(_distance + _remaining), distance(_distance) { }
-	
-	inline NodeId getId() const {
-		return id;
-	}
+static const size_t CLOSED = size_t(-1);
+static const PathFinder::NodeId NO_PARENT = PathFinder::NodeId(-1);
+
+PathFinder::PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
+                       size_t slight_count, const EERIE_LIGHT * const * slight_list)
+	: radius(RADIUS_DEFAULT), height(HEIGHT_DEFAULT), heuristic(HEURISTIC_DEFAULT),
+	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list),
+	  m_treeUse(0), m_lights(NULL), m_rooms(NULL), m_corridorPruned(false) { }
+
+void PathFinder::setLightMap(const LightMap * lights) {
+	m_lights = lights;
+}
+
+void PathFinder::setRoomMap(const RoomMap * rooms) {
+	m_rooms = rooms;
+}
+
+void PathFinder::Search::begin(size_t map_size) {
 	
-	inline const Node * getParent() const {
-		return parent;
-	}
+	m_open.clear();
 	
-	inline float getCost() const {
-		return cost;
+	if(m_nodes.size() != map_size || ++m_id == 0) {
+		// Generation counter wrapped around or map changed - reset all nodes
+		Node node = { 0, NO_PARENT, 0.0f, 0.0f, CLOSED };
+		m_nodes.assign(map_size, node);
+		m_id = 1;
 	}
+}
+
+void PathFinder::Search::setOpen(size_t index, NodeId id) {
+	m_open[index] = id;
+	m_nodes[id].index = index;
+}
+
+void PathFinder::Search::siftUp(size_t index) {
 	
-	inline float getDistance() const {
-		return distance;
-	}
+	NodeId id = m_open[index];
+	float cost = m_nodes[id].cost;
 	
-	inline void newParent(const Node * _parent, float _distance) {
-		parent = _parent;
-		cost = cost - distance + _distance;
-		distance = _distance;
+	while(index > 0) {
+		size_t parent = (index - 1) / 2;
+		if(!(cost < m_nodes[m_open[parent]].cost)) {
+			break;
+		}
+		setOpen(index, m_open[parent]);
+		index = parent;
 	}
 	
-};
+	setOpen(index, id);
+}
 
-class PathFinder::OpenNodeList {
+void PathFinder::Search::siftDown(size_t index) {
 	
-	typedef std::vector<Node*> NodeList;
-	NodeList nodes;
+	NodeId id = m_open[index];
+	float cost = m_nodes[id].cost;
 	
-public:
-	
-	~OpenNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
-		}
-	}
-	
-	/*!
-	 * If a node with the same ID exists, update it.
-	 * Otherwise add a new node.
-	 * Assumes that remaining never changes for the same node id.
-	 */
-	inline void add(NodeId id, const Node * parent, float distance, float remaining) {
-		
-		// Check if node is already in open list.
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				if((*i)->getDistance() > distance) {
-					(*i)->newParent(parent, distance);
-				}
-				return;
-			}
+	size_t count = m_open.size();
+	while(true) {
+		size_t child = index * 2 + 1;
+		if(child >= count) {
+			break;
 		}
-		
-		nodes.push_back(new Node(id, parent, distance, remaining));
-	}
-	
-	Node * extractBestNode() {
-		// TODO use a better datastructure
-		
-		if(nodes.empty()) {
-			return NULL;
+		if(child + 1 < count && m_nodes[m_open[child + 1]].cost < m_nodes[m_open[child]].cost) {
+			child++;
 		}
-		
-		NodeList::iterator best = nodes.begin();
-		float cost = std::numeric_limits<float>::max();
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getCost() < cost) {
-				cost = (*i)->getCost();
-				best = i;
-			}
+		if(!(m_nodes[m_open[child]].cost < cost)) {
+			break;
 		}
-		
-		Node * node = *best;
-		nodes.erase(best);
-		
-		return node;
+		setOpen(index, m_open[child]);
+		index = child;
 	}
 	
-};
+	setOpen(index, id);
+}
 
-class PathFinder::ClosedNodeList {
-	
-	typedef std::vector<Node*> NodeList;
-	NodeList nodes;
-	
-public:
-	
-	~ClosedNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
-		}
+void PathFinder::Search::add(NodeId id, NodeId parent, float distance, float remaining) {
+	
+	Node & node = m_nodes[id];
+	
+	if(node.search != m_id) {
+		node.search = m_id;
+		node.parent = parent;
+		node.cost = distance + remaining;
+		node.distance = distance;
+		m_open.push_back(id);
+		siftUp(m_open.size() - 1);
+		return;
 	}
 	
-	void add(Node * node) {
-		nodes.push_back(node);
+	if(node.index != CLOSED && node.distance > distance) {
+		node.parent = parent;
+		node.cost = node.cost - node.distance + distance;
+		node.distance = distance;
+		siftUp(node.index);
 	}
+}
+
+bool PathFinder::Search::isClosed(NodeId id) const {
+	return m_nodes[id].search == m_id && m_nodes[id].index == CLOSED;
+}
+
+bool PathFinder::Search::extractBestNode(NodeId & id) {
 	
-	bool contains(NodeId id) const {
-		// TODO better datastructure: set of closed node ids
-		for(NodeList::const_iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				return true;
-			}
-		}
+	if(m_open.empty()) {
 		return false;
 	}
 	
-};
-
-PathFinder::PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
-                       size_t slight_count, const EERIE_LIGHT * const * slight_list)
-	: radius(RADIUS_DEFAULT), height(HEIGHT_DEFAULT), heuristic(HEURISTIC_DEFAULT),
-	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list) { }
+	id = m_open.front();
+	m_nodes[id].index = CLOSED;
+	
+	NodeId last = m_open.back();
+	m_open.pop_back();
+	if(!m_open.empty()) {
+		setOpen(0, last);
+		siftDown(0);
+	}
+	
+	return true;
+}
 
 void PathFinder::setHeuristic(float _heuristic) {
 	if(_heuristic >= HEURISTIC_MAX) {
@@ -211,6 +208,55 @@ void PathFinder::setCylinder(float _radius, float _height) {
 	height = _height;
 }
 
+bool PathFinder::findCorridor(NodeId from, NodeId to) const {
+	
+	const RoomMap & rooms = *m_rooms;
+	
+	long from_room = rooms.nodeRooms[from];
+	long to_room = rooms.nodeRooms[to];
+	if(from_room < 0 || to_room < 0 || from_room == to_room) {
+		return false;
+	}
+	
+	const float * from_distances = &rooms.distances[from_room * rooms.roomCount];
+	if(from_distances[to_room] < 0.f) {
+		return false;
+	}
+	
+	// Room distances are between portals - add the way from and to the nodes
+	float anchors = rooms.nodePortalDistances[from] + rooms.nodePortalDistances[to];
+	float distance = anchors + from_distances[to_room];
+	
+	// Allow detours through other rooms in case the shortest route is blocked
+	float bound = distance * (1.f + CORRIDOR_DETOUR) + CORRIDOR_DETOUR_MIN;
+	
+	m_corridor.assign(rooms.roomCount, 0);
+	for(size_t room = 0; room < rooms.roomCount; room++) {
+		float to_distance = rooms.distances[room * rooms.roomCount + to_room];
+		if(from_distances[room] >= 0.f && to_distance >= 0.f
+		   && anchors + from_distances[room] + to_distance <= bound) {
+			m_corridor[room] = 1;
+		}
+	}
+	m_corridor[from_room] = m_corridor[to_room] = 1;
+	
+	return true;
+}
+
+bool PathFinder::isPassable(NodeId id) const {
+	return !(map_d[id].flags & ANCHOR_FLAG_BLOCKED) && map_d[id].height <= height
+	       && map_d[id].radius >= radius;
+}
+
+bool PathFinder::isLinked(NodeId from, NodeId to) const {
+	for(short i = 0; i < map_d[from].nblinked; i++) {
+		if(NodeId(map_d[from].linked[i]) == to) {
+			return true;
+		}
+	}
+	return false;
+}
+
 bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) const {
 	
 	if(from == to) {
@@ -218,25 +264,38 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 		return true;
 	}
 	
-	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
+	bool corridor = m_rooms && findCorridor(from, to);
+	
+	if(corridor) {
+		if(search(from, to, rlist, stealth, true)) {
+			return true;
+		}
+		// The rooms on the shorter routes may be blocked - search the whole map unless
+		// the corridor did not leave out any reachable nodes
+		if(!m_corridorPruned) {
+			return false;
+		}
 	}
 	
+	return search(from, to, rlist, stealth, false);
+}
+
+bool PathFinder::search(NodeId from, NodeId to, Result & rlist, bool stealth,
+                        bool corridor) const {
+	
+	// Create start node and put it on open list
+	m_search.begin(map_s);
+	m_search.add(from, NO_PARENT, 0.0f, 0.0f);
+	m_corridorPruned = false;
+	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
-	do {
-		
-		// Put node onto close list as we have now examined this node.
-		close.add(node);
-		
-		NodeId nid = node->getId();
+	// The best node is put onto the closed list as we are now examining it.
+	NodeId nid;
+	while(m_search.extractBestNode(nid)) {
 		
 		// If it's the goal node then we're done.
 		if(nid == to) {
-			buildPath(*node, rlist);
+			buildPath(m_search, nid, rlist);
 			return true;
 		}
 		
@@ -245,36 +304,129 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 			
 			NodeId cid = map_d[nid].linked[i];
 			
-			if((map_d[cid].flags & ANCHOR_FLAG_BLOCKED) || map_d[cid].height > height
-			   || map_d[cid].radius < radius) {
+			if(!isPassable(cid)) {
+				continue;
+			}
+			
+			if(m_search.isClosed(cid)) {
 				continue;
 			}
 			
-			if(close.contains(cid)) {
+			if(corridor && m_rooms->nodeRooms[cid] >= 0 && !m_corridor[m_rooms->nodeRooms[cid]]) {
+				m_corridorPruned = true;
 				continue;
 			}
 			
 			// Cost to reach this node.
 			float distance = fdist(map_d[cid].pos, map_d[nid].pos);
 			if(stealth) {
-				distance += getIlluminationCost(map_d[cid].pos);
+				distance += getIlluminationCost(cid);
 			}
 			distance *= heuristic;
-			distance += node->getDistance();
+			distance += m_search[nid].distance;
 			
 			// Estimated cost to get from this node to the destination.
 			float remaining = (1.0f - heuristic) * fdist(map_d[cid].pos, map_d[to].pos);
 			
-			open.add(cid, node, distance, remaining);
+			m_search.add(cid, nid, distance, remaining);
 		}
-	
-		node = open.extractBestNode();
-	} while(node);
+		
+	}
 	
 	// No path found!
 	return false;
 }
 
+bool PathFinder::moveTo(NodeId from, NodeId to, Result & rlist, unsigned long version,
+                        bool create) const {
+	
+	static const size_t MAX_TREES = 4;
+	
+	if(from == to) {
+		rlist.push_back(to);
+		return true;
+	}
+	
+	// The start node is not checked by move() but the backwards search only reaches
+	// passable nodes
+	if(!isPassable(from) || !isPassable(to)) {
+		return move(from, to, rlist);
+	}
+	
+	Tree * tree = NULL;
+	for(TreeList::iterator i = m_trees.begin(); i != m_trees.end(); ++i) {
+		if(i->to == to && i->radius == radius && i->height == height && i->version == version) {
+			tree = &*i;
+			break;
+		}
+	}
+	
+	if(!tree) {
+		
+		if(!create) {
+			return move(from, to, rlist);
+		}
+		
+		if(m_trees.size() < MAX_TREES) {
+			m_trees.resize(m_trees.size() + 1);
+			tree = &m_trees.back();
+		} else {
+			tree = &m_trees.front();
+			for(TreeList::iterator i = m_trees.begin(); i != m_trees.end(); ++i) {
+				if(i->used < tree->used) {
+					tree = &*i;
+				}
+			}
+		}
+		
+		tree->to = to;
+		tree->from = from;
+		tree->radius = radius;
+		tree->height = height;
+		tree->version = version;
+		tree->search.begin(map_s);
+		tree->search.add(to, NO_PARENT, 0.0f, fdist(map_d[to].pos, map_d[from].pos));
+	}
+	
+	tree->used = ++m_treeUse;
+	
+	Search & search = tree->search;
+	
+	// Continue the search until the start node is reached.
+	// As the heuristic is consistent, the distance of closed nodes is final even
+	// though it is for the start node of the first request.
+	const Vec3f & target = map_d[tree->from].pos;
+	while(!search.isClosed(from)) {
+		
+		NodeId nid;
+		if(!search.extractBestNode(nid)) {
+			// No path found!
+			return false;
+		}
+		
+		for(short i = 0; i < map_d[nid].nblinked; i++) {
+			
+			NodeId cid = map_d[nid].linked[i];
+			
+			if(!isPassable(cid) || search.isClosed(cid) || !isLinked(cid, nid)) {
+				continue;
+			}
+			
+			float distance = search[nid].distance + fdist(map_d[cid].pos, map_d[nid].pos);
+			
+			search.add(cid, nid, distance, fdist(map_d[cid].pos, target));
+		}
+		
+	}
+	
+	// Parents point towards the destination, so the path is already in order.
+	for(NodeId next = from; next != NO_PARENT; next = search[next].parent) {
+		rlist.push_back(next);
+	}
+	
+	return true;
+}
+
 bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result & rlist,
                       bool stealth) const {
 	
@@ -286,56 +438,47 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 	}
 	
 	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
-	}
+	m_search.begin(map_s);
+	m_search.add(from, NO_PARENT, 0.0f, 0.0f);
 	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
-	do {
-		
-		// Put node onto close list as we have now examined this node.
-		close.add(node);
+	// The best node is put onto the closed list as we are now examining it.
+	NodeId nid;
+	while(m_search.extractBestNode(nid)) {
 		
 		// If it's the goal node then we're done.
-		if(node->getCost() == node->getDistance()) {
-			buildPath(*node, rlist);
+		if(m_search[nid].cost == m_search[nid].distance) {
+			buildPath(m_search, nid, rlist);
 			return true;
 		}
 		
-		NodeId nid = node->getId();
-		
 		// Otherwise, generate child from current node.
 		for(short i(0); i < map_d[nid].nblinked; i++) {
 			
 			long cid = map_d[nid].linked[i];
 			
-			if((map_d[cid].flags & ANCHOR_FLAG_BLOCKED) || map_d[cid].height > height
-			   || map_d[cid].radius < radius) {
+			if(!isPassable(cid)) {
 				continue;
 			}
 			
-			if(close.contains(cid)) {
+			if(m_search.isClosed(cid)) {
 				continue;
 			}
 			
 			// Cost to reach this node.
-			float distance = node->getDistance() + fdist(map_d[cid].pos, map_d[nid].pos);
+			float distance = m_search[nid].distance + fdist(map_d[cid].pos, map_d[nid].pos);
 			if(stealth) {
-				distance += getIlluminationCost(map_d[cid].pos);
+				distance += getIlluminationCost(cid);
 			}
 			
 			// Estimated cost to get from this node to the destination.
 			float remaining = std::max(0.0f, safeDist - fdist(map_d[cid].pos, danger));
 			remaining *= FLEE_DISTANCE_COST;
 			
-			open.add(cid, node, distance, remaining);
+			m_search.add(cid, nid, distance, remaining);
 		}
 		
-		node = open.extractBestNode();
-	} while(node);
+	}
 	
 	// No path found!
 	return false;
@@ -451,49 +594,117 @@ bool PathFinder::lookFor(NodeId from, const Vec3f & pos, float radius, Result &
 	return true;
 }
 
-void PathFinder::buildPath(const Node & node, Result & rlist) {
-	
-	const Node * next = &node;
+void PathFinder::buildPath(const Search & search, NodeId id, Result & rlist) {
 	
 	size_t s = rlist.size();
 	
-	while(next) {
-		rlist.push_back(next->getId());
-		next = next->getParent();
+	for(NodeId next = id; next != NO_PARENT; next = search[next].parent) {
+		rlist.push_back(next);
 	}
 	
 	std::reverse(rlist.begin() + s, rlist.end());
 }
 
-float PathFinder::getIlluminationCost(const Vec3f & pos) const {
+namespace {
+
+struct NodeXCompare {
+	
+	const ANCHOR_DATA * map_d;
+	
+	explicit NodeXCompare(const ANCHOR_DATA * _map_d) : map_d(_map_d) { }
+	
+	bool operator()(PathFinder::NodeId a, PathFinder::NodeId b) const {
+		return map_d[a].pos.x < map_d[b].pos.x;
+	}
+	
+	bool operator()(PathFinder::NodeId a, float x) const {
+		return map_d[a].pos.x < x;
+	}
+	
+};
+
+} // anonymous namespace
+
+void PathFinder::buildLightMap(LightMap & lights) const {
 	
 	static const float STEALTH_LIGHT_COST = 300.0F;
 	
-	float cost = 0.0f;
+	// Sort nodes along the x axis so that only nodes near each light need to be checked
+	std::vector<NodeId> sorted(map_s);
+	for(size_t i = 0; i < map_s; i++) {
+		sorted[i] = i;
+	}
+	std::sort(sorted.begin(), sorted.end(), NodeXCompare(map_d));
+	
+	typedef std::vector< std::pair<NodeId, LightCost> > NodeLightCosts;
+	NodeLightCosts costs;
 	
 	for(size_t i = 0; i < slight_c; i++) {
 		
-		if(!slight_l[i] || !slight_l[i]->exist || !slight_l[i]->m_ignitionStatus) {
+		if(!slight_l[i]) {
 			continue;
 		}
 		
 		const EERIE_LIGHT & light = *slight_l[i];
 		
-		float dist = fdist(light.pos, pos);
-		
-		if(dist <= light.fallend) {
-			
-			float l_cost = STEALTH_LIGHT_COST;
+		std::vector<NodeId>::const_iterator it;
+		it = std::lower_bound(sorted.begin(), sorted.end(), light.pos.x - light.fallend,
+		                      NodeXCompare(map_d));
+		for(; it != sorted.end() && map_d[*it].pos.x <= light.pos.x + light.fallend; ++it) {
 			
-			l_cost *= light.intensity * (light.rgb.r + light.rgb.g + light.rgb.b) * (1.0f / 3);
+			float dist = fdist(light.pos, map_d[*it].pos);
 			
-			if(dist > light.fallstart) {
-				l_cost *= ((dist - light.fallstart) / (light.fallend - light.fallstart));
+			if(dist <= light.fallend) {
+				
+				float l_cost = STEALTH_LIGHT_COST;
+				
+				l_cost *= light.intensity * (light.rgb.r + light.rgb.g + light.rgb.b) * (1.0f / 3);
+				
+				if(dist > light.fallstart) {
+					l_cost *= ((dist - light.fallstart) / (light.fallend - light.fallstart));
+				}
+				
+				LightCost cost = { i, l_cost };
+				costs.push_back(std::make_pair(*it, cost));
 			}
-			
-			cost += l_cost;
 		}
 	}
 	
+	// Group by node, keeping lights in order
+	lights.start.assign(map_s + 1, 0);
+	for(NodeLightCosts::const_iterator i = costs.begin(); i != costs.end(); ++i) {
+		lights.start[i->first + 1]++;
+	}
+	for(size_t i = 0; i < map_s; i++) {
+		lights.start[i + 1] += lights.start[i];
+	}
+	
+	lights.costs.resize(costs.size());
+	std::vector<size_t> next(lights.start.begin(), lights.start.end() - 1);
+	for(NodeLightCosts::const_iterator i = costs.begin(); i != costs.end(); ++i) {
+		lights.costs[next[i->first]++] = i->second;
+	}
+}
+
+float PathFinder::getIlluminationCost(NodeId id) const {
+	
+	if(!m_lights) {
+		buildLightMap(m_ownLights);
+		m_lights = &m_ownLights;
+	}
+	
+	float cost = 0.0f;
+	
+	for(size_t i = m_lights->start[id]; i < m_lights->start[id + 1]; i++) {
+		
+		const EERIE_LIGHT * light = slight_l[m_lights->costs[i].light];
+		
+		if(!light || !light->exist || !light->m_ignitionStatus) {
+			continue;
+		}
+		
+		cost += m_lights->costs[i].cost;
+	}
+	
 	return cost;
 }
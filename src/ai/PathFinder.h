@@ -68,6 +68,8 @@ public:
 	 * Create a PathFinder instance for the provided data.
 	 * The pathfinder instance does not copy the provided data and will not clean it up
 	 * The light data is only used when the stealth parameter is set to true.
+	 * Search state is kept in the instance and reused between searches, so a single
+	 * instance must not be used by multiple threads at the same time.
 	 */
 	PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
 	           size_t light_count, const EERIE_LIGHT * const * light_list);
@@ -75,6 +77,69 @@ public:
 	typedef unsigned long NodeId;
 	typedef std::vector<NodeId> Result;
 	
+	//! Rooms used to narrow down searches between different rooms
+	struct RoomMap {
+		
+		size_t roomCount;
+		
+		std::vector<long> nodeRooms; //!< Room of each map node or -1 if unknown
+		
+		/*!
+		 * Length of the shortest route through portals between two rooms,
+		 * at [from_room * roomCount + to_room]. 0 for the same or adjacent rooms
+		 * and negative if there is no known route.
+		 */
+		std::vector<float> distances;
+		
+		/*!
+		 * Distance from each map node to the closest portal of its room,
+		 * as the room distances do not include the way to and from the portals.
+		 */
+		std::vector<float> nodePortalDistances;
+		
+	};
+	
+	/*!
+	 * Set rooms to narrow down move() between nodes in different rooms.
+	 * Only nodes in rooms that lie on a route not much longer than the shortest route
+	 * between the start and destination rooms are considered, as well as nodes
+	 * without a room. If no path is found that way or the rooms are not connected,
+	 * the whole map is searched.
+	 * The room map is not copied and must stay valid while the PathFinder is used.
+	 */
+	void setRoomMap(const RoomMap * rooms);
+	
+	//! Cost for passing through a light when it is on
+	struct LightCost {
+		size_t light;
+		float cost;
+	};
+	
+	typedef std::vector<LightCost> LightCostList;
+	typedef std::vector<size_t> LightCostIndex;
+	
+	//! Lights reaching each map node, used for stealth searches
+	struct LightMap {
+		LightCostList costs; //!< Lights reaching each map node, sorted by node
+		LightCostIndex start; //!< First entry in costs for each map node
+	};
+	
+	/*!
+	 * Find the lights that reach each node.
+	 * Static lights are assumed not to move or change their range or color after the
+	 * level has been loaded - only whether a light is on is checked for each search.
+	 * This must not be called before the lights are loaded.
+	 */
+	void buildLightMap(LightMap & lights) const;
+	
+	/*!
+	 * Set the lights used by stealth searches, so that they can be shared between
+	 * PathFinder instances. Otherwise, each instance builds its own light map
+	 * on the first stealth search.
+	 * The light map is not copied and must stay valid while the PathFinder is used.
+	 */
+	void setLightMap(const LightMap * lights);
+	
 	/*!
 	 * Set a heuristic for selecting the best next node.
 	 * For 0.0f only the distance to the target will be considered.
@@ -100,6 +165,25 @@ public:
 	 */
 	bool move(NodeId from, NodeId to, Result & rlist, bool stealth = false) const;
 	
+	/*!
+	 * Find a path between two nodes, sharing the search with other paths to the same node.
+	 * The search runs backwards from the destination and is saved, so later requests
+	 * with the same destination and cylinder only need to continue it until their
+	 * start node is reached. A few searches are kept, the least recently used one is
+	 * replaced. Paths are always the shortest ones and do not depend on the heuristic.
+	 * Light sources are not considered.
+	 * \param from The index of the start node into the provided map_data.
+	 * \param to The index of the destination node into the provided map_data.
+	 * \param rlist A list to append the path to.
+	 * \param version Identifies the blocked state of the map data, saved searches
+	 *                for a different version are discarded.
+	 * \param create Save a new search if there is none for this destination.
+	 *               Otherwise move() is used if no saved search can be continued.
+	 * \return true if a path was found.
+	 */
+	bool moveTo(NodeId from, NodeId to, Result & rlist, unsigned long version,
+	            bool create) const;
+	
 	/*!
 	 * Find a path away from a position.
 	 * \param from The index of the start node into the provided map_data.
@@ -134,15 +218,84 @@ public:
 	
 private:
 	
-	class Node;
-	class OpenNodeList;
-	class ClosedNodeList;
+	//! Search state for one node, only valid if search matches the current search
+	struct Node {
+		unsigned long search;
+		NodeId parent;
+		float cost;
+		float distance;
+		size_t index; //!< Position in the open heap or CLOSED
+	};
+	
+	typedef std::vector<Node> NodeList;
+	typedef std::vector<NodeId> OpenList;
+	
+	//! State of an A* search - node data is kept and reused between searches
+	class Search {
+		
+		NodeList m_nodes; // Search state for each map node
+		OpenList m_open; // Binary heap of open nodes, ordered by cost
+		unsigned long m_id; // Current search generation
+		
+		void siftUp(size_t index);
+		void siftDown(size_t index);
+		void setOpen(size_t index, NodeId id);
+		
+	public:
+		
+		Search() : m_id(0) { }
+		
+		//! Reset the search state, invalidating all nodes
+		void begin(size_t map_size);
+		
+		/*!
+		 * If the node is already in the open list, update it if the new distance is shorter.
+		 * Otherwise add a new node.
+		 * Assumes that remaining never changes for the same node id.
+		 */
+		void add(NodeId id, NodeId parent, float distance, float remaining);
+		
+		bool isClosed(NodeId id) const;
+		
+		/*!
+		 * Remove the best node (lowest cost) from the open list and put it onto the closed list.
+		 * \return false if the open list is empty
+		 */
+		bool extractBestNode(NodeId & id);
+		
+		const Node & operator[](NodeId id) const { return m_nodes[id]; }
+		
+	};
+	
+	//! Saved backwards search from a destination, see moveTo()
+	struct Tree {
+		Search search;
+		NodeId to;
+		NodeId from; // Start node of the first request, used for the heuristic
+		float radius;
+		float height;
+		unsigned long version;
+		unsigned long used;
+	};
+	
+	typedef std::vector<Tree> TreeList;
+	
+	bool search(NodeId from, NodeId to, Result & rlist, bool stealth, bool corridor) const;
 	
 	/*!
-	 * \return the best node (lowest cost) from open list or NULL if the list is empty
+	 * Mark the rooms on routes between the rooms of two nodes in m_corridor.
+	 * \return false if the nodes are in the same room or there is no known route
+	 *         between their rooms.
 	 */
-	static void buildPath(const Node & node, Result & rlist);
-	float getIlluminationCost(const Vec3f & pos) const;
+	bool findCorridor(NodeId from, NodeId to) const;
+	
+	bool isPassable(NodeId id) const;
+	bool isLinked(NodeId from, NodeId to) const;
+	
+	static void buildPath(const Search & search, NodeId id, Result & rlist);
+	
+	float getIlluminationCost(NodeId id) const;
+	
 	NodeId getNearestNode(const Vec3f & pos) const;
 	
 	float radius;
@@ -154,6 +307,18 @@ private:
 	size_t slight_c; // Light count
 	const EERIE_LIGHT * const * slight_l; // Light data
 	
+	mutable Search m_search;
+	
+	mutable TreeList m_trees; // Saved backwards searches
+	mutable unsigned long m_treeUse; // Counter to find the least recently used tree
+	
+	mutable const LightMap * m_lights; // Lights used for stealth searches
+	mutable LightMap m_ownLights; // Built on first use if no light map has been set
+	
+	const RoomMap * m_rooms;
+	mutable std::vector<char> m_corridor; // Rooms that may be used by the current search
+	mutable bool m_corridorPruned; // The last search skipped nodes outside of m_corridor
+	
 };
 
 #endif // ARX_AI_PATHFINDER_H
@@ -49,16 +49,25 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
+#include <deque>
+#include <sstream>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
 
 #include "ai/PathFinder.h"
 #include "game/Entity.h"
 #include "game/NPC.h"
 #include "graphics/Math.h"
+#include "graphics/data/Mesh.h"
+#include "platform/OS.h"
 #include "platform/Thread.h"
 #include "platform/Lock.h"
+#include "platform/Semaphore.h"
 #include "platform/profiler/Profiler.h"
 #include "physics/Anchors.h"
 #include "scene/Light.h"
+#include "scene/Scene.h"
 
 static const float PATHFINDER_HEURISTIC_MIN = 0.2f;
 static const float PATHFINDER_HEURISTIC_MAX = PathFinder::HEURISTIC_MAX;
@@ -67,109 +76,103 @@ static const float PATHFINDER_HEURISTIC_RANGE = PATHFINDER_HEURISTIC_MAX
 static const float PATHFINDER_DISTANCE_MAX = 5000.0f;
 
 // Pathfinder Definitions
-static unsigned long PATHFINDER_UPDATE_INTERVAL = 10;
+static const unsigned PATHFINDER_WORKERS_MAX = 4;
 
 long PATHFINDER_WORKING = 0;
 
-class PathFinderThread : public StoppableThread {
+class PathFinderThread : public Thread {
 	
 	void run();
 	
 };
 
-static PathFinderThread * pathfinder = NULL;
-static Lock * mutex = NULL;
-
 struct PATHFINDER_QUEUE_ELEMENT {
 	PATHFINDER_REQUEST req;
-	PATHFINDER_QUEUE_ELEMENT * next;
-	long valid;
+	unsigned long id;
+	unsigned long version; // Blocked state of the anchors when the request was started
+	bool shared; // Other requests to the same anchor are queued
+	// Copy of the IO state when the request was added - worker threads must not access the IO
+	Behaviour behavior;
+	float behavior_param;
+	Cylinder cylinder;
+	Vec3f pos;
+	Vec3f target;
 };
 
-static PATHFINDER_QUEUE_ELEMENT * pathfinder_queue_start = NULL;
+struct PATHFINDER_RESULT {
+	PATHFINDER_REQUEST req;
+	unsigned long id;
+	long * list;
+	long count;
+};
 
-// An Io can request Pathfinding only once so we insure that it's always the case.
-// A new pathfinder request from the same IO will overwrite the precedent.
-static PATHFINDER_QUEUE_ELEMENT * PATHFINDER_Find_ioid(Entity * io) {
-	
-	if(!pathfinder_queue_start)
-		return NULL;
+typedef std::deque<PATHFINDER_QUEUE_ELEMENT> PathFinderQueue;
+typedef std::vector<PATHFINDER_RESULT> PathFinderResults;
+typedef boost::unordered_map<const Entity *, unsigned long> PathFinderRequestIds;
 
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
+static std::vector<PathFinderThread *> pathfinders;
+static Lock * mutex = NULL;
+static Semaphore * available = NULL;
+static bool stopping = false;
 
-	while(cur) {
-		if(cur->req.ioid == io)
-			return cur->valid ? cur : NULL;
-		
-		cur = cur->next;
-	}
+static PathFinder::RoomMap * pathfinder_rooms = NULL;
 
-	return NULL;
-}
+// Lights for stealth searches, shared by all threads so that they use the same snapshot.
+// EERIE_PATHFINDER_Create() is called before the level lights are loaded, so this is
+// built by the first stealth search after that and only dropped with the pathfinder.
+static PathFinder::LightMap * pathfinder_lights = NULL;
+static Lock * lights_mutex = NULL;
+
+static PathFinderQueue pathfinder_queue;
+static PathFinderResults pathfinder_results;
+
+// Id of the latest request for each IO - results for older requests are dropped.
+static PathFinderRequestIds pathfinder_request_ids;
+static unsigned long pathfinder_last_request_id = 0;
+
+// Incremented when anchors get blocked or unblocked, to discard saved searches
+static unsigned long pathfinder_anchors_version = 0;
 
 // Adds a Pathfinder Search Element to the pathfinder queue.
 bool EERIE_PATHFINDER_Add_To_Queue(const PATHFINDER_REQUEST & req) {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return false;
 	}
 	
 	Autolock lock(mutex);
-
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	PATHFINDER_QUEUE_ELEMENT * temp;
-
-	// If this NPC is already requesting a Pathfinding then either
-	// try to Override it or add it to queue if it is currently being
-	// processed.
-	temp = PATHFINDER_Find_ioid(req.ioid);
-
-	if(temp && temp->valid && temp != pathfinder_queue_start) {
-		temp->valid = 0;
-		temp->req = req;
-		temp->valid = 1;
-		return true;
-	}
-
-	// Create a New element for the queue
-	temp = new PATHFINDER_QUEUE_ELEMENT;
-
-	if(!temp) {
-		return false;
+	
+	PATHFINDER_QUEUE_ELEMENT element;
+	element.req = req;
+	element.id = ++pathfinder_last_request_id;
+	element.behavior = req.ioid->_npcdata->behavior;
+	element.behavior_param = req.ioid->_npcdata->behavior_param;
+	element.cylinder = req.ioid->physics.cyl;
+	element.pos = req.ioid->pos;
+	element.target = req.ioid->target;
+	
+	pathfinder_request_ids[req.ioid] = element.id;
+	
+	// An Io can request Pathfinding only once so we insure that it's always the case.
+	// A new pathfinder request from the same IO will overwrite the precedent.
+	for(PathFinderQueue::iterator i = pathfinder_queue.begin(); i != pathfinder_queue.end(); ++i) {
+		if(i->req.ioid == req.ioid) {
+			*i = element;
+			return true;
+		}
 	}
-
-	// Fill this New element with new request
-	temp->req = req;
-	temp->valid = 1;
-
-	// No queue start ? then this element becomes the queue start
-	if(!cur) {
-		temp->next = NULL;
-		pathfinder_queue_start = temp;
-		
-	} else if((req.ioid->_npcdata->behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_FLEE
-	                                            | BEHAVIOUR_LOOK_FOR)) && cur->next) {
+	
+	if(!pathfinder_queue.empty() && (element.behavior & (BEHAVIOUR_MOVE_TO
+	                                 | BEHAVIOUR_FLEE | BEHAVIOUR_LOOK_FOR))) {
 		// priority: insert as second element of queue
-		temp->next = cur->next;
-		cur->next = temp;
-		
+		pathfinder_queue.insert(pathfinder_queue.begin() + 1, element);
 	} else {
-		
 		// add to end of queue
-		temp->next = NULL;
-		
-		if(!pathfinder_queue_start) {
-			pathfinder_queue_start = temp;
-			return true;
-		} else {
-			while(cur->next) {
-				cur = cur->next;
-			}
-			cur->next = temp;
-		}
+		pathfinder_queue.push_back(element);
 	}
 	
+	available->post();
+	
 	return true;
 }
 
@@ -179,34 +182,28 @@ long EERIE_PATHFINDER_Get_Queued_Number() {
 
 	Autolock lock(mutex);
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	long count = 0;
-
-	while (cur) cur = cur->next, count++;
-
-	return count;
+	return pathfinder_queue.size();
 }
 
 static void EERIE_PATHFINDER_Clear_Private() {
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-	PATHFINDER_QUEUE_ELEMENT * next;
+	pathfinder_queue.clear();
 	
-	while(cur) {
-		next = cur->next;
-		delete cur;
-		cur = next;
-	}
+	// Requests currently being processed will be dropped once they are done.
+	pathfinder_request_ids.clear();
 	
-	pathfinder_queue_start = NULL;
+	for(PathFinderResults::iterator i = pathfinder_results.begin();
+	    i != pathfinder_results.end(); ++i) {
+		free(i->list);
+	}
+	pathfinder_results.clear();
 	
 }
 
 
 void EERIE_PATHFINDER_Clear() {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return;
 	}
 	
@@ -216,28 +213,190 @@ void EERIE_PATHFINDER_Clear() {
 	
 }
 
-// Retrieves & Removes next Pathfind request from queue
-static bool EERIE_PATHFINDER_Get_Next_Request(PATHFINDER_REQUEST & request) {
+void EERIE_PATHFINDER_Cancel(const Entity * io) {
 	
-	if(!pathfinder_queue_start || !pathfinder_queue_start->valid) {
-		return false;
+	if(pathfinders.empty()) {
+		return;
 	}
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
+	Autolock lock(mutex);
+	
+	for(PathFinderQueue::iterator i = pathfinder_queue.begin(); i != pathfinder_queue.end(); ++i) {
+		if(i->req.ioid == io) {
+			pathfinder_queue.erase(i);
+			break;
+		}
+	}
+	
+	pathfinder_request_ids.erase(io);
+	
+}
 
-	if ((cur->req.ioid)
-	        && (cur->req.ioid->ioflags & IO_NPC)
-	        && (cur->req.ioid->_npcdata->behavior == BEHAVIOUR_NONE)) {
-		pathfinder_queue_start = cur->next;
-		delete cur;
-		return false;
+void EERIE_PATHFINDER_Invalidate() {
+	
+	if(!mutex) {
+		return;
 	}
+	
+	Autolock lock(mutex);
+	
+	pathfinder_anchors_version++;
+	
+}
 
-	request = cur->req;
-	pathfinder_queue_start = cur->next;
-	delete cur;
+void EERIE_PATHFINDER_Update() {
+	
+	if(pathfinders.empty()) {
+		return;
+	}
+	
+	Autolock lock(mutex);
+	
+	for(PathFinderResults::iterator i = pathfinder_results.begin();
+	    i != pathfinder_results.end(); ++i) {
+		
+		PathFinderRequestIds::iterator id = pathfinder_request_ids.find(i->req.ioid);
+		if(id == pathfinder_request_ids.end() || id->second != i->id) {
+			// The IO has made a new request or has been cancelled since
+			free(i->list);
+			continue;
+		}
+		pathfinder_request_ids.erase(id);
+		
+		Entity * io = i->req.ioid;
+		if((io->ioflags & IO_NPC) && io->_npcdata->behavior == BEHAVIOUR_NONE) {
+			// The NPC has stopped moving while we were searching
+			free(i->list);
+			continue;
+		}
+		
+		if(i->list) {
+			*(i->req.returnlist) = i->list;
+		}
+		*(i->req.returnnumber) = i->count;
+	}
+	
+	pathfinder_results.clear();
+	
+}
 
-	return true;
+// Retrieves & Removes next Pathfind request from queue
+// Blocks until a request is available, returns false if the pathfinder is stopping
+static bool EERIE_PATHFINDER_Get_Next_Request(PATHFINDER_QUEUE_ELEMENT & element) {
+	
+	while(true) {
+		
+		available->wait();
+		
+		Autolock lock(mutex);
+		
+		if(stopping) {
+			return false;
+		}
+		
+		// The queue may be empty if the request for this wakeup has been cleared.
+		if(pathfinder_queue.empty()) {
+			continue;
+		}
+		
+		element = pathfinder_queue.front();
+		pathfinder_queue.pop_front();
+		
+		const PATHFINDER_REQUEST & req = element.req;
+		if(!req.isvalid || element.behavior == BEHAVIOUR_NONE) {
+			PathFinderRequestIds::iterator id = pathfinder_request_ids.find(req.ioid);
+			if(id != pathfinder_request_ids.end() && id->second == element.id) {
+				pathfinder_request_ids.erase(id);
+			}
+			continue;
+		}
+		
+		element.version = pathfinder_anchors_version;
+		element.shared = false;
+		for(PathFinderQueue::const_iterator i = pathfinder_queue.begin();
+		    i != pathfinder_queue.end(); ++i) {
+			if(i->req.to == req.to) {
+				element.shared = true;
+				break;
+			}
+		}
+		
+		PATHFINDER_WORKING++;
+		
+		return true;
+	}
+}
+
+static const PathFinder::LightMap * EERIE_PATHFINDER_Get_Light_Map(const PathFinder & pathfinder) {
+	
+	Autolock lock(lights_mutex);
+	
+	if(!pathfinder_lights) {
+		pathfinder_lights = new PathFinder::LightMap;
+		pathfinder.buildLightMap(*pathfinder_lights);
+	}
+	
+	return pathfinder_lights;
+}
+
+static void EERIE_PATHFINDER_Find(PathFinder & pathfinder, const PATHFINDER_QUEUE_ELEMENT & element,
+                                  PathFinder::Result & result) {
+	
+	ARX_PROFILE_FUNC();
+	
+	const PATHFINDER_REQUEST & curpr = element.req;
+	
+	float heuristic(PATHFINDER_HEURISTIC_MAX);
+	
+	pathfinder.setCylinder(element.cylinder.radius, element.cylinder.height);
+	
+	bool stealth = (element.behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
+	                == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
+	if(stealth) {
+		pathfinder.setLightMap(EERIE_PATHFINDER_Get_Light_Map(pathfinder));
+	}
+	
+	if(   (element.behavior & BEHAVIOUR_MOVE_TO)
+	   || (element.behavior & BEHAVIOUR_GO_HOME)
+	) {
+		float distance = fdist(ACTIVEBKG->anchors[curpr.from].pos, ACTIVEBKG->anchors[curpr.to].pos);
+		
+		if(distance < PATHFINDER_DISTANCE_MAX)
+			heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
+		
+		pathfinder.setHeuristic(heuristic);
+		if(stealth) {
+			pathfinder.move(curpr.from, curpr.to, result, stealth);
+		} else {
+			// Share the search with other NPCs going to the same place
+			pathfinder.moveTo(curpr.from, curpr.to, result, element.version, element.shared);
+		}
+	} else if(element.behavior & BEHAVIOUR_WANDER_AROUND) {
+		if(element.behavior_param < PATHFINDER_DISTANCE_MAX)
+			heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (element.behavior_param / PATHFINDER_DISTANCE_MAX);
+		
+		pathfinder.setHeuristic(heuristic);
+		pathfinder.wanderAround(curpr.from, element.behavior_param, result, stealth);
+	} else if(element.behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE)) {
+		if(element.behavior_param < PATHFINDER_DISTANCE_MAX)
+			heuristic = PATHFINDER_HEURISTIC_MIN
+			            + PATHFINDER_HEURISTIC_RANGE
+			              * (element.behavior_param / PATHFINDER_DISTANCE_MAX);
+		
+		pathfinder.setHeuristic(heuristic);
+		float safedist = element.behavior_param + fdist(element.target, element.pos);
+		
+		pathfinder.flee(curpr.from, element.target, safedist, result, stealth);
+	} else if(element.behavior & BEHAVIOUR_LOOK_FOR) {
+		float distance = fdist(element.pos, element.target);
+		
+		if(distance < PATHFINDER_DISTANCE_MAX)
+			heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
+		
+		pathfinder.setHeuristic(heuristic);
+		pathfinder.lookFor(curpr.from, element.target, element.behavior_param, result, stealth);
+	}
+	
 }
 
 // Pathfinder Thread
@@ -245,112 +404,135 @@ void PathFinderThread::run() {
 	
 	EERIE_BACKGROUND * eb = ACTIVEBKG;
 	PathFinder pathfinder(eb->nbanchors, eb->anchors, MAX_LIGHTS, (EERIE_LIGHT **)GLight);
-
-	while(!isStopRequested()) {
+	pathfinder.setRoomMap(pathfinder_rooms);
+	
+	PathFinder::Result result;
+	
+	PATHFINDER_QUEUE_ELEMENT element;
+	while(EERIE_PATHFINDER_Get_Next_Request(element)) {
 		
-		mutex->lock();
-
-		PATHFINDER_WORKING = 1;
-
-		PATHFINDER_REQUEST curpr;
-		if(EERIE_PATHFINDER_Get_Next_Request(curpr) && curpr.isvalid) {
-			
-			ARX_PROFILE_FUNC();
-			
-			PATHFINDER_WORKING = 2;
-
-			if(curpr.ioid && curpr.ioid->_npcdata) {
-				float heuristic(PATHFINDER_HEURISTIC_MAX);
-
-				pathfinder.setCylinder(curpr.ioid->physics.cyl.radius, curpr.ioid->physics.cyl.height);
-
-				bool stealth = (curpr.ioid->_npcdata->behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
-				                == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
-
-				
-				PathFinder::Result result;
-				
-				if(   (curpr.ioid->_npcdata->behavior & BEHAVIOUR_MOVE_TO)
-				   || (curpr.ioid->_npcdata->behavior & BEHAVIOUR_GO_HOME)
-				) {
-					float distance = fdist(ACTIVEBKG->anchors[curpr.from].pos, ACTIVEBKG->anchors[curpr.to].pos);
-
-					if(distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.move(curpr.from, curpr.to, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & BEHAVIOUR_WANDER_AROUND) {
-					if(curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.wanderAround(curpr.from, curpr.ioid->_npcdata->behavior_param, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE)) {
-					if(curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE
-						              * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					float safedist = curpr.ioid->_npcdata->behavior_param
-					                 + fdist(curpr.ioid->target, curpr.ioid->pos);
-
-					pathfinder.flee(curpr.from, curpr.ioid->target, safedist, result, stealth);
-				} else if(curpr.ioid->_npcdata->behavior & BEHAVIOUR_LOOK_FOR) {
-					float distance = fdist(curpr.ioid->pos, curpr.ioid->target);
-
-					if(distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.lookFor(curpr.from, curpr.ioid->target,
-					                   curpr.ioid->_npcdata->behavior_param, result, stealth);
-				}
-				
-				if(!result.empty()) {
-					long * list = (long*)malloc(result.size() * sizeof(long));
-					std::copy(result.begin(), result.end(), list);
-					*(curpr.returnlist) = list;
-				}
-				*(curpr.returnnumber) = result.size();
-				
-			}
+		result.clear();
+		EERIE_PATHFINDER_Find(pathfinder, element, result);
+		
+		PATHFINDER_RESULT done;
+		done.req = element.req;
+		done.id = element.id;
+		done.list = NULL;
+		done.count = result.size();
+		if(!result.empty()) {
+			done.list = (long*)malloc(result.size() * sizeof(long));
+			std::copy(result.begin(), result.end(), done.list);
 		}
-
-		PATHFINDER_WORKING = 0;
-
-		mutex->unlock();
-		sleep(PATHFINDER_UPDATE_INTERVAL);
+		
+		// The result is handed to the IO by EERIE_PATHFINDER_Update() on the main thread.
+		Autolock lock(mutex);
+		pathfinder_results.push_back(done);
+		PATHFINDER_WORKING--;
 	}
-
-	// fix leaks memory but freeze characters
-	// pathfinder.Clean();
-
-	PATHFINDER_WORKING = 0;
 	
 }
 
 void EERIE_PATHFINDER_Release() {
 	
-	if(!pathfinder) {
+	if(pathfinders.empty()) {
 		return;
 	}
 	
-	mutex->lock();
+	{
+		Autolock lock(mutex);
+		stopping = true;
+		EERIE_PATHFINDER_Clear_Private();
+	}
+	
+	// Wake up every thread so that it notices that the pathfinder is stopping.
+	for(size_t i = 0; i < pathfinders.size(); i++) {
+		available->post();
+	}
+	
+	for(size_t i = 0; i < pathfinders.size(); i++) {
+		pathfinders[i]->waitForCompletion();
+		delete pathfinders[i];
+	}
+	pathfinders.clear();
 	
+	// Threads that were stopped while searching may have left results
 	EERIE_PATHFINDER_Clear_Private();
+	PATHFINDER_WORKING = 0;
 	
-	pathfinder->stop();
+	delete available, available = NULL;
+	delete mutex, mutex = NULL;
+	delete pathfinder_rooms, pathfinder_rooms = NULL;
+	delete pathfinder_lights, pathfinder_lights = NULL;
+	delete lights_mutex, lights_mutex = NULL;
+}
+
+// Find the room for each anchor and the distances between the rooms
+static PathFinder::RoomMap * EERIE_PATHFINDER_Create_Room_Map() {
+	
+	EERIE_BACKGROUND * eb = ACTIVEBKG;
+	if(!portals || portals->rooms.empty() || !RoomDistance || !eb->nbanchors) {
+		return NULL;
+	}
 	
-	delete pathfinder, pathfinder = NULL;
+	PathFinder::RoomMap * rooms = new PathFinder::RoomMap;
 	
-	mutex->unlock(), delete mutex, mutex = NULL;
+	size_t count = portals->rooms.size();
+	rooms->roomCount = count;
+	
+	// RoomDistance has no distance for adjacent rooms, so get those from the portals
+	rooms->distances.assign(count * count, -1.f);
+	for(size_t i = 0; i < count; i++) {
+		rooms->distances[i * count + i] = 0.f;
+	}
+	for(size_t i = 0; i < portals->portals.size(); i++) {
+		const EERIE_PORTALS & portal = portals->portals[i];
+		if(portal.room_1 < count && portal.room_2 < count) {
+			rooms->distances[portal.room_1 * count + portal.room_2] = 0.f;
+			rooms->distances[portal.room_2 * count + portal.room_1] = 0.f;
+		}
+	}
+	// RoomDistance is indexed [from + to * count], but the distances are the same in
+	// both directions so it doesn't matter which of the two rooms is the start
+	for(size_t i = 0; i < count; i++) {
+		for(size_t j = 0; j < count; j++) {
+			float distance = RoomDistance[i + j * count].distance;
+			if(distance > 0.f && rooms->distances[i * count + j] < 0.f) {
+				rooms->distances[i * count + j] = distance;
+			}
+		}
+	}
+	
+	rooms->nodeRooms.resize(eb->nbanchors);
+	rooms->nodePortalDistances.resize(eb->nbanchors);
+	for(long i = 0; i < eb->nbanchors; i++) {
+		// Same as UpdateIORoom(), anchors are at foot level
+		Vec3f pos = eb->anchors[i].pos;
+		pos.y -= 60.f;
+		long room = ARX_PORTALS_GetRoomNumForPosition(pos, 2);
+		if(room >= long(count)) {
+			room = -1;
+		}
+		rooms->nodeRooms[i] = room;
+		float distance = 0.f;
+		if(room >= 0) {
+			const EERIE_ROOM_DATA & data = portals->rooms[room];
+			for(long j = 0; j < data.nb_portals; j++) {
+				const EERIE_PORTALS & portal = portals->portals[data.portals[j]];
+				float portal_distance = fdist(eb->anchors[i].pos, portal.poly.center);
+				if(j == 0 || portal_distance < distance) {
+					distance = portal_distance;
+				}
+			}
+		}
+		rooms->nodePortalDistances[i] = distance;
+	}
+	
+	return rooms;
 }
 
 void EERIE_PATHFINDER_Create() {
 	
-	if(pathfinder) {
+	if(!pathfinders.empty()) {
 		EERIE_PATHFINDER_Release();
 	}
 	
@@ -358,7 +540,28 @@ void EERIE_PATHFINDER_Create() {
 		mutex = new Lock();
 	}
 	
-	pathfinder = new PathFinderThread();
-	pathfinder->setThreadName("Pathfinder");
-	pathfinder->start();
+	if(!lights_mutex) {
+		lights_mutex = new Lock();
+	}
+	
+	available = new Semaphore();
+	stopping = false;
+	
+	pathfinder_rooms = EERIE_PATHFINDER_Create_Room_Map();
+	
+	// Leave one processor for the main thread
+	unsigned count = platform::getCPUCount();
+	if(count > 1) {
+		count--;
+	}
+	count = std::min(count, PATHFINDER_WORKERS_MAX);
+	
+	pathfinders.resize(count);
+	for(size_t i = 0; i < count; i++) {
+		pathfinders[i] = new PathFinderThread();
+		std::ostringstream oss;
+		oss << "Pathfinder " << i;
+		pathfinders[i]->setThreadName(oss.str());
+		pathfinders[i]->start();
+	}
 }
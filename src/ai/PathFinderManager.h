@@ -58,6 +58,7 @@ struct PATHFINDER_REQUEST {
 	long * returnnumber;			// must point to a -1 value at call time
 	// As soon as returnnumber is no more -1
 	// Pathfinding is considered finished
+	// Results are only written by EERIE_PATHFINDER_Update()
 	Entity * ioid;
 	long ** returnlist;	//must be NULL
 };
@@ -67,6 +68,16 @@ extern long PATHFINDER_WORKING;
 bool EERIE_PATHFINDER_Add_To_Queue(const PATHFINDER_REQUEST & request);
 long EERIE_PATHFINDER_Get_Queued_Number();
 void EERIE_PATHFINDER_Clear();
+
+//! Drop queued and running requests for an IO - their results will not be written
+void EERIE_PATHFINDER_Cancel(const Entity * io);
+
+//! Discard saved searches, must be called when anchors get blocked or unblocked
+void EERIE_PATHFINDER_Invalidate();
+
+//! Hand finished paths to the requesting IOs, must be called from the main thread
+void EERIE_PATHFINDER_Update();
+
 void EERIE_PATHFINDER_Create();
 void EERIE_PATHFINDER_Release();
 
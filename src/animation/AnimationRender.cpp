@@ -519,6 +519,8 @@ static bool Cedric_IO_Visible(const Vec3f & pos) {
 /* Object dynamic lighting */
 static void Cedric_ApplyLighting(EERIE_3DOBJ * eobj, Skeleton * obj, const ColorMod & colorMod) {
 
+	ARX_PROFILE_FUNC();
+
 	/* Apply light on all vertices */
 	for(size_t i = 0; i != obj->bones.size(); i++) {
 
@@ -1400,6 +1402,8 @@ static void Cedric_ConcatenateTM(Skeleton & rig, const TransformInfo & t) {
  */
 static void Cedric_TransformVerts(EERIE_3DOBJ * eobj, const Vec3f & pos) {
 
+	ARX_PROFILE_FUNC();
+
 	Skeleton & rig = *eobj->m_skeleton;
 
 	// Transform & project all vertices
@@ -61,6 +61,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "platform/Lock.h"
 #include "platform/Time.h"
+#include "platform/profiler/Profiler.h"
 
 namespace audio {
 
@@ -229,14 +230,17 @@ aalError update() {
 	session_time = platform::getTimeMs();
 	
 	// Update sources
+	size_t activeSources = 0;
 	for(Backend::source_iterator p = backend->sourcesBegin(); p != backend->sourcesEnd();) {
 		Source * source = *p;
 		if(source && (source->update(), source->isIdle())) {
 			p = backend->deleteSource(p);
 		} else {
+			activeSources += (source != NULL);
 			++p;
 		}
 	}
+	ARX_PROFILE_COUNTER(Audio sources, activeSources);
 	
 	// Update ambiances
 	for(size_t i = 0; i < _amb.size(); i++) {
@@ -91,6 +91,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/GraphicsModes.h"
 #include "graphics/GraphicsTypes.h"
 #include "graphics/Math.h"
+#include "graphics/RenderBatcher.h"
 #include "graphics/Vertex.h"
 #include "graphics/VertexBuffer.h"
 #include "graphics/data/FTL.h"
@@ -132,12 +133,14 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/fs/Filesystem.h"
 #include "io/fs/SystemPaths.h"
 #include "io/resource/PakReader.h"
+#include "io/resource/ResourcePrefetcher.h"
 #include "io/Screenshot.h"
 #include "io/log/CriticalLogger.h"
 #include "io/log/Logger.h"
 
 #include "platform/Dialog.h"
 #include "platform/Flags.h"
+#include "platform/OS.h"
 #include "platform/Platform.h"
 #include "platform/Process.h"
 #include "platform/ProgramOptions.h"
@@ -1062,6 +1065,10 @@ bool ArxGame::addPaks() {
 		resources->addFiles(base / "speech", "speech");
 	}
 	
+	// Leave one processor for the main thread
+	unsigned threads = std::max(platform::getCPUCount(), 2u) - 1;
+	resourcePrefetcher = new ResourcePrefetcher(resources, threads);
+	
 	return true;
 }
 
@@ -1171,6 +1178,7 @@ void ArxGame::shutdownGame() {
 	//object loaders from beforerun
 	gui::ReleaseNecklace();
 	
+	delete resourcePrefetcher, resourcePrefetcher = NULL;
 	delete resources;
 	
 	// Current game
@@ -1260,6 +1268,7 @@ void ArxGame::run() {
  */
 void ArxGame::doFrame() {
 	
+	ARX_PROFILE_FRAME();
 	ARX_PROFILE_FUNC();
 	
 	updateTime();
@@ -1319,6 +1328,12 @@ void ArxGame::doFrame() {
 	} else {
 		update();
 		render();
+		
+		ARX_PROFILE_COUNTER(Draw calls, GRenderer->takeDrawCallCount());
+		ARX_PROFILE_COUNTER(Drawn polys, EERIEDrawnPolys);
+		ARX_PROFILE_COUNTER(Particles, getParticleCount());
+		ARX_PROFILE_COUNTER(Batcher memory, RenderBatcher::getInstance().getMemoryUsed());
+		ARX_PROFILE_COUNTER(Pathfinder queue, EERIE_PATHFINDER_Get_Queued_Number());
 	}
 }
 
@@ -1805,7 +1820,14 @@ void ArxGame::updateInput() {
 		ComputePortalVertexBuffer();
 		*/
 		
-		profiler::flush();
+		if(GInput->isKeyPressed(Keyboard::Key_LeftShift)
+		   || GInput->isKeyPressed(Keyboard::Key_RightShift)) {
+			// Toggle between recording all profile scopes and sampling them
+			profiler::setSampleRate(profiler::getSampleRate() == 1 ? 16 : 1);
+			LogInfo << "Profiler sample rate: 1/" << profiler::getSampleRate();
+		} else {
+			profiler::flush();
+		}
 	}
 
 	if(GInput->isKeyPressedNowPressed(Keyboard::Key_F11)) {
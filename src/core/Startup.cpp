@@ -54,6 +54,8 @@
 #include "core/Version.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/SystemPaths.h"
+#include "io/log/AsyncLogger.h"
+#include "io/log/ConsoleLogger.h"
 #include "io/log/CriticalLogger.h"
 #include "io/log/FileLogger.h"
 #include "io/log/Logger.h"
@@ -144,7 +146,11 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	}
 	
 	// Also intialize the logging system early as we might need it
-	Logger::initialize();
+	// Console and file output is written from a background thread
+	logger::Async * asyncLogger = new logger::Async;
+	asyncLogger->add(logger::Console::get());
+	Logger::add(asyncLogger);
+	Logger::initialize(/* console = */ false);
 	CrashHandler::registerCrashCallback(Logger::quickShutdown);
 	Logger::add(new logger::CriticalErrorDialog);
 	
@@ -165,7 +171,7 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		// Now that data directories are initialized, create a log file
 		{
 			fs::path logFile = fs::paths.user / "arx.log";
-			Logger::add(new logger::File(logFile));
+			asyncLogger->add(new logger::File(logFile));
 			CrashHandler::addAttachedFile(logFile);
 		}
 		
@@ -177,6 +183,8 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		LogInfo << "Starting " << arx_version;
 		runGame();
 		
+		profiler::shutdown();
+			
 	}
 	
 	// Shutdown the logging system
@@ -926,6 +926,8 @@ void ARX_PHYSICS_Apply() {
 	
 	ARX_PROFILE_FUNC();
 	
+	EERIE_PATHFINDER_Update();
+	
 	static long CURRENT_DETECT = 0;
 
 	CURRENT_DETECT++;
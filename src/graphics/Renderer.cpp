@@ -59,7 +59,7 @@ void Renderer::SetTexture(unsigned int textureStage, TextureContainer * pTexture
 	}
 }
 
-Renderer::Renderer() : m_initialized(false) { }
+Renderer::Renderer() : m_initialized(false), m_drawCalls(0) { }
 
 Renderer::~Renderer() {
 	if(isInitialized()) {
@@ -227,10 +227,18 @@ public:
 	virtual bool getSnapshot(Image & image) = 0;
 	virtual bool getSnapshot(Image & image, size_t width, size_t height) = 0;
 	
+	//! Get the number of draw calls since the last call and reset the count.
+	size_t takeDrawCallCount() {
+		size_t count = m_drawCalls;
+		m_drawCalls = 0;
+		return count;
+	}
+	
 protected:
 	
 	std::vector<TextureStage *> m_TextureStages;
 	bool m_initialized;
+	size_t m_drawCalls;
 	
 	void onRendererInit();
 	void onRendererShutdown();
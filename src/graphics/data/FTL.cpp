@@ -428,14 +428,22 @@ EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
 	}
 	
 	size_t compressedSize = 0;
-	char * compressedData = MCache_Pop(filename, compressedSize);
+	char * allocatedData = NULL;
 	LogDebug("File name check " << filename);
 	
+	// Files stored uncompressed in the PAK can be decompressed in place
 	bool NOrelease = true;
-	if(!compressedData) {
-		compressedData = pf->readAlloc();
+	const char * compressedData = pf->data();
+	if(compressedData) {
 		compressedSize = pf->size();
-		NOrelease = MCache_Push(filename, compressedData, compressedSize) ? 1 : 0;
+	} else {
+		allocatedData = MCache_Pop(filename, compressedSize);
+		if(!allocatedData) {
+			// Takes the contents if they have been prefetched with the level
+			allocatedData = resources->readAlloc(filename, compressedSize);
+			NOrelease = MCache_Push(filename, allocatedData, compressedSize) ? 1 : 0;
+		}
+		compressedData = allocatedData;
 	}
 	
 	if(!compressedData) {
@@ -460,7 +468,7 @@ EERIE_3DOBJ * ARX_FTL_Load(const res::path & file) {
 	}
 	
 	if(!NOrelease) {
-		free(compressedData);
+		free(allocatedData);
 	}
 	
 	size_t pos = 0; // The position within the data
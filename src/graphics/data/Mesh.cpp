@@ -1402,10 +1402,15 @@ class scoped_malloc {
 	
 public:
 	
-	explicit scoped_malloc(T * data) : data(data) { }
+	explicit scoped_malloc(T * data = NULL) : data(data) { }
 	
 	~scoped_malloc() { free(data); }
 	
+	void reset(T * newData) {
+		free(data);
+		data = newData;
+	}
+	
 	T * get() { return data; }
 	const T * get() const { return data; }
 	
@@ -1422,9 +1427,16 @@ bool FastSceneLoad(const res::path & partial_path) {
 		
 		// Load the whole file
 		LogDebug("Loading " << file);
-		size_t size;
-		scoped_malloc<char> dat(resources->readAlloc(file, size));
-		data = dat.get(), end = dat.get() + size;
+		size_t size = 0;
+		scoped_malloc<char> dat;
+		// The scene data is decompressed below, so only copy the file if it is not
+		// stored uncompressed in the PAK
+		data = resources->readBorrowed(file, size);
+		if(!data) {
+			dat.reset(resources->readAlloc(file, size));
+			data = dat.get();
+		}
+		end = data + size;
 		// TODO use new[] instead of malloc so we can use (boost::)unique_ptr
 		LogDebug("FTS: read " << size << " bytes");
 		if(!data) {
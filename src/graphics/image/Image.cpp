@@ -30,6 +30,7 @@
 #include "io/resource/PakReader.h"
 #include "io/log/Logger.h"
 #include "platform/CrashHandler.h"
+#include "platform/profiler/Profiler.h"
 
 namespace {
 
@@ -47,22 +48,36 @@ const unsigned int SIZE_TABLE[Image::Format_Num] = {
 	0,  // Format_Unknown
 };
 
+//! Image buffers are reported to the profiler so that their memory use can be graphed
+unsigned char * allocateImageData(size_t size) {
+	ARX_PROFILE_ALLOC(Images, size);
+	return new unsigned char[size];
+}
+
+void freeImageData(unsigned char * data, size_t size) {
+	ARX_UNUSED(size);
+	if(data) {
+		ARX_PROFILE_FREE(Images, size);
+	}
+	delete[] data;
+}
+
 } // anonymous namespace
 
-Image::Image() : mData(0) {
+Image::Image() : mData(0), mDataSize(0) {
 	Reset();
 }
 
-Image::Image(const Image & pOther) : mData(NULL) {
+Image::Image(const Image & pOther) : mData(NULL), mDataSize(0) {
 	*this = pOther;
 }
 
 Image::~Image() {
-	delete[] mData;
+	freeImageData(mData, mDataSize);
 }
 
 void Image::Reset() {
-	delete[] mData, mData = NULL;
+	freeImageData(mData, mDataSize), mData = NULL;
 	mWidth = 0;
 	mHeight = 0;
 	mDepth = 0;
@@ -78,7 +93,7 @@ const Image& Image::operator=(const Image & pOther) {
 		return *this;
 	}
 	
-	delete[] mData, mData = NULL;
+	freeImageData(mData, mDataSize), mData = NULL;
 	
 	mWidth      = pOther.mWidth;
 	mHeight     = pOther.mHeight;
@@ -86,7 +101,7 @@ const Image& Image::operator=(const Image & pOther) {
 	mNumMipmaps = pOther.mNumMipmaps;
 	mFormat     = pOther.mFormat;
 	mDataSize   = pOther.mDataSize;
-	mData       = new unsigned char[mDataSize];
+	mData       = allocateImageData(mDataSize);
 	
 	memcpy(mData, pOther.mData, mDataSize);
 	
@@ -160,6 +175,12 @@ bool Image::IsCompressed(Image::Format pFormat) {
 bool Image::LoadFromFile(const res::path & filename) {
 	
 	size_t size = 0;
+	
+	// Decode images that are stored uncompressed directly from the PAK file
+	if(const char * data = resources->readBorrowed(filename, size)) {
+		return LoadFromMemory(data, size, filename.string().c_str());
+	}
+	
 	void * pData = resources->readAlloc(filename, size);
 	
 	if(!pData) {
@@ -173,7 +194,7 @@ bool Image::LoadFromFile(const res::path & filename) {
 	return ret;
 }
 
-bool Image::LoadFromMemory(void * pData, unsigned int size, const char * file) {
+bool Image::LoadFromMemory(const void * pData, unsigned int size, const char * file) {
 	
 	if(!pData) {
 		return false;
@@ -217,12 +238,12 @@ bool Image::LoadFromMemory(void * pData, unsigned int size, const char * file) {
 	
 	// Delete previous buffer if size don't match
 	if(mData && mDataSize != dataSize) {
-		delete[] mData, mData = NULL;
+		freeImageData(mData, mDataSize), mData = NULL;
 	}
 	
 	// Create a new buffer if needed
 	if(!mData) {
-		mData = new unsigned char[dataSize];
+		mData = allocateImageData(dataSize);
 	}
 	
 	// Copy image data to our buffer
@@ -253,11 +274,11 @@ void Image::Create(unsigned int pWidth, unsigned int pHeight, Image::Format pFor
 	
 	unsigned int dataSize = Image::GetSizeWithMipmaps(mFormat, mWidth, mHeight, mDepth, mNumMipmaps);
 	if(mData && dataSize != mDataSize) {
-		delete[] mData, mData = NULL;
+		freeImageData(mData, mDataSize), mData = NULL;
 	}
 	mDataSize = dataSize;
 	if(!mData) {
-		mData = new unsigned char[mDataSize];
+		mData = allocateImageData(mDataSize);
 	}
 }
 
@@ -581,7 +602,7 @@ void Image::ApplyColorKeyToAlpha(Color key) {
 	
 	// Create a temp buffer
 	size_t dataSize = GetSizeWithMipmaps(Format_R8G8B8A8, mWidth, mHeight, mDepth, mNumMipmaps);
-	u8 * dataTemp = new unsigned char[dataSize];
+	u8 * dataTemp = allocateImageData(dataSize);
 	
 	// Fill temp image and apply color key to alpha channel
 	u8 * dst = dataTemp;
@@ -618,7 +639,7 @@ void Image::ApplyColorKeyToAlpha(Color key) {
 	}
 	
 	// Swap data with temp data and ajust internal state
-	delete[] mData;
+	freeImageData(mData, mDataSize);
 	mData = dataTemp;
 	mDataSize = dataSize;
 	mFormat = (mFormat == Format_R8G8B8) ? Format_R8G8B8A8 : Format_B8G8R8A8;
@@ -718,7 +739,7 @@ bool Image::ToGrayscale(Image::Format newFormat) {
 	}
 		
 	unsigned int newSize = GetSizeWithMipmaps(newFormat, mWidth, mHeight, mDepth, mNumMipmaps);
-	unsigned char* newData = new unsigned char[newSize];
+	unsigned char* newData = allocateImageData(newSize);
 	
 	unsigned char* src = mData;
 	unsigned char* dst = newData;
@@ -731,7 +752,7 @@ bool Image::ToGrayscale(Image::Format newFormat) {
 		dst += dstNumChannels;
 	}
 		
-	delete[] mData;
+	freeImageData(mData, mDataSize);
 	mData = newData;
 	mDataSize = newSize;
 	
@@ -751,9 +772,9 @@ bool Image::ToNormalMap() {
 	unsigned int sx, sy, len, predx, succx;
 	
 	mFormat = Format_R8G8B8;
-	mDataSize = GetSizeWithMipmaps(mFormat, mWidth, mHeight, mDepth, mNumMipmaps);
+	unsigned int newSize = GetSizeWithMipmaps(mFormat, mWidth, mHeight, mDepth, mNumMipmaps);
 	
-	unsigned char * newPixels = new unsigned char[mDataSize];
+	unsigned char * newPixels = allocateImageData(newSize);
 	unsigned char * dest = newPixels;
 	unsigned char * src = mData;
 	
@@ -818,8 +839,9 @@ bool Image::ToNormalMap() {
 		mipmap++;
 	} while(mipmap < mNumMipmaps);
 	
-	delete[] mData;
+	freeImageData(mData, mDataSize);
 	mData = newPixels;
+	mDataSize = newSize;
 	
 	return true;
 }
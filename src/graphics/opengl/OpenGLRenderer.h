@@ -125,7 +125,7 @@ private:
 	void setGLState(GLenum state, bool enable);
 	
 	template <class Vertex>
-	inline void beforeDraw() { applyTextureStages(); selectTrasform<Vertex>(); }
+	inline void beforeDraw() { m_drawCalls++; applyTextureStages(); selectTrasform<Vertex>(); }
 	
 	template <class Vertex>
 	friend class GLNoVertexBuffer;
@@ -41,11 +41,16 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 
 #include "io/log/Logger.h"
+#include "platform/Platform.h"
 
 #define MAXBITS 13              /* maximum code length */
 #define MAXWIN 4096             /* maximum window size */
+#define LITBITS 13              /* maximum literal code length */
+#define LENBITS 7               /* maximum length code length */
+#define DISTBITS 8              /* maximum distance code length */
 
 namespace {
 
@@ -54,7 +59,7 @@ struct blast_truncated_error { };
 } // anonymous namespace
 
 /* input and output state */
-struct state {
+struct BlastState {
 	
 	/* input state */
 	blast_in infun;             /* input function provided by user */
@@ -71,6 +76,13 @@ struct state {
 	int first;                  /* true to check distances (for first 4K) */
 	unsigned char out[MAXWIN];  /* output buffer and sliding window */
 	
+	/* decoder state */
+	int lit;                    /* true if literals are coded */
+	int dict;                   /* log2(dictionary size) - 6 */
+	int len;                    /* remaining length of an interrupted copy */
+	int dist;                   /* distance of an interrupted copy */
+	bool done;                  /* true if the end code has been read */
+	
 };
 
 /*
@@ -84,7 +96,7 @@ struct state {
  *   buffer, using shift right, and new bytes are appended to the top of the
  *   bit buffer, using shift left.
  */
-static int bits(state * s, int need) {
+static int bits(BlastState * s, int need) {
 	
 	int val;            /* bit accumulator */
 	
@@ -141,7 +153,7 @@ struct huffman {
  *   this ordering, the bits pulled during decoding are inverted to apply the
  *   more "natural" ordering starting with all zeros and incrementing.
  */
-static int decode(state * s, huffman * h) {
+static int decode(BlastState * s, huffman * h) {
 	
 	int len;            /* current number of bits in code */
 	int code;           /* len bits being decoded */
@@ -256,6 +268,121 @@ static int construct(huffman * h, const unsigned char * rep, int n) {
 	return left;
 }
 
+/*
+ * Lookup table entry for the table-driven decoder: the symbol is stored in the
+ * low byte and the code length in the high byte.  A length of zero marks bit
+ * patterns that do not start with a valid code.
+ */
+typedef unsigned short lookup;
+
+/*
+ * Build a lookup table that maps every possible sequence of the next bits bits
+ * in the stream to the first code in that sequence.  This follows the same
+ * steps as decode(), but on an integer instead of the input stream.
+ */
+static void construct_lookup(lookup * table, const huffman * h, int bits) {
+	
+	for(int i = 0; i < (1 << bits); i++) {
+		
+		int stream = i;     /* bits in stream order */
+		int code = 0, first = 0, index = 0;
+		
+		table[i] = 0;
+		for(int len = 1; len <= bits; len++) {
+			code |= (stream & 1) ^ 1;   /* invert code */
+			stream >>= 1;
+			int count = h->count[len];
+			if(code < first + count) {
+				table[i] = lookup(h->symbol[index + (code - first)] | (len << 8));
+				break;
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+	}
+}
+
+/*
+ * Huffman tables for the fixed literal, length and distance codes.
+ *
+ * The tables are built by a static constructor before main() runs so that
+ * multiple threads can decompress at the same time.
+ */
+struct BlastTables {
+	
+	short litcnt[MAXBITS+1], litsym[256];        /* litcode memory */
+	short lencnt[MAXBITS+1], lensym[16];         /* lencode memory */
+	short distcnt[MAXBITS+1], distsym[64];       /* distcode memory */
+	huffman litcode;     /* literal code */
+	huffman lencode;     /* length code */
+	huffman distcode;    /* distance code */
+	
+	lookup litlookup[1 << LITBITS];      /* literal code lookup table */
+	lookup lenlookup[1 << LENBITS];      /* length code lookup table */
+	lookup distlookup[1 << DISTBITS];    /* distance code lookup table */
+	
+	BlastTables() {
+		
+		/* bit lengths of literal codes */
+		static const unsigned char litlen[] = {
+			11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
+			9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+			7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
+			8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+			44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
+			44, 173
+		};
+		/* bit lengths of length codes 0..15 */
+		static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
+		/* bit lengths of distance codes 0..63 */
+		static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
+		
+		litcode.count = litcnt, litcode.symbol = litsym;
+		lencode.count = lencnt, lencode.symbol = lensym;
+		distcode.count = distcnt, distcode.symbol = distsym;
+		
+		construct(&litcode, litlen, sizeof(litlen));
+		construct(&lencode, lenlen, sizeof(lenlen));
+		construct(&distcode, distlen, sizeof(distlen));
+		
+		construct_lookup(litlookup, &litcode, LITBITS);
+		construct_lookup(lenlookup, &lencode, LENBITS);
+		construct_lookup(distlookup, &distcode, DISTBITS);
+	}
+	
+};
+
+static BlastTables g_blastTables;
+
+static const short base[16] = {     /* base for length codes */
+	3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
+};
+static const char extra[16] = {     /* extra bits for length codes */
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
+};
+
+/*
+ * Read the stream header and prepare the decoder state.
+ */
+static BlastResult blastBegin(BlastState * s) {
+	
+	s->next = 0;
+	s->first = 1;
+	s->len = 0;
+	s->dist = 0;
+	s->done = false;
+	
+	/* read header */
+	s->lit = bits(s, 8);
+	if (s->lit > 1) return BLAST_INVALID_LITERAL_FLAG;
+	s->dict = bits(s, 8);
+	if (s->dict < 4 || s->dict > 6) return BLAST_INVALID_DIC_SIZE;
+	
+	return BLAST_SUCCESS;
+}
+
 /*
  * Decode PKWare Compression Library stream.
  *
@@ -293,114 +420,89 @@ static int construct(huffman * h, const unsigned char * rep, int n) {
  *   twelve copies the last four bytes three times.  A simple forward copy
  *   ignoring whether the length is greater than the distance or not implements
  *   this correctly.
+ *
+ * Decoding stops as soon as the output window is full (s->next == MAXWIN) so that
+ * the caller can consume it, or when the end code has been read (s->done is set).
+ * A copy that is interrupted by a full window is resumed by the next call.
  */
-static BlastResult blastDecompress(state * s) {
+static BlastResult blastFillWindow(BlastState * s) {
 	
-	int lit;            /* true if literals are coded */
-	int dict;           /* log2(dictionary size) - 6 */
 	int symbol;         /* decoded symbol, extra bits for distance */
-	int len;            /* length for copy */
-	int dist;           /* distance for copy */
 	int copy;           /* copy counter */
 	unsigned char * from, *to;   /* copy pointers */
-	static int virgin = 1;                              /* build tables once */
-	static short litcnt[MAXBITS+1], litsym[256];        /* litcode memory */
-	static short lencnt[MAXBITS+1], lensym[16];         /* lencode memory */
-	static short distcnt[MAXBITS+1], distsym[64];       /* distcode memory */
-	static huffman litcode = {litcnt, litsym};   /* length code */
-	static huffman lencode = {lencnt, lensym};   /* length code */
-	static huffman distcode = {distcnt, distsym};/* distance code */
-	/* bit lengths of literal codes */
-	static const unsigned char litlen[] = {
-		11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
-		9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
-		7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
-		8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
-		44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
-		44, 173
-	};
-	/* bit lengths of length codes 0..15 */
-	static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
-	/* bit lengths of distance codes 0..63 */
-	static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
-	static const short base[16] = {     /* base for length codes */
-		3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
-	};
-	static const char extra[16] = {     /* extra bits for length codes */
-		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
-	};
-	
-	/* set up decoding tables (once--might not be thread-safe) */
-	if(virgin) {
-		construct(&litcode, litlen, sizeof(litlen));
-		construct(&lencode, lenlen, sizeof(lenlen));
-		construct(&distcode, distlen, sizeof(distlen));
-		virgin = 0;
-	}
-	
-	/* read header */
-	lit = bits(s, 8);
-	if (lit > 1) return BLAST_INVALID_LITERAL_FLAG;
-	dict = bits(s, 8);
-	if (dict < 4 || dict > 6) return BLAST_INVALID_DIC_SIZE;
 	
 	/* decode literals and length/distance pairs */
-	do {
-		if(bits(s, 1)) {
+	while(s->next < MAXWIN) {
+		
+		if(s->len != 0) {
+			
+			/* copy length bytes from distance bytes back */
+			to = s->out + s->next;
+			from = to - s->dist;
+			copy = MAXWIN;
+			if ((int)s->next < s->dist) {
+				from += copy;
+				copy = s->dist;
+			}
+			copy -= s->next;
+			if (copy > s->len) copy = s->len;
+			s->len -= copy;
+			s->next += copy;
+			do {
+				*to++ = *from++;
+			} while(--copy);
+			
+		} else if(bits(s, 1)) {
 			/* get length */
-			symbol = decode(s, &lencode);
-			len = base[symbol] + bits(s, extra[symbol]);
-			if (len == 519) break;              /* end code */
+			symbol = decode(s, &g_blastTables.lencode);
+			int len = base[symbol] + bits(s, extra[symbol]);
+			if(len == 519) {                    /* end code */
+				s->done = true;
+				break;
+			}
 			
 			/* get distance */
-			symbol = len == 2 ? 2 : dict;
-			dist = decode(s, &distcode) << symbol;
+			symbol = len == 2 ? 2 : s->dict;
+			int dist = decode(s, &g_blastTables.distcode) << symbol;
 			dist += bits(s, symbol);
 			dist++;
 			if (s->first && dist > (int)s->next)
 				return BLAST_INVALID_OFFSET;
 			
-			/* copy length bytes from distance bytes back */
-			do {
-				to = s->out + s->next;
-				from = to - dist;
-				copy = MAXWIN;
-				if ((int)s->next < dist) {
-					from += copy;
-					copy = dist;
-				}
-				copy -= s->next;
-				if (copy > len) copy = len;
-				len -= copy;
-				s->next += copy;
-				do {
-					*to++ = *from++;
-				} while(--copy);
-				if(s->next == MAXWIN) {
-					if(s->outfun(s->outhow, s->out, s->next)) return BLAST_OUTPUT_ERROR;
-					s->next = 0;
-					s->first = 0;
-				}
-			} while(len != 0);
+			s->len = len;
+			s->dist = dist;
 			
 		} else {
 			/* get literal and write it */
-			symbol = lit ? decode(s, &litcode) : bits(s, 8);
+			symbol = s->lit ? decode(s, &g_blastTables.litcode) : bits(s, 8);
 			s->out[s->next++] = symbol;
-			if(s->next == MAXWIN) {
-				if(s->outfun(s->outhow, s->out, s->next)) return BLAST_OUTPUT_ERROR;
-				s->next = 0;
-				s->first = 0;
-			}
 		}
-	} while(1);
+	}
 	
 	return BLAST_SUCCESS;
 }
 
+static BlastResult blastDecompress(BlastState * s) {
+	
+	BlastResult err = blastBegin(s);
+	
+	while(!err && !s->done) {
+		
+		err = blastFillWindow(s);
+		
+		if(!err && s->next == MAXWIN) {
+			if(s->outfun(s->outhow, s->out, s->next)) return BLAST_OUTPUT_ERROR;
+			s->next = 0;
+			s->first = 0;
+		}
+	}
+	
+	return err;
+}
+
 BlastResult blast(blast_in infun, void *inhow, blast_out outfun, void *outhow) {
 	
-	state s;
+	BlastState s;
 	
 	// initialize input state
 	s.infun = infun;
@@ -430,8 +532,292 @@ BlastResult blast(blast_in infun, void *inhow, blast_out outfun, void *outhow) {
 	return err;
 }
 
+/*
+ * Input state for the table-driven decoder.  Whole bytes are loaded into a 64-bit
+ * bit buffer so that the input only needs to be checked once per literal or
+ * length/distance pair instead of once per bit.
+ */
+struct BlastBitReader {
+	
+	const unsigned char * in;   /* next input location */
+	const unsigned char * end;  /* end of the input */
+	u64 bitbuf;                 /* bit buffer */
+	int bitcnt;                 /* number of bits in bit buffer */
+	
+	/* load as many whole bytes as fit - at least 57 bits unless the input ends */
+	void refill() {
+		while(bitcnt <= 56 && in != end) {
+			bitbuf |= u64(*in++) << bitcnt;
+			bitcnt += 8;
+		}
+	}
+	
+	/* return the next need bits without removing them from the buffer */
+	int peek(int need) const {
+		return int(bitbuf) & ((1 << need) - 1);
+	}
+	
+	void drop(int need) {
+		bitbuf >>= need;
+		bitcnt -= need;
+	}
+	
+};
+
+/*
+ * Resize the output buffer of the table-driven decoder to hold at least needed
+ * bytes.  On failure the buffer is freed.
+ */
+static bool blastGrow(char * & buf, size_t & size, size_t needed) {
+	
+	size_t newSize = std::max(needed, std::max(size * 2, size_t(MAXWIN)));
+	
+	char * newBuf = reinterpret_cast<char *>(realloc(buf, newSize));
+	if(!newBuf) {
+		free(buf);
+		buf = NULL;
+		size = 0;
+		return false;
+	}
+	
+	buf = newBuf;
+	size = newSize;
+	return true;
+}
+
+/*
+ * Decompress data that is fully available in memory into a contiguous buffer.
+ *
+ * This produces the same output as blast(), but complete codes are looked up in
+ * the tables built by construct_lookup() instead of being decoded bit by bit, and
+ * matches are copied directly inside the output buffer instead of going through
+ * the 4K window.  The code lengths are small enough that a literal or a complete
+ * length/distance pair always fits into a refilled bit buffer, so the input only
+ * needs to be checked for truncation near its end.
+ *
+ * If grow is true, out.buf is resized with realloc() as needed and freed if that
+ * fails.  Otherwise no more than out.allocSize bytes are written.
+ */
+static BlastResult blastTable(const char * from, size_t fromSize,
+                              BlastMemOutBufferRealloc & out, bool grow) {
+	
+	const BlastTables & t = g_blastTables;
+	
+	/* read header */
+	if(fromSize < 2) return BLAST_TRUNCATED_INPUT;
+	const unsigned char * header = reinterpret_cast<const unsigned char *>(from);
+	int lit = header[0];
+	if(lit > 1) return BLAST_INVALID_LITERAL_FLAG;
+	int dict = header[1];
+	if(dict < 4 || dict > 6) return BLAST_INVALID_DIC_SIZE;
+	
+	BlastBitReader s;
+	s.in = header + 2;
+	s.end = header + fromSize;
+	s.bitbuf = 0;
+	s.bitcnt = 0;
+	
+	/* keep the output state in locals - stores through buf may alias out */
+	char * buf = out.buf;
+	size_t size = out.allocSize;
+	size_t next = out.fillSize;
+	
+	BlastResult err = BLAST_SUCCESS;
+	
+	/* decode literals and length/distance pairs */
+	while(true) {
+		
+		s.refill();
+		if(s.bitcnt == 0) {
+			err = BLAST_TRUNCATED_INPUT;
+			break;
+		}
+		
+		int flag = s.peek(1);
+		s.drop(1);
+		
+		if(flag) {
+			
+			/* get length */
+			lookup code = t.lenlookup[s.peek(LENBITS)];
+			int bits = code >> 8;
+			int symbol = code & 0xff;
+			if(bits == 0 || bits + extra[symbol] > s.bitcnt) {
+				err = BLAST_TRUNCATED_INPUT;
+				break;
+			}
+			s.drop(bits);
+			size_t len = base[symbol] + s.peek(extra[symbol]);
+			s.drop(extra[symbol]);
+			if(len == 519) {                    /* end code */
+				break;
+			}
+			
+			/* get distance */
+			code = t.distlookup[s.peek(DISTBITS)];
+			bits = code >> 8;
+			symbol = len == 2 ? 2 : dict;
+			if(bits == 0 || bits + symbol > s.bitcnt) {
+				err = BLAST_TRUNCATED_INPUT;
+				break;
+			}
+			s.drop(bits);
+			size_t dist = (size_t(code & 0xff) << symbol) + s.peek(symbol) + 1;
+			s.drop(symbol);
+			if(dist > next) {
+				err = BLAST_INVALID_OFFSET;
+				break;
+			}
+			
+			if(len > size - next && (!grow || !blastGrow(buf, size, next + len))) {
+				err = BLAST_OUTPUT_ERROR;
+				break;
+			}
+			
+			/* copy length bytes from distance bytes back */
+			char * to = buf + next;
+			const char * src = to - dist;
+			next += len;
+			if(dist >= len) {
+				memcpy(to, src, len);
+			} else {
+				do {
+					*to++ = *src++;
+				} while(--len);
+			}
+			
+		} else {
+			
+			/* get literal */
+			int symbol;
+			if(lit) {
+				lookup code = t.litlookup[s.peek(LITBITS)];
+				int bits = code >> 8;
+				if(bits == 0 || bits > s.bitcnt) {
+					err = BLAST_TRUNCATED_INPUT;
+					break;
+				}
+				s.drop(bits);
+				symbol = code & 0xff;
+			} else {
+				if(s.bitcnt < 8) {
+					err = BLAST_TRUNCATED_INPUT;
+					break;
+				}
+				symbol = s.peek(8);
+				s.drop(8);
+			}
+			
+			/* write it */
+			if(next == size && (!grow || !blastGrow(buf, size, next + 1))) {
+				err = BLAST_OUTPUT_ERROR;
+				break;
+			}
+			buf[next++] = char(symbol);
+			
+		}
+		
+	}
+	
+	out.buf = buf;
+	out.allocSize = size;
+	out.fillSize = next;
+	
+	return err;
+}
+
 // Additional functions.
 
+static size_t blastInNone(void * Param, const unsigned char ** buf) {
+	ARX_UNUSED(Param), ARX_UNUSED(buf);
+	return 0;
+}
+
+BlastDecoder::BlastDecoder(const char * data, size_t size, size_t checkpointInterval)
+	: m_current(new BlastState), m_windowStart(0), m_error(BLAST_SUCCESS) {
+	
+	// Checkpoints can only be taken at window boundaries.
+	m_checkpointInterval = std::max(checkpointInterval / MAXWIN, size_t(1)) * MAXWIN;
+	
+	// All input is available up front so that the decoder state is self-contained.
+	m_current->infun = blastInNone;
+	m_current->inhow = NULL;
+	m_current->in = reinterpret_cast<const unsigned char *>(data);
+	m_current->left = size;
+	m_current->bitbuf = 0;
+	m_current->bitcnt = 0;
+	m_current->outfun = NULL;
+	m_current->outhow = NULL;
+	
+	try {
+		m_error = blastBegin(m_current);
+	} catch(const blast_truncated_error &) {
+		m_error = BLAST_TRUNCATED_INPUT;
+	}
+	
+	if(!m_error) {
+		m_checkpoints.push_back(new BlastState(*m_current));
+	}
+}
+
+BlastDecoder::~BlastDecoder() {
+	
+	delete m_current;
+	
+	for(size_t i = 0; i < m_checkpoints.size(); i++) {
+		delete m_checkpoints[i];
+	}
+}
+
+size_t BlastDecoder::read(size_t offset, char * buf, size_t size) {
+	
+	if(m_checkpoints.empty()) {
+		return 0;
+	}
+	
+	// The requested data has already been discarded - restart from a checkpoint.
+	if(offset < m_windowStart) {
+		size_t index = std::min(offset / m_checkpointInterval, m_checkpoints.size() - 1);
+		*m_current = *m_checkpoints[index];
+		m_windowStart = index * m_checkpointInterval;
+		m_error = BLAST_SUCCESS;
+	}
+	
+	size_t total = 0;
+	
+	while(size) {
+		
+		size_t windowEnd = m_windowStart + m_current->next;
+		if(offset < windowEnd) {
+			size_t count = std::min(size, windowEnd - offset);
+			memcpy(buf, m_current->out + (offset - m_windowStart), count);
+			buf += count, offset += count, size -= count, total += count;
+			continue;
+		}
+		
+		if(m_error || m_current->done) {
+			break;
+		}
+		
+		if(m_current->next == MAXWIN) {
+			m_windowStart += MAXWIN;
+			m_current->next = 0;
+			m_current->first = 0;
+			if(m_windowStart == m_checkpoints.size() * m_checkpointInterval) {
+				m_checkpoints.push_back(new BlastState(*m_current));
+			}
+		}
+		
+		try {
+			m_error = blastFillWindow(m_current);
+		} catch(const blast_truncated_error &) {
+			m_error = BLAST_TRUNCATED_INPUT;
+		}
+	}
+	
+	return total;
+}
+
 int blastOutMem(void * Param, unsigned char * buf, size_t len) {
 	
 	BlastMemOutBuffer * p = (BlastMemOutBuffer *)Param;
@@ -470,6 +856,7 @@ int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len) {
 		char * newBuf = (char *)realloc(p->buf, p->allocSize);
 		if(!newBuf) {
 			free(p->buf);
+			p->buf = NULL;
 			p->allocSize = 0;
 			p->fillSize = 0;
 			return 1;
@@ -484,14 +871,26 @@ int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len) {
 	return 0;
 }
 
+static bool g_blastUseReferenceDecoder = false;
+
+void blastUseReferenceDecoder(bool enable) {
+	g_blastUseReferenceDecoder = enable;
+}
+
 char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize) {
 	
 	BlastMemInBuffer in(from, fromSize);
 	BlastMemOutBufferRealloc out;
 	
-	BlastResult error = blast(blastInMem, &in, blastOutMemRealloc, &out);
+	BlastResult error;
+	if(g_blastUseReferenceDecoder) {
+		error = blast(blastInMem, &in, blastOutMemRealloc, &out);
+	} else {
+		error = blastTable(from, fromSize, out, true);
+	}
 	if(error) {
 		LogError << "blastMemAlloc error " << error << " for " << fromSize;
+		free(out.buf);
 		toSize = 0;
 		return NULL;
 	}
@@ -505,6 +904,16 @@ char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize) {
 
 size_t blastMem(const char * from, size_t fromSize, char * to, size_t toSize) {
 	
+	if(!g_blastUseReferenceDecoder) {
+		BlastMemOutBufferRealloc out(to, toSize, 0);
+		BlastResult error = blastTable(from, fromSize, out, false);
+		if(error) {
+			LogError << "blastMem error " << error << " for " << fromSize << "/" << toSize;
+			return 0;
+		}
+		return out.fillSize;
+	}
+	
 	BlastMemInBuffer in(from, fromSize);
 	BlastMemOutBuffer out(to, toSize);
 	
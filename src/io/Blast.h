@@ -46,6 +46,8 @@
 
 #include <stddef.h>
 
+#include <vector>
+
 /*
  * blast() decompresses the PKWare Data Compression Library (DCL) compressed
  * format.  It provides the same functionality as the explode() function in
@@ -157,7 +159,63 @@ char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize);
 
 /*!
  * Decompress data.
+ *
+ * blastMem() and blastMemAlloc() use a table-driven decoder that is considerably
+ * faster than the generic blast() for data that is already in memory.
  */
 size_t blastMem(const char * from, size_t fromSize, char * to, size_t toSize);
 
+/*!
+ * Make blastMem() and blastMemAlloc() use blast() instead of the table-driven
+ * decoder. This is only intended for benchmarks and to verify the faster decoder.
+ * Must not be called while other threads are decompressing data.
+ */
+void blastUseReferenceDecoder(bool enable);
+
+struct BlastState;
+
+/*!
+ * Random access to compressed data that is fully available in memory.
+ *
+ * Consecutive reads continue decompressing where the previous read stopped and the
+ * most recently decompressed block is kept to serve repeated reads. The decoder
+ * state is saved every checkpointInterval bytes of output so that seeking backwards
+ * only needs to decompress from the closest checkpoint instead of from the start.
+ */
+class BlastDecoder {
+	
+	BlastDecoder(const BlastDecoder &);
+	BlastDecoder & operator=(const BlastDecoder &);
+	
+	BlastState * m_current;
+	size_t m_windowStart; //!< Uncompressed offset of the current output window
+	std::vector<BlastState *> m_checkpoints;
+	size_t m_checkpointInterval;
+	BlastResult m_error;
+	
+public:
+	
+	/*!
+	 * \param data Compressed data - must stay valid as long as the decoder is used.
+	 * \param size Size of the compressed data.
+	 * \param checkpointInterval Distance between saved decoder states in bytes of
+	 *                           uncompressed output. Each checkpoint uses about 4 KiB.
+	 */
+	BlastDecoder(const char * data, size_t size, size_t checkpointInterval = 64 * 1024);
+	
+	~BlastDecoder();
+	
+	/*!
+	 * Decompress size bytes starting at the uncompressed offset.
+	 *
+	 * \return the number of bytes read - less than size if the end of the data has
+	 *         been reached or if there was an error (see \ref error()).
+	 */
+	size_t read(size_t offset, char * buf, size_t size);
+	
+	//! \return the first error encountered while decompressing
+	BlastResult error() const { return m_error; }
+	
+};
+
 #endif // ARX_IO_BLAST_H
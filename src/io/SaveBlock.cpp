@@ -43,7 +43,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "io/SaveBlock.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <utility>
 
 #include <boost/algorithm/string/case_conv.hpp>
 
@@ -54,6 +59,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/Blast.h"
 
 #include "platform/Platform.h"
+#include "platform/ThreadPool.h"
 
 static const u32 SAV_VERSION_OLD = (1<<16) | 0;
 static const u32 SAV_VERSION_RELEASE = (1<<16) | 1;
@@ -70,6 +76,100 @@ static const u32 SAV_SIZE_UNKNOWN = 0xffffffff;
 static const char BADSAVCHAR[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ\\/.";
 #endif
 
+namespace {
+
+//! Read-only stream buffer for data that is already in memory.
+class MemoryStreamBuffer : public std::streambuf {
+	
+public:
+	
+	MemoryStreamBuffer(const char * data, size_t size) {
+		char * begin = const_cast<char *>(data);
+		setg(begin, begin, begin + size);
+	}
+	
+protected:
+	
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+		
+		if(which & std::ios_base::out) {
+			return pos_type(off_type(-1));
+		}
+		
+		off_type pos = off;
+		if(dir == std::ios_base::cur) {
+			pos += gptr() - eback();
+		} else if(dir == std::ios_base::end) {
+			pos += egptr() - eback();
+		}
+		
+		if(pos < 0 || pos > egptr() - eback()) {
+			return pos_type(off_type(-1));
+		}
+		
+		setg(eback(), eback() + pos, egptr());
+		
+		return pos_type(pos);
+	}
+	
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+	
+};
+
+} // anonymous namespace
+
+//! Maximum number of queued files per worker thread before saveAsync() blocks.
+static const size_t MAX_PENDING_PER_THREAD = 4;
+
+/*!
+ * Compress a file for the save block.
+ * \return a new[]-allocated buffer with the deflated data or NULL if the data
+ *         could not be compressed to less than its original size.
+ */
+static char * compressFile(const char * data, size_t size, size_t & compressedSize) {
+	
+	if(size == 0) {
+		return NULL;
+	}
+	
+	uLongf destSize = size - 1;
+	char * compressed = new char[destSize];
+	if(compress2((Bytef*)compressed, &destSize, (const Bytef*)data, size, 1) != Z_OK) {
+		delete[] compressed;
+		return NULL;
+	}
+	
+	compressedSize = destSize;
+	return compressed;
+}
+
+class SaveBlock::CompressJob : public ThreadPool::Job {
+	
+public:
+	
+	const std::string name;
+	char * const data;
+	const size_t size;
+	
+	char * compressed;
+	size_t compressedSize;
+	
+	CompressJob(const std::string & _name, char * _data, size_t _size)
+		: name(_name), data(_data), size(_size), compressed(NULL), compressedSize(0) { }
+	
+	~CompressJob() {
+		delete[] data;
+		delete[] compressed;
+	}
+	
+	void run() {
+		compressed = compressFile(data, size, compressedSize);
+	}
+	
+};
+
 const char * SaveBlock::File::compressionName() const {
 	switch(comp) {
 		case None: return "none";
@@ -173,7 +273,8 @@ void SaveBlock::File::writeEntry(std::ostream & handle, const std::string & name
 	
 }
 
-char * SaveBlock::File::loadData(std::istream & handle, size_t & size, const std::string & name) const {
+char * SaveBlock::File::loadData(std::istream & handle, const fs::mapped_file * mapping,
+                                 size_t & size, const std::string & name) const {
 	
 	LogDebug("Loading " << name << ' ' << storedSize << "b in " << chunks.size() << " chunks, "
 	         << compressionName() << " -> " << (int)uncompressedSize << "b");
@@ -183,13 +284,35 @@ char * SaveBlock::File::loadData(std::istream & handle, size_t & size, const std
 		return NULL;
 	}
 	
+	if(mapping) {
+		
+		for(File::ChunkList::const_iterator chunk = chunks.begin();
+		    chunk != chunks.end(); ++chunk) {
+			if(chunk->offset + 4 > mapping->size()
+			   || chunk->size > mapping->size() - chunk->offset - 4) {
+				LogError << "Data for " << name << " is outside the save file";
+				size = 0;
+				return NULL;
+			}
+		}
+		
+		if(comp == File::Deflate) {
+			return inflateMapped(mapping->data(), size, name);
+		}
+		
+	}
+	
 	char * buf = (char*)malloc(storedSize);
 	char * p = buf;
 	
 	for(File::ChunkList::const_iterator chunk = chunks.begin();
 	    chunk != chunks.end(); ++chunk) {
-		handle.seekg(chunk->offset + 4);
-		handle.read(p, chunk->size);
+		if(mapping) {
+			memcpy(p, mapping->data() + chunk->offset + 4, chunk->size);
+		} else {
+			handle.seekg(chunk->offset + 4);
+			handle.read(p, chunk->size);
+		}
 		p += chunk->size;
 	}
 	
@@ -249,11 +372,64 @@ char * SaveBlock::File::loadData(std::istream & handle, size_t & size, const std
 	}
 }
 
-SaveBlock::SaveBlock(const fs::path & _savefile) : savefile(_savefile), totalSize(0), usedSize(0), chunkCount(0) { }
+char * SaveBlock::File::inflateMapped(const char * data, size_t & size,
+                                      const std::string & name) const {
+	
+	arx_assert(uncompressedSize != (size_t)-1);
+	
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	int ret = inflateInit(&strm);
+	
+	char * uncompressed = (char*)malloc(uncompressedSize);
+	strm.next_out = reinterpret_cast<Bytef *>(uncompressed);
+	strm.avail_out = uncompressedSize;
+	
+	File::ChunkList::const_iterator chunk = chunks.begin();
+	for(; ret == Z_OK && chunk != chunks.end(); ++chunk) {
+		strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + chunk->offset + 4));
+		strm.avail_in = chunk->size;
+		ret = inflate(&strm, Z_NO_FLUSH);
+	}
+	
+	size_t decompressedSize = strm.total_out;
+	inflateEnd(&strm);
+	
+	if(ret != Z_STREAM_END) {
+		if(ret == Z_OK) {
+			ret = Z_BUF_ERROR;
+		}
+		LogError << "Error decompressing deflated " << name << ": " << zError(ret) << " (" << ret << ')';
+		free(uncompressed);
+		size = 0;
+		return NULL;
+	}
+	
+	if(decompressedSize != uncompressedSize) {
+		LogError << "Unexpedect uncompressed size " << decompressedSize << " while loading "
+		         << name << ", expected " << uncompressedSize;
+	}
+	
+	size = decompressedSize;
+	return uncompressed;
+}
 
-SaveBlock::~SaveBlock() { }
+SaveBlock::SaveBlock(const fs::path & _savefile, ThreadPool * _pool)
+	: savefile(_savefile), totalSize(0), usedSize(0), chunkCount(0), modified(false)
+	, pool(_pool), pendingFailed(false) { }
 
-bool SaveBlock::loadFileTable() {
+SaveBlock::~SaveBlock() {
+	
+	for(PendingFiles::const_iterator i = pending.begin(); i != pending.end(); ++i) {
+		if(!pool->cancel(*i)) {
+			(*i)->wait();
+		}
+		delete *i;
+	}
+	
+}
+
+bool SaveBlock::loadFileTable(std::istream & handle) {
 	
 	handle.seekg(0);
 	
@@ -302,6 +478,7 @@ bool SaveBlock::loadFileTable() {
 	
 	usedSize = 0;
 	chunkCount = 0;
+	modified = false;
 	
 	for(u32 i = 0; i < nFiles; i++) {
 		
@@ -329,7 +506,7 @@ bool SaveBlock::loadFileTable() {
 	return true;
 }
 
-void SaveBlock::writeFileTable(const std::string & important) {
+size_t SaveBlock::writeFileTable(const std::string & important) {
 	
 	LogDebug("writeFileTable " << savefile);
 	
@@ -352,20 +529,42 @@ void SaveBlock::writeFileTable(const std::string & important) {
 		}
 	}
 	
+	size_t end = handle.tellp();
+	
+	// The header is the commit point - only update it once the table is complete
+	handle.flush();
 	handle.seekp(0);
 	fs::write(handle, fatOffset);
 	
+	modified = false;
+	
+	return end;
 }
 
 bool SaveBlock::open(bool writable) {
 	
 	LogDebug("opening savefile " << savefile << " witable=" << writable);
 	
+	pendingFailed = false;
+	
 	fs::fstream::openmode mode = fs::fstream::in | fs::fstream::binary | fs::fstream::ate;
 	if(writable) {
 		mode |= fs::fstream::out;
 	}
 	
+	// Writing changes the file below the mapping - read through the handle instead
+	mapping.close();
+	
+	if(!writable && mapping.open(savefile)) {
+		MemoryStreamBuffer buffer(mapping.data(), mapping.size());
+		std::istream stream(&buffer);
+		if(!loadFileTable(stream)) {
+			LogError << "Broken save file";
+			return false;
+		}
+		return true;
+	}
+	
 	handle.clear();
 	handle.open(savefile, mode);
 	if(!handle.is_open()) {
@@ -380,7 +579,7 @@ bool SaveBlock::open(bool writable) {
 		}
 	}
 	
-	if(handle.tellg() > 0 && !loadFileTable()) {
+	if(handle.tellg() > 0 && !loadFileTable(handle)) {
 		LogError << "Broken save file";
 		return false;
 	}
@@ -393,14 +592,24 @@ bool SaveBlock::flush(const std::string & important) {
 	arx_assert(important.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", important.c_str());
 	
+	if(!finishPending()) {
+		return false;
+	}
+	
+	bool defragmented = false;
 	if((usedSize * 2 < totalSize || chunkCount > (files.size() * 4 / 3))) {
-		defragment();
+		defragmented = defragment();
 	}
 	
-	writeFileTable(important);
+	size_t end = writeFileTable(important);
 	
 	handle.flush();
 	
+	if(defragmented && handle.good()) {
+		// Drop the data that was moved and any old file table past the end
+		fs::resize_file(savefile, end);
+	}
+	
 	return handle.good();
 }
 
@@ -409,6 +618,94 @@ bool SaveBlock::defragment() {
 	LogDebug("defragmenting " << savefile << " save: using " << usedSize << " / " << totalSize
 	         << " b for " << files.size() << " files in " << chunkCount << " chunks");
 	
+	if(!modified) {
+		/*
+		 * Moving chunks in place would destroy the intact on-disk file table if we crash.
+		 * Once data has been written this is no longer a concern: appending overwrites
+		 * the old table and rewriting files in place changes their chunk sizes.
+		 */
+		return rewrite();
+	}
+	
+	std::vector<char> buf;
+	
+	// Append files that are split into multiple chunks as a single chunk
+	for(Files::iterator file = files.begin(); file != files.end(); ++file) {
+		
+		if(file->second.storedSize == 0) {
+			file->second.chunks.clear();
+			continue;
+		}
+		
+		if(file->second.chunks.size() == 1) {
+			continue;
+		}
+		
+		buf.resize(file->second.storedSize);
+		char * p = &buf[0];
+		
+		for(File::ChunkList::iterator chunk = file->second.chunks.begin();
+		    chunk != file->second.chunks.end(); ++chunk) {
+			handle.seekg(chunk->offset + 4);
+			handle.read(p, chunk->size);
+			p += chunk->size;
+		}
+		
+		arx_assert(p == &buf[0] + file->second.storedSize);
+		
+		handle.seekp(totalSize + 4);
+		handle.write(&buf[0], file->second.storedSize);
+		
+		file->second.chunks.resize(1);
+		file->second.chunks.front().offset = totalSize;
+		file->second.chunks.front().size = file->second.storedSize;
+		
+		totalSize += file->second.storedSize;
+	}
+	
+	// Move all chunks after the first hole toward the start of the file
+	typedef std::vector< std::pair<size_t, File::Chunk *> > Chunks;
+	Chunks chunks;
+	chunks.reserve(files.size());
+	for(Files::iterator file = files.begin(); file != files.end(); ++file) {
+		if(!file->second.chunks.empty()) {
+			File::Chunk * chunk = &file->second.chunks.front();
+			chunks.push_back(std::make_pair(chunk->offset, chunk));
+		}
+	}
+	std::sort(chunks.begin(), chunks.end());
+	
+	size_t end = 0;
+	for(Chunks::const_iterator i = chunks.begin(); i != chunks.end(); ++i) {
+		
+		File::Chunk * chunk = i->second;
+		
+		arx_assert(chunk->offset >= end);
+		
+		if(chunk->offset != end) {
+			buf.resize(chunk->size);
+			handle.seekg(chunk->offset + 4);
+			handle.read(&buf[0], chunk->size);
+			handle.seekp(end + 4);
+			handle.write(&buf[0], chunk->size);
+			chunk->offset = end;
+		}
+		
+		end += chunk->size;
+	}
+	
+	totalSize = usedSize = end, chunkCount = chunks.size();
+	
+	if(handle.fail()) {
+		LogWarning << "Defragmenting failed: " << savefile;
+		return false;
+	}
+	
+	return true;
+}
+
+bool SaveBlock::rewrite() {
+	
 	fs::path tempFileName = savefile;
 	int i = 0;
 	
@@ -484,6 +781,78 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
 	
+	if(!finishPending()) {
+		return false;
+	}
+	
+	size_t compressedSize = 0;
+	char * compressed = compressFile(data, size, compressedSize);
+	
+	bool ret = write(name, data, size, compressed, compressedSize);
+	
+	delete[] compressed;
+	
+	return ret;
+}
+
+void SaveBlock::saveAsync(const std::string & name, char * data, size_t size) {
+	
+	if(!pool) {
+		if(!save(name, data, size)) {
+			pendingFailed = true;
+		}
+		delete[] data;
+		return;
+	}
+	
+	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
+	           "bad save filename: \"%s\"", name.c_str());
+	
+	// Bound the memory held by queued files
+	while(pending.size() >= pool->getThreadCount() * MAX_PENDING_PER_THREAD) {
+		writePending();
+	}
+	
+	CompressJob * job = new CompressJob(name, data, size);
+	pending.push_back(job);
+	pool->submit(job);
+}
+
+bool SaveBlock::writePending() {
+	
+	arx_assert(!pending.empty());
+	
+	CompressJob * job = pending.front();
+	pending.pop_front();
+	
+	job->wait();
+	
+	bool ret = false;
+	if(handle) {
+		ret = write(job->name, job->data, job->size, job->compressed, job->compressedSize);
+	}
+	if(!ret) {
+		LogError << "Could not save " << job->name << " to " << savefile;
+		pendingFailed = true;
+	}
+	
+	delete job;
+	
+	return ret;
+}
+
+bool SaveBlock::finishPending() {
+	
+	while(!pending.empty()) {
+		writePending();
+	}
+	
+	return !pendingFailed;
+}
+
+bool SaveBlock::write(const std::string & name, const char * data, size_t size,
+                      const char * compressed, size_t compressedSize) {
+	
 	File * file = &files[name];
 	
 	file->uncompressedSize = size;
@@ -491,13 +860,19 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 	if(size == 0) {
 		file->comp = File::None;
 		file->storedSize = 0;
+		for(File::ChunkList::const_iterator chunk = file->chunks.begin();
+		    chunk != file->chunks.end(); ++chunk) {
+			usedSize -= chunk->size;
+		}
+		chunkCount -= file->chunks.size();
+		file->chunks.clear();
 		return true;
 	}
 	
-	uLongf compressedSize = size - 1;
-	char * compressed = new char[compressedSize];
+	modified = true;
+	
 	const char * p;
-	if(compress2((Bytef*)compressed, &compressedSize, (const Bytef*)data, size, 1) == Z_OK) {
+	if(compressed) {
 		file->comp = File::Deflate;
 		file->storedSize = compressedSize;
 		p = compressed;
@@ -527,7 +902,6 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 		
 		if(remaining == 0) {
 			file->chunks.erase(++chunk, file->chunks.end());
-			delete[] compressed;
 			return true;
 		}
 	}
@@ -537,13 +911,25 @@ bool SaveBlock::save(const std::string & name, const char * data, size_t size) {
 	handle.write(p, remaining);
 	totalSize += remaining, usedSize += remaining, chunkCount++;
 	
-	delete[] compressed;
-	
 	return !handle.fail();
 }
 
 void SaveBlock::remove(const std::string & name) {
-	files.erase(name);
+	
+	finishPending();
+	
+	Files::iterator file = files.find(name);
+	if(file == files.end()) {
+		return;
+	}
+	
+	for(File::ChunkList::const_iterator chunk = file->second.chunks.begin();
+	    chunk != file->second.chunks.end(); ++chunk) {
+		usedSize -= chunk->size;
+	}
+	chunkCount -= file->second.chunks.size();
+	
+	files.erase(file);
 }
 
 char * SaveBlock::load(const std::string & name, size_t & size) {
@@ -551,15 +937,55 @@ char * SaveBlock::load(const std::string & name, size_t & size) {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
 	
+	finishPending();
+	
 	Files::const_iterator file = files.find(name);
 	
-	return (file == files.end()) ? NULL : file->second.loadData(handle, size, name);
+	if(file == files.end()) {
+		return NULL;
+	}
+	
+	return file->second.loadData(handle, mapping.is_open() ? &mapping : NULL, size, name);
+}
+
+const char * SaveBlock::loadBorrowed(const std::string & name, size_t & size) {
+	
+	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
+	           "bad save filename: \"%s\"", name.c_str());
+	
+	if(!mapping.is_open()) {
+		return NULL;
+	}
+	
+	Files::const_iterator file = files.find(name);
+	if(file == files.end() || file->second.comp != File::None || file->second.chunks.size() != 1) {
+		return NULL;
+	}
+	
+	const File::Chunk & chunk = file->second.chunks.front();
+	if(chunk.offset + 4 > mapping.size() || chunk.size > mapping.size() - chunk.offset - 4) {
+		return NULL;
+	}
+	
+	size = chunk.size;
+	return mapping.data() + chunk.offset + 4;
 }
 
 bool SaveBlock::hasFile(const std::string & name) const {
 	arx_assert(name.find_first_of(BADSAVCHAR) == std::string::npos,
 	           "bad save filename: \"%s\"", name.c_str());
-	return (files.find(name) != files.end());
+	
+	if(files.find(name) != files.end()) {
+		return true;
+	}
+	
+	for(PendingFiles::const_iterator i = pending.begin(); i != pending.end(); ++i) {
+		if((*i)->name == name) {
+			return true;
+		}
+	}
+	
+	return false;
 }
 
 std::vector<std::string> SaveBlock::getFiles() const {
@@ -570,6 +996,14 @@ std::vector<std::string> SaveBlock::getFiles() const {
 		result.push_back(file->first);
 	}
 	
+	// Queued files are only added to the file table once they have been written
+	for(PendingFiles::const_iterator i = pending.begin(); i != pending.end(); ++i) {
+		if(files.find((*i)->name) == files.end()
+		   && std::find(result.begin(), result.end(), (*i)->name) == result.end()) {
+			result.push_back((*i)->name);
+		}
+	}
+	
 	return result;
 }
 
@@ -582,12 +1016,26 @@ char * SaveBlock::load(const fs::path & savefile, const std::string & filename,
 	
 	size = 0;
 	
+	fs::mapped_file mapping;
+	if(mapping.open(savefile)) {
+		MemoryStreamBuffer buffer(mapping.data(), mapping.size());
+		std::istream handle(&buffer);
+		return loadFile(handle, &mapping, savefile, filename, size);
+	}
+	
 	fs::ifstream handle(savefile, fs::fstream::in | fs::fstream::binary);
 	if(!handle.is_open()) {
 		LogWarning << "Cannot open save file " << savefile;
 		return NULL;
 	}
 	
+	return loadFile(handle, NULL, savefile, filename, size);
+}
+
+char * SaveBlock::loadFile(std::istream & handle, const fs::mapped_file * mapping,
+                           const fs::path & savefile, const std::string & filename,
+                           size_t & size) {
+	
 	u32 fatOffset;
 	if(fs::read(handle, fatOffset).fail()) {
 		return NULL;
@@ -639,7 +1087,7 @@ char * SaveBlock::load(const fs::path & savefile, const std::string & filename,
 			continue;
 		}
 		
-		return file.loadData(handle, size, name);
+		return file.loadData(handle, mapping, size, name);
 	}
 	
 	return NULL;
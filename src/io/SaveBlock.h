@@ -45,6 +45,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #define ARX_IO_SAVEBLOCK_H
 
 #include <stddef.h>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -53,6 +54,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "platform/Platform.h"
 #include "io/fs/FilePath.h"
 #include "io/fs/FileStream.h"
+#include "io/fs/MappedFile.h"
+
+class ThreadPool;
 
 /*!
  * Interface to read and write save block files. (used for savegames)
@@ -93,42 +97,101 @@ private:
 		
 		void writeEntry(std::ostream & handle, const std::string & name) const;
 		
-		char * loadData(std::istream & handle, size_t & size, const std::string & name) const;
+		/*!
+		 * Load and decompress the file contents.
+		 * \param mapping Memory-mapped save file to read from instead of handle or NULL.
+		 */
+		char * loadData(std::istream & handle, const fs::mapped_file * mapping, size_t & size,
+		                const std::string & name) const;
+		
+		//! Inflate the chunks of a deflated file straight from the mapped save file.
+		char * inflateMapped(const char * data, size_t & size, const std::string & name) const;
 		
 	};
 	
 	typedef boost::unordered_map<std::string, File> Files;
 	
+	class CompressJob;
+	typedef std::deque<CompressJob *> PendingFiles;
+	
 	fs::path savefile;
 	fs::fstream handle;
+	fs::mapped_file mapping;
 	size_t totalSize;
 	size_t usedSize;
 	size_t chunkCount;
 	Files files;
 	
+	//! Data has been written since the file table was last loaded or written.
+	bool modified;
+	
+	ThreadPool * pool;
+	PendingFiles pending;
+	
+	//! Writing a file queued by saveAsync() has failed since the block was opened.
+	bool pendingFailed;
+	
+	/*!
+	 * Remove holes and merge chunks.
+	 *
+	 * If the on-disk file table is still intact, the block is copied to a new file to
+	 * keep it that way. Otherwise chunks are moved toward the start of the file in
+	 * place.
+	 */
 	bool defragment();
-	bool loadFileTable();
-	void writeFileTable(const std::string & important);
+	bool rewrite();
+	
+	bool loadFileTable(std::istream & handle);
+	
+	//! \return the file offset after the end of the file table.
+	size_t writeFileTable(const std::string & important);
+	
+	static char * loadFile(std::istream & handle, const fs::mapped_file * mapping,
+	                       const fs::path & savefile, const std::string & filename,
+	                       size_t & size);
+	
+	bool write(const std::string & name, const char * data, size_t size,
+	           const char * compressed, size_t compressedSize);
+	
+	//! Write the oldest file queued by saveAsync() once it has been compressed.
+	bool writePending();
+	
+	/*!
+	 * Write all files queued by saveAsync().
+	 * \return false if any queued file could not be written since the block was opened.
+	 */
+	bool finishPending();
 	
 public:
 	
-	explicit SaveBlock(const fs::path & savefile);
+	/*!
+	 * \param pool Thread pool used to compress files passed to saveAsync() or NULL to
+	 *             compress them on the calling thread.
+	 */
+	explicit SaveBlock(const fs::path & savefile, ThreadPool * pool = NULL);
 	
 	/*!
 	 * Destructor: this will not finalize the save block.
 	 * 
 	 * If the SaveBlock vas changed (via save()) and not flushed since, the save fill will be corrupted.
+	 * Files queued with saveAsync() that have not been written yet are discarded.
 	 */
 	~SaveBlock();
 	
 	/*!
 	 * Open a save block.
+	 *
+	 * Read-only save blocks are memory-mapped if possible: the file table is parsed and
+	 * files are decompressed directly from the mapping.
+	 *
 	 * \param writable must be true if the block is going to be changed
 	 */
 	bool open(bool writable = false);
 	
 	/*!
-	 * Finalize the save block: defragment if needed and write the file table.
+	 * Finalize the save block: write queued files, defragment if needed and write the
+	 * file table.
+	 * \return false if the block or any file queued with saveAsync() could not be written.
 	 */
 	bool flush(const std::string & important);
 	
@@ -140,12 +203,38 @@ public:
 	 */
 	bool save(const std::string & name, const char * data, size_t size);
 	
+	/*!
+	 * Queue a file to be saved to the save block.
+	 *
+	 * The file is compressed on the thread pool and written to the block in the order
+	 * files were queued, before the next call to save(), load(), remove() or flush().
+	 * Like save(), this does not update the on-disk file table - flush() still needs to
+	 * be called to commit the changes. hasFile() and getFiles() already include the
+	 * queued file. Write errors are reported by the next save() or flush().
+	 *
+	 * \param data File contents allocated with new[] - the SaveBlock takes ownership.
+	 */
+	void saveAsync(const std::string & name, char * data, size_t size);
+	
 	/*!
 	 * Remove a file from the save block.
 	 */
 	void remove(const std::string & name);
 	
 	char * load(const std::string & name, size_t & size);
+	
+	/*!
+	 * Get the contents of an uncompressed file without copying them.
+	 *
+	 * The returned data points into the memory-mapped save file and stays valid until
+	 * the SaveBlock is destroyed. It must not be modified or freed.
+	 *
+	 * \return NULL if the file does not exist or if its contents are not directly
+	 *         available (the block is not memory-mapped or the file is compressed
+	 *         or fragmented) - use load() in that case.
+	 */
+	const char * loadBorrowed(const std::string & name, size_t & size);
+	
 	bool hasFile(const std::string & name) const;
 	
 	std::vector<std::string> getFiles() const;
@@ -159,7 +248,8 @@ public:
 	 *  return block.open(false) ? block.load(name, size) : NULL
 	 * </pre>
 	 * 
-	 * This is optimized for loading the file named in flush().
+	 * This is optimized for loading the file named in flush(): the file table is only
+	 * parsed up to the requested entry and the save file is memory-mapped if possible.
 	 * 
 	 * \param savefile the save block to load from
 	 * \param name the file to load
@@ -119,6 +119,16 @@ bool copy_file(const path & from_p, const path & to_p, bool overwrite = false);
  */
 bool rename(const path & old_p, const path & new_p, bool overwrite = false);
 
+/*!
+ * \brief Change the size of a regular file
+ *
+ * If the file is shortened, data past the new size is discarded.
+ * If it is extended, the new space is filled with zeros.
+ *
+ * \return true if the file was resized or false if there was an error.
+ */
+bool resize_file(const path & p, u64 size);
+
 /*!
  * \brief Read a file into memory
  *
@@ -110,6 +110,12 @@ bool rename(const path & old_p, const path & new_p, bool overwrite) {
 	return !ec;
 }
 
+bool resize_file(const path & p, u64 size) {
+	error_code ec;
+	fs_boost::resize_file(p.string(), size, ec);
+	return !ec;
+}
+
 path current_path() {
 	return fs_boost::current_path().string();
 }
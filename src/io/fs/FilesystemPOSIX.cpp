@@ -165,6 +165,10 @@ bool rename(const path & old_p, const path & new_p, bool overwrite) {
 	return !::rename(old_p.string().c_str(), new_p.string().c_str());
 }
 
+bool resize_file(const path & p, u64 size) {
+	return !truncate(p.string().c_str(), off_t(size));
+}
+
 path current_path() {
 	
 	size_t intitial_length = 1024;
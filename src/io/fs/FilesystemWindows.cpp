@@ -221,6 +221,21 @@ bool rename(const path & old_p, const path & new_p, bool overwrite) {
 	return ret;
 }
 
+bool resize_file(const path & p, u64 size) {
+	HANDLE hFile = CreateFileA(p.string().c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER newSize;
+	newSize.QuadPart = size;
+	bool ret = SetFilePointerEx(hFile, newSize, NULL, FILE_BEGIN) && SetEndOfFile(hFile);
+	if(!ret) {
+		LogWarning << "SetEndOfFile(" << p << ", " << size << ") failed! " << getLastErrorString();
+	}
+	::CloseHandle(hFile);
+	return ret;
+}
+
 path current_path() {
 	std::vector<char> buffer(GetCurrentDirectoryA(0, NULL));
 	DWORD length = GetCurrentDirectoryA(buffer.size(), &buffer.front());
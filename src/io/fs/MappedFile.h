@@ -0,0 +1,74 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_FS_MAPPEDFILE_H
+#define ARX_IO_FS_MAPPEDFILE_H
+
+#include <stddef.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace fs {
+
+class path;
+
+/*!
+ * \brief Read-only memory mapping of a whole file
+ *
+ * Not all platforms support memory-mapped files - callers must check
+ * \ref is_open() and fall back to regular file streams if needed.
+ */
+class mapped_file : private boost::noncopyable {
+	
+	const char * m_data;
+	size_t m_size;
+	void * m_handle;
+	
+public:
+	
+	mapped_file() : m_data(NULL), m_size(0), m_handle(NULL) { }
+	
+	explicit mapped_file(const path & p);
+	
+	~mapped_file() { close(); }
+	
+	/*!
+	 * \brief Map a file into memory
+	 *
+	 * Any previously mapped file is unmapped first.
+	 *
+	 * \return true if the file was mapped, false if there was an error, the file
+	 *         is empty or memory-mapped files are not supported.
+	 */
+	bool open(const path & p);
+	
+	void close();
+	
+	bool is_open() const { return m_data != NULL; }
+	
+	//! \return the start of the mapped file - valid until the mapping is closed
+	const char * data() const { return m_data; }
+	
+	size_t size() const { return m_size; }
+	
+};
+
+} // namespace fs
+
+#endif // ARX_IO_FS_MAPPEDFILE_H
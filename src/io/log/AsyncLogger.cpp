@@ -0,0 +1,179 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "io/log/AsyncLogger.h"
+
+#include <boost/foreach.hpp>
+
+namespace logger {
+
+void Async::Writer::run() {
+	
+	m_logger.m_writerId = getCurrentThreadId();
+	m_logger.m_started.post();
+	
+	for(;;) {
+		
+		if(m_logger.write()) {
+			continue;
+		}
+		
+		{
+			Autolock lock(m_logger.m_queueLock);
+			if(m_logger.m_stop) {
+				break;
+			}
+			if(!m_logger.m_queue.empty()) {
+				continue;
+			}
+			// The next call to log() will wake us up
+			m_logger.m_sleeping = true;
+		}
+		
+		m_logger.m_wakeup.wait();
+	}
+}
+
+Async::Async()
+	: m_sleeping(false)
+	, m_stop(false)
+	, m_writerId()
+	, m_writer(*this)
+{
+	
+	m_queue.reserve(QueueSize);
+	m_writing.reserve(QueueSize);
+	
+	m_writer.start();
+	m_started.wait();
+}
+
+Async::~Async() {
+	
+	{
+		Autolock lock(m_queueLock);
+		m_stop = true;
+		if(m_sleeping) {
+			m_sleeping = false;
+			m_wakeup.post();
+		}
+	}
+	m_writer.waitForCompletion();
+	
+	write();
+	
+	BOOST_FOREACH(Backend * backend, m_backends) {
+		delete backend;
+	}
+}
+
+void Async::add(Backend * backend) {
+	
+	if(backend != NULL) {
+		Autolock lock(m_writeLock);
+		m_backends.push_back(backend);
+	}
+}
+
+void Async::log(const Source & file, int line, Logger::LogLevel level, const std::string & str) {
+	
+	if(Thread::getCurrentThreadId() == m_writerId) {
+		// Don't wait for ourselves if the queue is full
+		Autolock lock(m_writeLock);
+		BOOST_FOREACH(Backend * backend, m_backends) {
+			backend->log(file, line, level, str);
+		}
+		return;
+	}
+	
+	bool full;
+	{
+		Autolock lock(m_queueLock);
+		
+		m_queue.resize(m_queue.size() + 1);
+		Entry & entry = m_queue.back();
+		entry.source = file;
+		entry.line = line;
+		entry.level = level;
+		entry.message = str;
+		full = (m_queue.size() >= QueueSize);
+		
+		if(m_sleeping) {
+			m_sleeping = false;
+			m_wakeup.post();
+		}
+	}
+	
+	if(level == Logger::Critical) {
+		// Make sure the message is written before we exit
+		flush();
+	} else if(full) {
+		// Help the background thread
+		write();
+	}
+}
+
+bool Async::write() {
+	
+	Autolock lock(m_writeLock);
+	
+	{
+		Autolock queueLock(m_queueLock);
+		m_writing.swap(m_queue);
+	}
+	
+	if(m_writing.empty()) {
+		return false;
+	}
+	
+	BOOST_FOREACH(const Entry & entry, m_writing) {
+		BOOST_FOREACH(Backend * backend, m_backends) {
+			backend->log(entry.source, entry.line, entry.level, entry.message);
+		}
+	}
+	
+	m_writing.clear();
+	
+	return true;
+}
+
+void Async::flush() {
+	
+	write();
+	
+	Autolock lock(m_writeLock);
+	BOOST_FOREACH(Backend * backend, m_backends) {
+		backend->flush();
+	}
+}
+
+void Async::quickShutdown() {
+	
+	// If the background thread crashed it may be holding the lock
+	if(Thread::getCurrentThreadId() != m_writerId) {
+		write();
+	}
+	
+	BOOST_FOREACH(Backend * backend, m_backends) {
+		backend->quickShutdown();
+	}
+}
+
+} // namespace logger
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ARX_IO_LOG_ASYNCLOGGER_H
+#define ARX_IO_LOG_ASYNCLOGGER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "io/log/LogBackend.h"
+#include "platform/Lock.h"
+#include "platform/Semaphore.h"
+#include "platform/Thread.h"
+
+namespace logger {
+
+/*!
+ * Logger that forwards log entries to other backends from a background thread.
+ *
+ * Logging only copies the message into a queue, so slow file or console output
+ * does not stall the game thread. If the queue is full, the logging thread writes
+ * the queued entries itself.
+ *
+ * Logger::log() already calls all backends under one lock, so the queue is
+ * protected by a plain lock instead of a lock-free structure.
+ *
+ * Critical errors and explicit flushes are written synchronously.
+ */
+class Async : public Backend {
+	
+public:
+	
+	Async();
+	
+	//! Write all remaining entries and delete the added backends
+	~Async();
+	
+	/*!
+	 * Add a backend that receives log entries from the background thread.
+	 * The backend is deleted together with this logger. A NULL parameter is ignored.
+	 */
+	void add(Backend * backend);
+	
+	void log(const Source & file, int line, Logger::LogLevel level, const std::string & str);
+	
+	//! Wait until all queued entries have been written and flush the backends
+	void flush();
+	
+	//! Synchronously write all queued entries and shut down the backends
+	void quickShutdown();
+	
+private:
+	
+	static const size_t QueueSize = 1024;
+	
+	struct Entry {
+		Source           source;
+		int              line;
+		Logger::LogLevel level;
+		std::string      message;
+	};
+	
+	typedef std::vector<Entry> Queue;
+	
+	class Writer : public Thread {
+		
+		Async & m_logger;
+		
+	public:
+		
+		explicit Writer(Async & logger) : m_logger(logger) {
+			setThreadName("Logger");
+		}
+		
+		void run();
+		
+	};
+	
+	Lock                   m_queueLock; //!< Protects m_queue, m_sleeping and m_stop
+	Queue                  m_queue;
+	bool                   m_sleeping;
+	bool                   m_stop;
+	
+	Lock                   m_writeLock; //!< Protects m_writing and m_backends
+	Queue                  m_writing;
+	std::vector<Backend *> m_backends;
+	
+	Semaphore              m_wakeup;
+	Semaphore              m_started;
+	thread_id_type         m_writerId; //!< Set before the constructor returns
+	Writer                 m_writer;
+	
+	/*!
+	 * Write all queued entries to the backends.
+	 * \return false if there was nothing to write
+	 */
+	bool write();
+	
+};
+
+} // namespace logger
+
+#endif // ARX_IO_LOG_ASYNCLOGGER_H
@@ -119,6 +119,20 @@ void LogManager::deleteAllBackends() {
 
 } // anonymous namespace
 
+boost::atomic<u32> Logger::generation(1);
+
+Logger::LogLevel Logger::resolve(const char * file, logger::SourceCache & cache) {
+	
+	Autolock lock(LogManager::lock);
+	
+	LogLevel level = LogManager::getSource(file)->level;
+	
+	u32 state = (generation.load(boost::memory_order_relaxed) << 3) | u32(level);
+	cache.state.store(state, boost::memory_order_relaxed);
+	
+	return level;
+}
+
 void Logger::add(logger::Backend * backend) {
 	
 	Autolock lock(LogManager::lock);
@@ -164,7 +178,6 @@ void Logger::log(const char * file, int line, LogLevel level, const std::string
 		(*i)->log(*source, line, level, str);
 	}
 	
-	LogManager::lock.unlock();
 }
 
 void Logger::set(const std::string & prefix, Logger::LogLevel level) {
@@ -197,6 +210,7 @@ void Logger::set(const std::string & prefix, Logger::LogLevel level) {
 	LogManager::minimumLevel = std::min(LogManager::minimumLevel, level);
 	
 	LogManager::sources.clear();
+	generation++;
 }
 
 void Logger::reset(const std::string & prefix) {
@@ -219,6 +233,7 @@ void Logger::reset(const std::string & prefix) {
 	LogManager::rules.erase(i);
 	
 	LogManager::sources.clear();
+	generation++;
 }
 
 void Logger::flush() {
@@ -275,9 +290,11 @@ void Logger::configure(const std::string config) {
 	
 }
 
-void Logger::initialize() {
+void Logger::initialize(bool console) {
 	
-	add(logger::Console::get());
+	if(console) {
+		add(logger::Console::get());
+	}
 	
 #if ARX_PLATFORM == ARX_PLATFORM_WIN32
 	add(logger::MsvcDebugger::get());
@@ -296,6 +313,7 @@ void Logger::shutdown() {
 	
 	LogManager::sources.clear();
 	LogManager::rules.clear();
+	generation++;
 	
 	LogManager::minimumLevel = LogManager::defaultLevel;
 	
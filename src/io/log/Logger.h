@@ -23,11 +23,20 @@
 #include <sstream>
 #include <string>
 
+#include <boost/atomic.hpp>
+
 #include "platform/Platform.h"
 
+#ifdef __COUNTER__
+//! Cached log level for the current call site
+#define ARX_LOG_CACHE          ::logger::getCallSiteCache<__COUNTER__>()
+#define ARX_LOG(Level)         ::Logger(ARX_FILE, __LINE__, Level, ARX_LOG_CACHE)
+#define ARX_LOG_ENABLED(Level) ::Logger::isEnabled(ARX_FILE, Level, ARX_LOG_CACHE)
+#else
 #define ARX_LOG(Level)         ::Logger(ARX_FILE, __LINE__, Level)
-#define ARX_LOG_FORCED(Level)  ::Logger(ARX_FILE, __LINE__, Level, true)
 #define ARX_LOG_ENABLED(Level) ::Logger::isEnabled(ARX_FILE, Level)
+#endif
+#define ARX_LOG_FORCED(Level)  ::Logger(ARX_FILE, __LINE__, Level, true)
 
 #ifdef ARX_DEBUG
 //! Log a Debug message. Arguments are only evaluated if their results will be used.
@@ -62,7 +71,29 @@
 //! Test if the Error log level is enabled for the current file.
 #define LogErrorEnabled   ARX_LOG_ENABLED(::Logger::Error)
 
-namespace logger { class Backend; }
+namespace logger {
+
+class Backend;
+
+/*!
+ * Log level of a source file, cached at the call site.
+ *
+ * The level is packed together with the configuration generation it was resolved
+ * for so that it can be checked with a single load and without locking.
+ * Zero-initialized caches never match a generation.
+ */
+struct SourceCache {
+	boost::atomic<u32> state; //!< (generation << 3) | level
+};
+
+//! Separate cache for every log call site in each translation unit - see ARX_LOG_CACHE
+template <int Counter>
+static SourceCache & getCallSiteCache() {
+	static SourceCache cache;
+	return cache;
+}
+
+} // namespace logger
 
 /*!
  * Logger class that allows longging via the stream operator.
@@ -84,6 +115,12 @@ private:
 	
 	static void log(const char * file, int line, LogLevel level, const std::string & str);
 	
+	//! Incremented whenever log levels change, starts at 1
+	static boost::atomic<u32> generation;
+	
+	//! Resolve the log level for a file and store it in the cache
+	static LogLevel resolve(const char * file, logger::SourceCache & cache);
+	
 	const char * const file;
 	const int line;
 	const LogLevel level;
@@ -97,6 +134,8 @@ public:
 	       : file(_file), line(_line), level(_level), enabled(_enabled) { }
 	inline Logger(const char * _file, int _line, LogLevel _level)
 	       : file(_file), line(_line), level(_level), enabled(isEnabled(_file, _level)) { }
+	inline Logger(const char * _file, int _line, LogLevel _level, logger::SourceCache & cache)
+	       : file(_file), line(_line), level(_level), enabled(isEnabled(_file, _level, cache)) { }
 	
 	template <class T>
 	inline Logger & operator<<(const T & i) {
@@ -164,6 +203,21 @@ public:
 	 */
 	static bool isEnabled(const char * file, LogLevel level);
 	
+	/*!
+	 * Like \ref isEnabled(const char *, LogLevel) but only looks up the log level for
+	 * the file if it is not already in the cache or if log levels have changed.
+	 */
+	static bool isEnabled(const char * file, LogLevel level, logger::SourceCache & cache) {
+		u32 state = cache.state.load(boost::memory_order_relaxed);
+		LogLevel sourceLevel;
+		if((state >> 3) == generation.load(boost::memory_order_relaxed)) {
+			sourceLevel = LogLevel(state & 7);
+		} else {
+			sourceLevel = resolve(file, cache);
+		}
+		return (sourceLevel <= level);
+	}
+	
 	/*!
 	 * Flush buffered output in all logging backends.
 	 */
@@ -184,8 +238,10 @@ public:
 	
 	/*!
 	 * Initialize standard log backends.
+	 * \param console Add a backend for standard output / error. Pass false if the
+	 *                console output is handled elsewhere, e.g. by a logger::Async backend.
 	 */
-	static void initialize();
+	static void initialize(bool console = true);
 	
 	/*!
 	 * Shutdown the logging and free all registered backends.
@@ -54,6 +54,20 @@ public:
 	virtual void read(void * buf) const = 0;
 	char * readAlloc() const;
 	
+	/*!
+	 * Get the file contents without copying them.
+	 *
+	 * This is only possible for uncompressed files in memory-mapped archives.
+	 * The returned data is valid until the archive is unloaded.
+	 *
+	 * \return a pointer to size() bytes or NULL if the file contents are not
+	 *         directly available - use read() or readAlloc() instead.
+	 */
+	virtual const char * data() const { return NULL; }
+	
+	//! \return true if the file contents need to be decompressed when reading
+	virtual bool isCompressed() const { return false; }
+	
 	virtual PakFileHandle * open() const = 0;
 	
 };
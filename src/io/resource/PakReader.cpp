@@ -26,6 +26,8 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "io/log/Logger.h"
 #include "io/Blast.h"
@@ -33,13 +35,14 @@
 #include "io/fs/FilePath.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/FileStream.h"
+#include "io/fs/MappedFile.h"
+#include "platform/Lock.h"
+#include "platform/Semaphore.h"
 
 #include "util/String.h"
 
 namespace {
 
-const size_t PAK_READ_BUF_SIZE = 1024;
-
 static PakReader::ReleaseType guessReleaseType(u32 first_bytes) {
 	switch(first_bytes) {
 		case 0x46515641:
@@ -72,15 +75,32 @@ static void pakDecrypt(char * fat, size_t fat_size, PakReader::ReleaseType keyId
 	
 }
 
+/*!
+ * File stream for a .pak file archive that could not be memory-mapped.
+ *
+ * The stream position is shared by all files in the archive, so it must only be
+ * used while holding the lock.
+ */
+class PakArchiveStream : public fs::ifstream {
+	
+public:
+	
+	Lock lock;
+	
+	explicit PakArchiveStream(const fs::path & p, openmode mode)
+		: fs::ifstream(p, mode) { }
+	
+};
+
 /*! Uncompressed file in a .pak file archive. */
 class UncompressedFile : public PakFile {
 	
-	std::istream & archive;
+	PakArchiveStream & archive;
 	size_t offset;
 	
 public:
 	
-	explicit UncompressedFile(std::istream * _archive, size_t _offset, size_t size)
+	explicit UncompressedFile(PakArchiveStream * _archive, size_t _offset, size_t size)
 		: PakFile(size), archive(*_archive), offset(_offset) { }
 	
 	void read(void * buf) const;
@@ -113,6 +133,8 @@ public:
 
 void UncompressedFile::read(void * buf) const {
 	
+	Autolock lock(archive.lock);
+	
 	archive.seekg(offset);
 	
 	fs::read(archive, buf, size());
@@ -133,6 +155,8 @@ size_t UncompressedFileHandle::read(void * buf, size_t size) {
 		return 0;
 	}
 	
+	Autolock lock(file.archive.lock);
+	
 	file.archive.seekg(file.offset + offset);
 	
 	if(file.size() < offset + size) {
@@ -172,36 +196,35 @@ size_t UncompressedFileHandle::tell() {
 	return offset;
 }
 
-/*! Compressed file in a .pak file archive. */
-class CompressedFile : public PakFile {
+/*! Uncompressed file in a memory-mapped .pak file archive. */
+class UncompressedMappedFile : public PakFile {
 	
-	std::ifstream & archive;
-	size_t offset;
-	size_t storedSize;
+	const char * contents;
 	
 public:
 	
-	explicit CompressedFile(std::ifstream * _archive, size_t _offset, size_t size,
-	                        size_t _storedSize)
-		: PakFile(size), archive(*_archive), offset(_offset), storedSize(_storedSize) { }
+	explicit UncompressedMappedFile(const char * _contents, size_t size)
+		: PakFile(size), contents(_contents) { }
 	
 	void read(void * buf) const;
 	
 	PakFileHandle * open() const;
 	
-	friend class CompressedFileHandle;
+	const char * data() const { return contents; }
 	
 };
 
-class CompressedFileHandle : public PakFileHandle {
+/*! Handle for reading a file that is available as one block of memory. */
+class MemoryFileHandle : public PakFileHandle {
 	
-	const CompressedFile & file;
+	const char * data;
+	size_t fileSize;
 	size_t offset;
 	
 public:
 	
-	explicit CompressedFileHandle(const CompressedFile * _file)
-		: file(*_file), offset(0) { }
+	explicit MemoryFileHandle(const char * _data, size_t size)
+		: data(_data), fileSize(size), offset(0) { }
 	
 	size_t read(void * buf, size_t size);
 	
@@ -209,137 +232,206 @@ public:
 	
 	size_t tell();
 	
-	~CompressedFileHandle() { }
+	~MemoryFileHandle() { }
 	
 };
 
-struct BlastFileInBuffer : private boost::noncopyable {
+void UncompressedMappedFile::read(void * buf) const {
+	memcpy(buf, contents, size());
+}
+
+PakFileHandle * UncompressedMappedFile::open() const {
+	return new MemoryFileHandle(contents, size());
+}
+
+size_t MemoryFileHandle::read(void * buf, size_t size) {
 	
-	std::ifstream & file;
-	size_t remaining;
+	if(offset >= fileSize) {
+		return 0;
+	}
 	
-	unsigned char readbuf[PAK_READ_BUF_SIZE];
+	size_t nread = std::min(size, fileSize - offset);
 	
-	explicit BlastFileInBuffer(std::ifstream * f, size_t count)
-		: file(*f), remaining(count) { }
+	memcpy(buf, data + offset, nread);
 	
-};
+	offset += nread;
+	
+	return nread;
+}
 
-size_t blastInFile(void * Param, const unsigned char ** buf) {
+int MemoryFileHandle::seek(Whence whence, int _offset) {
 	
-	BlastFileInBuffer * p = (BlastFileInBuffer *)Param;
+	size_t base;
+	switch(whence) {
+		case SeekSet: base = 0; break;
+		case SeekEnd: base = fileSize; break;
+		case SeekCur: base = offset; break;
+		default: return -1;
+	}
 	
-	*buf = p->readbuf;
+	if((int)base + _offset < 0) {
+		return -1;
+	}
 	
-	size_t count = std::min(p->remaining, ARRAY_SIZE(p->readbuf));
-	p->remaining -= count;
+	offset = (int)base + _offset;
 	
-	return fs::read(p->file, p->readbuf, count).gcount();
+	return offset;
 }
 
-void CompressedFile::read(void * buf) const {
+size_t MemoryFileHandle::tell() {
+	return offset;
+}
+
+/*! Base class for compressed files in a .pak file archive. */
+class CompressedFileBase : public PakFile {
 	
-	archive.seekg(offset);
+protected:
 	
-	BlastFileInBuffer in(&archive, storedSize);
-	BlastMemOutBuffer out(reinterpret_cast<char *>(buf), size());
+	size_t storedSize;
 	
-	int r = blast(blastInFile, &in, blastOutMem, &out);
-	if(r) {
-		LogError << "Blast error " << r << " outSize=" << size();
-	}
+	explicit CompressedFileBase(size_t size, size_t _storedSize)
+		: PakFile(size), storedSize(_storedSize) { }
 	
-	arx_assert(!archive.fail());
-	arx_assert(in.remaining == 0);
-	arx_assert(out.size == 0);
+public:
 	
-	archive.clear();
-}
-
-PakFileHandle * CompressedFile::open() const {
-	return new CompressedFileHandle(this);
-}
+	/*!
+	 * Get the compressed data for this file.
+	 *
+	 * \param buffer Will receive ownership of the data if it needs to be read into a
+	 *               temporary buffer.
+	 * \return a pointer to storedSize bytes - valid as long as buffer is not reset.
+	 */
+	virtual const char * readStored(boost::scoped_array<char> & buffer) const = 0;
+	
+	size_t getStoredSize() const { return storedSize; }
+	
+	bool isCompressed() const { return true; }
+	
+	void read(void * buf) const;
+	
+	PakFileHandle * open() const;
+	
+};
 
-struct BlastMemOutBufferOffset {
-	char * buf;
-	size_t currentOffset;
-	size_t startOffset;
-	size_t endOffset;
+/*! Compressed file in a .pak file archive. */
+class CompressedFile : public CompressedFileBase {
+	
+	PakArchiveStream & archive;
+	size_t offset;
+	
+public:
+	
+	explicit CompressedFile(PakArchiveStream * _archive, size_t _offset, size_t size,
+	                        size_t _storedSize)
+		: CompressedFileBase(size, _storedSize), archive(*_archive), offset(_offset) { }
+	
+	const char * readStored(boost::scoped_array<char> & buffer) const;
+	
 };
 
-int blastOutMemOffset(void * Param, unsigned char * buf, size_t len) {
+/*! Compressed file in a memory-mapped .pak file archive. */
+class CompressedMappedFile : public CompressedFileBase {
 	
-	BlastMemOutBufferOffset * p = (BlastMemOutBufferOffset *)Param;
+	const char * contents;
 	
-	arx_assert(p->currentOffset <= p->endOffset);
+public:
 	
-	if(p->currentOffset == p->endOffset) {
-		return 1;
-	}
+	explicit CompressedMappedFile(const char * _contents, size_t size, size_t _storedSize)
+		: CompressedFileBase(size, _storedSize), contents(_contents) { }
 	
-	if(p->currentOffset < p->startOffset) {
-		size_t toStart = p->startOffset - p->currentOffset;
-		if(len <= toStart) {
-			p->currentOffset += len;
-			return 0;
-		} else {
-			p->currentOffset = p->startOffset;
-			buf += toStart;
-			len -= toStart;
-		}
+	const char * readStored(boost::scoped_array<char> & buffer) const {
+		ARX_UNUSED(buffer);
+		return contents;
 	}
 	
-	size_t toCopy = std::min(len, p->endOffset - p->currentOffset);
+};
+
+/*!
+ * Handle for reading a compressed file.
+ *
+ * The decoder keeps its state between reads so that reading a file in chunks does
+ * not decompress it from the start every time.
+ */
+class CompressedFileHandle : public PakFileHandle {
 	
-	arx_assert(toCopy != 0);
+	const CompressedFileBase & file;
+	size_t offset;
 	
-	memcpy(p->buf, buf, toCopy);
+	boost::scoped_array<char> storedBuffer;
+	boost::scoped_ptr<BlastDecoder> decoder;
 	
-	p->currentOffset += toCopy;
-	p->buf += toCopy;
+public:
 	
-	return 0;
+	explicit CompressedFileHandle(const CompressedFileBase * _file)
+		: file(*_file), offset(0) { }
+	
+	size_t read(void * buf, size_t size);
+	
+	int seek(Whence whence, int offset);
+	
+	size_t tell();
+	
+	~CompressedFileHandle() { }
+	
+};
+
+void CompressedFileBase::read(void * buf) const {
+	
+	boost::scoped_array<char> buffer;
+	const char * stored = readStored(buffer);
+	
+	size_t outSize = blastMem(stored, storedSize, reinterpret_cast<char *>(buf), size());
+	
+	arx_assert(outSize == size());
+	ARX_UNUSED(outSize);
 }
 
-size_t CompressedFileHandle::read(void * buf, size_t size) {
+PakFileHandle * CompressedFileBase::open() const {
+	return new CompressedFileHandle(this);
+}
+
+const char * CompressedFile::readStored(boost::scoped_array<char> & buffer) const {
 	
-	if(offset >= file.size()) {
-		return 0;
-	}
+	// Only hold the archive lock while reading the compressed data so that other
+	// threads can access the archive during decompression.
+	buffer.reset(new char[storedSize]);
 	
-	if(size < file.size() || offset != 0) {
-		LogWarning << "Partially reading a compressed file - inefficent: size=" << size
-		           << " offset=" << offset << " total=" << file.size();
-	}
+	Autolock lock(archive.lock);
 	
-	file.archive.seekg(file.offset);
+	archive.seekg(offset);
 	
-	BlastFileInBuffer in(&file.archive, file.storedSize);
-	BlastMemOutBufferOffset out;
+	fs::read(archive, buffer.get(), storedSize);
 	
-	out.buf = reinterpret_cast<char *>(buf);
-	out.currentOffset = 0;
-	out.startOffset = offset;
-	out.endOffset = std::min(offset + size, file.size());
+	arx_assert(!archive.fail());
+	arx_assert(size_t(archive.gcount()) == storedSize);
+	
+	archive.clear();
 	
-	if(out.endOffset <= out.startOffset) {
+	return buffer.get();
+}
+
+size_t CompressedFileHandle::read(void * buf, size_t size) {
+	
+	if(offset >= file.size()) {
 		return 0;
 	}
 	
-	// TODO this is really inefficient
-	int r = ::blast(blastInFile, &in, blastOutMemOffset, &out);
-	if(r && (r != 1 || (size == file.size() && offset == 0))) {
-		LogError << "PakReader::fRead: blast error " << r << " outSize=" << file.size();
-		return 0;
+	if(!decoder) {
+		const char * stored = file.readStored(storedBuffer);
+		decoder.reset(new BlastDecoder(stored, file.getStoredSize()));
 	}
 	
-	size = out.currentOffset - out.startOffset;
+	size = std::min(size, file.size() - offset);
 	
-	offset += size;
+	size_t nread = decoder->read(offset, reinterpret_cast<char *>(buf), size);
+	if(nread != size) {
+		LogError << "PakReader::fRead: blast error " << decoder->error()
+		         << " outSize=" << file.size();
+	}
 	
-	file.archive.clear();
+	offset += nread;
 	
-	return size;
+	return nread;
 }
 
 int CompressedFileHandle::seek(Whence whence, int _offset) {
@@ -436,13 +528,35 @@ size_t PlainFileHandle::tell() {
 
 } // anonymous namespace
 
+/*!
+ * Files that are being or have been loaded by \ref ResourcePrefetcher.
+ *
+ * The data pointer is NULL while the file is still being loaded.
+ */
+struct PrefetchCache {
+	
+	typedef boost::unordered_map<PakFile *, char *> Files;
+	
+	Lock lock;
+	Files files;
+	
+	Semaphore loaded;
+	size_t waiting; //!< Number of threads waiting for loaded
+	
+	PrefetchCache() : waiting(0) { }
+	
+};
+
+PakReader::PakReader() : release(0), prefetchCache(new PrefetchCache) { }
+
 PakReader::~PakReader() {
 	clear();
+	delete prefetchCache;
 }
 
 bool PakReader::addArchive(const fs::path & pakfile) {
 	
-	fs::ifstream * ifs = new fs::ifstream(pakfile, fs::fstream::in | fs::fstream::binary);
+	PakArchiveStream * ifs = new PakArchiveStream(pakfile, fs::fstream::in | fs::fstream::binary);
 	
 	if(!ifs->is_open()) {
 		delete ifs;
@@ -491,7 +605,17 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 	
 	char * pos = fat;
 	
-	paks.push_back(ifs);
+	// Serve file contents directly from memory if the archive can be mapped.
+	fs::mapped_file * mapping = new fs::mapped_file(pakfile);
+	if(mapping->is_open()) {
+		mappedPaks.push_back(mapping);
+		delete ifs;
+		ifs = NULL;
+	} else {
+		delete mapping;
+		mapping = NULL;
+		paks.push_back(ifs);
+	}
 	
 	while(fat_size) {
 		
@@ -501,7 +625,8 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 			goto error;
 		}
 		
-		PakDirectory * dir = addDirectory(res::path::load(dirname));
+		res::path dirpath = res::path::load(dirname);
+		PakDirectory * dir = addDirectory(dirpath);
 		
 		u32 nfiles;
 		if(!util::safeGet(nfiles, pos, fat_size)) {
@@ -532,14 +657,27 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 			}
 			
 			const u32 PAK_FILE_COMPRESSED = 1;
+			bool compressed = (flags & PAK_FILE_COMPRESSED) && size != 0;
 			PakFile * file;
-			if((flags & PAK_FILE_COMPRESSED) && size != 0) {
+			if(mapping) {
+				if(offset > mapping->size() || size > mapping->size() - offset) {
+					LogError << pakfile << ": file data for \"" << filename
+					         << "\" is outside the archive";
+					goto error;
+				}
+				const char * contents = mapping->data() + offset;
+				if(compressed) {
+					file = new CompressedMappedFile(contents, uncompressedSize, size);
+				} else {
+					file = new UncompressedMappedFile(contents, size);
+				}
+			} else if(compressed) {
 				file = new CompressedFile(ifs, offset, uncompressedSize, size);
 			} else {
 				file = new UncompressedFile(ifs, offset, size);
 			}
 			
-			dir->addFile(std::string(filename, len), file);
+			addFile(dir, dirpath, std::string(filename, len), file);
 		}
 		
 	}
@@ -561,12 +699,34 @@ void PakReader::clear() {
 	
 	release = 0;
 	
+	{
+		Autolock lock(prefetchCache->lock);
+		BOOST_FOREACH(const PrefetchCache::Files::value_type & entry, prefetchCache->files) {
+			free(entry.second);
+		}
+		prefetchCache->files.clear();
+	}
+	
 	files.clear();
 	dirs.clear();
+	index.clear();
 	
 	BOOST_FOREACH(std::istream * is, paks) {
 		delete is;
 	}
+	paks.clear();
+	
+	BOOST_FOREACH(fs::mapped_file * mapping, mappedPaks) {
+		delete mapping;
+	}
+	mappedPaks.clear();
+}
+
+PakFile * PakReader::getFile(const res::path & path) {
+	
+	FileIndex::const_iterator entry = index.find(path.string());
+	
+	return (entry == index.end()) ? NULL : entry->second;
 }
 
 bool PakReader::read(const res::path & name, void * buf) {
@@ -590,9 +750,94 @@ char * PakReader::readAlloc(const res::path & name, size_t & sizeRead) {
 	
 	sizeRead = f->size();
 	
+	if(char * data = takePrefetched(f)) {
+		return data;
+	}
+	
 	return f->readAlloc();
 }
 
+bool PakReader::beginPrefetch(PakFile * file) {
+	
+	Autolock lock(prefetchCache->lock);
+	
+	return prefetchCache->files.insert(std::make_pair(file, (char *)NULL)).second;
+}
+
+void PakReader::endPrefetch(PakFile * file, char * data) {
+	
+	Autolock lock(prefetchCache->lock);
+	
+	PrefetchCache::Files::iterator it = prefetchCache->files.find(file);
+	if(it == prefetchCache->files.end() || it->second) {
+		// Discarded while loading
+		free(data);
+	} else if(data) {
+		it->second = data;
+	} else {
+		prefetchCache->files.erase(it);
+	}
+	
+	for(; prefetchCache->waiting; prefetchCache->waiting--) {
+		prefetchCache->loaded.post();
+	}
+}
+
+char * PakReader::takePrefetched(PakFile * file) {
+	
+	Autolock lock(prefetchCache->lock);
+	
+	while(true) {
+		
+		PrefetchCache::Files::iterator it = prefetchCache->files.find(file);
+		if(it == prefetchCache->files.end()) {
+			return NULL;
+		}
+		
+		if(it->second) {
+			char * data = it->second;
+			prefetchCache->files.erase(it);
+			return data;
+		}
+		
+		// Still loading - wait for the next endPrefetch() call
+		prefetchCache->waiting++;
+		prefetchCache->lock.unlock();
+		prefetchCache->loaded.wait();
+		prefetchCache->lock.lock();
+	}
+}
+
+void PakReader::discardPrefetched() {
+	
+	Autolock lock(prefetchCache->lock);
+	
+	// Files that are still being loaded are freed by endPrefetch() once it finds
+	// that their entry is gone
+	for(PrefetchCache::Files::iterator it = prefetchCache->files.begin();
+	    it != prefetchCache->files.end(); ++it) {
+		free(it->second);
+	}
+	prefetchCache->files.clear();
+	
+	// Let readAlloc() calls waiting for a discarded file read it themselves
+	for(; prefetchCache->waiting; prefetchCache->waiting--) {
+		prefetchCache->loaded.post();
+	}
+}
+
+const char * PakReader::readBorrowed(const res::path & name, size_t & size) {
+	
+	PakFile * f = getFile(name);
+	if(!f) {
+		return NULL;
+	}
+	
+	size = f->size();
+	
+	return f->data();
+}
+
 PakFileHandle * PakReader::open(const res::path & name) {
 	
 	PakFile * f = getFile(name);
@@ -607,7 +852,7 @@ bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 	
 	if(fs::is_directory(path)) {
 			
-		bool ret = addFiles(addDirectory(mount), path);
+		bool ret = addFiles(addDirectory(mount), path, mount);
 	
 		if(ret) {
 			LogInfo << "Added dir " << path;
@@ -619,7 +864,7 @@ bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 		
 		PakDirectory * dir = addDirectory(mount.parent());
 		
-		return addFile(dir, path, mount.filename());
+		return addFile(dir, path, mount.parent(), mount.filename());
 		
 	}
 	
@@ -630,7 +875,16 @@ void PakReader::removeFile(const res::path & file) {
 	
 	PakDirectory * dir = getDirectory(file.parent());
 	if(dir) {
+		if(PakFile * f = getFile(file)) {
+			Autolock lock(prefetchCache->lock);
+			PrefetchCache::Files::iterator it = prefetchCache->files.find(f);
+			if(it != prefetchCache->files.end()) {
+				free(it->second);
+				prefetchCache->files.erase(it);
+			}
+		}
 		dir->removeFile(file.filename());
+		index.erase(file.string());
 	}
 }
 
@@ -644,7 +898,15 @@ bool PakReader::removeDirectory(const res::path & name) {
 	}
 }
 
-bool PakReader::addFile(PakDirectory * dir, const fs::path & path,
+void PakReader::addFile(PakDirectory * dir, const res::path & mount,
+                        const std::string & name, PakFile * file) {
+	
+	// The new file always replaces any existing file with the same name.
+	dir->addFile(name, file);
+	index[(mount / name).string()] = file;
+}
+
+bool PakReader::addFile(PakDirectory * dir, const fs::path & path, const res::path & mount,
                         const std::string & name) {
 	
 	if(name.empty()) {
@@ -656,11 +918,12 @@ bool PakReader::addFile(PakDirectory * dir, const fs::path & path,
 		return false;
 	}
 	
-	dir->addFile(name, new PlainFile(path, size));
+	addFile(dir, mount, name, new PlainFile(path, size));
 	return true;
 }
 
-bool PakReader::addFiles(PakDirectory * dir, const fs::path & path) {
+bool PakReader::addFiles(PakDirectory * dir, const fs::path & path,
+                         const res::path & mount) {
 	
 	bool ret = true;
 	
@@ -678,9 +941,9 @@ bool PakReader::addFiles(PakDirectory * dir, const fs::path & path) {
 		boost::to_lower(name);
 		
 		if(it.is_directory()) {
-			ret &= addFiles(dir->addDirectory(name), entry);
+			ret &= addFiles(dir->addDirectory(name), entry, mount / name);
 		} else if(it.is_regular_file()) {
-			ret &= addFile(dir, entry, name);
+			ret &= addFile(dir, entry, mount, name);
 		}
 		
 	}
@@ -20,16 +20,19 @@
 #ifndef ARX_IO_RESOURCE_PAKREADER_H
 #define ARX_IO_RESOURCE_PAKREADER_H
 
+#include <string>
 #include <vector>
 #include <istream>
 
 #include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "io/resource/PakEntry.h"
 #include "io/resource/ResourcePath.h"
 #include "platform/Flags.h"
 
-namespace fs { class path; }
+namespace fs { class path; class mapped_file; }
+struct PrefetchCache;
 
 enum Whence {
 	SeekSet,
@@ -51,6 +54,14 @@ public:
 	
 };
 
+/*!
+ * Virtual resource hierarchy made up of .pak archives and plain files.
+ *
+ * Files can be read and opened concurrently from multiple threads: each
+ * \ref PakFileHandle keeps its own read position and access to archives that are
+ * not memory-mapped is serialized internally. Adding or removing files and
+ * archives must not happen while other threads are accessing the PakReader.
+ */
 class PakReader : public PakDirectory {
 	
 public:
@@ -62,7 +73,7 @@ public:
 	};
 	DECLARE_FLAGS(ReleaseType, ReleaseFlags)
 	
-	inline PakReader() : release(0) { }
+	PakReader();
 	~PakReader();
 	
 	void removeFile(const res::path & name);
@@ -90,20 +101,82 @@ public:
 	bool addArchive(const fs::path & pakfile);
 	void clear();
 	
+	/*!
+	 * Find a file by its full path.
+	 *
+	 * Unlike \ref PakDirectory::getFile() this does not walk the directory tree but
+	 * looks up the path in a flat index that is kept up to date as files and archives
+	 * are added or removed.
+	 */
+	PakFile * getFile(const res::path & path);
+	
+	inline bool hasFile(const res::path & path) {
+		return getFile(path) != NULL;
+	}
+	
 	bool read(const res::path & name, void * buf);
 	char * readAlloc(const res::path & name , size_t & size);
 	
+	/*!
+	 * Get the contents of a file without copying them.
+	 *
+	 * The returned data is owned by the PakReader and stays valid until the archive
+	 * containing the file is removed. It must not be modified or freed.
+	 *
+	 * \return NULL if the file does not exist or if its contents are not directly
+	 *         available (see \ref PakFile::data()) - use readAlloc() in that case.
+	 */
+	const char * readBorrowed(const res::path & name, size_t & size);
+	
 	PakFileHandle * open(const res::path & name);
 	
 	inline ReleaseFlags getReleaseType() { return release; }
 	
+	/*!
+	 * Announce that the contents of a file are being loaded in the background.
+	 *
+	 * Until \ref endPrefetch() is called for the file, readAlloc() calls for it wait
+	 * for the background load instead of reading the file again.
+	 * This is used by \ref ResourcePrefetcher and may be called from any thread.
+	 *
+	 * \return false if the file is already being prefetched or has been prefetched.
+	 */
+	bool beginPrefetch(PakFile * file);
+	
+	/*!
+	 * Provide the contents of a file announced with \ref beginPrefetch().
+	 *
+	 * \param data Contents of the file, allocated with malloc(). The next readAlloc()
+	 *             call for the file takes ownership. May be NULL if the file could not
+	 *             be loaded, in which case readAlloc() will read it itself.
+	 */
+	void endPrefetch(PakFile * file, char * data);
+	
+	/*!
+	 * Free the contents of all prefetched files that have not been used yet.
+	 * Files that are still being loaded are freed as soon as they are done.
+	 */
+	void discardPrefetched();
+	
 private:
 	
 	ReleaseFlags release;
 	std::vector<std::istream *> paks;
+	std::vector<fs::mapped_file *> mappedPaks;
+	
+	//! Full path of every file in the hierarchy - points to the active alternative.
+	typedef boost::unordered_map<std::string, PakFile *> FileIndex;
+	FileIndex index;
+	
+	PrefetchCache * prefetchCache;
+	
+	char * takePrefetched(PakFile * file);
 	
-	bool addFiles(PakDirectory * dir, const fs::path & path);
-	bool addFile(PakDirectory * dir, const fs::path & path, const std::string & name);
+	bool addFiles(PakDirectory * dir, const fs::path & path, const res::path & mount);
+	bool addFile(PakDirectory * dir, const fs::path & path, const res::path & mount,
+	             const std::string & name);
+	void addFile(PakDirectory * dir, const res::path & mount, const std::string & name,
+	             PakFile * file);
 	
 };
 
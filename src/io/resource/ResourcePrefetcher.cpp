@@ -0,0 +1,142 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/ResourcePrefetcher.h"
+
+#include "io/resource/PakEntry.h"
+#include "io/resource/PakReader.h"
+
+class ResourcePrefetcher::Job : public ThreadPool::Job {
+	
+	PakReader & reader;
+	PakFile * file;
+	res::path path;
+	Listener * listener;
+	
+public:
+	
+	Job(PakReader & _reader, PakFile * _file, const res::path & _path, Listener * _listener)
+		: reader(_reader), file(_file), path(_path), listener(_listener) { }
+	
+	void run() {
+		
+		// Files that are read in place from a mapping are not copied, only paged in
+		if(const char * mapped = file->data()) {
+			volatile char touched = 0;
+			for(size_t i = 0; i < file->size(); i += 4096) {
+				touched ^= mapped[i];
+			}
+			reader.endPrefetch(file, NULL);
+			if(listener) {
+				listener->prefetched(path, true);
+			}
+			return;
+		}
+		
+		// Empty files have nothing to load - readAlloc() handles them itself
+		char * data = (file->size() > 0) ? file->readAlloc() : NULL;
+		bool success = (data != NULL || file->size() == 0);
+		
+		reader.endPrefetch(file, data);
+		
+		if(listener) {
+			listener->prefetched(path, success);
+		}
+	}
+	
+	//! Release the file if the job has been cancelled before it was run.
+	void cancelled() {
+		reader.endPrefetch(file, NULL);
+	}
+	
+};
+
+ResourcePrefetcher::ResourcePrefetcher(PakReader * _reader, size_t threadCount)
+	: reader(*_reader), pool(threadCount, "prefetch") { }
+
+ResourcePrefetcher::~ResourcePrefetcher() {
+	cancel();
+}
+
+void ResourcePrefetcher::prefetch(const std::vector<res::path> & files,
+                                  Listener * listener) {
+	
+	removeCompletedJobs();
+	
+	for(std::vector<res::path>::const_iterator i = files.begin(); i != files.end(); ++i) {
+		
+		PakFile * file = reader.getFile(*i);
+		if(!file || !reader.beginPrefetch(file)) {
+			continue;
+		}
+		
+		Job * job = new Job(reader, file, *i, listener);
+		jobs.push_back(job);
+		pool.submit(job);
+	}
+}
+
+void ResourcePrefetcher::prefetch(const res::path & file, Listener * listener) {
+	prefetch(std::vector<res::path>(1, file), listener);
+}
+
+void ResourcePrefetcher::wait() {
+	
+	for(std::vector<Job *>::const_iterator i = jobs.begin(); i != jobs.end(); ++i) {
+		(*i)->wait();
+	}
+	
+	removeCompletedJobs();
+}
+
+void ResourcePrefetcher::cancel() {
+	
+	for(std::vector<Job *>::const_iterator i = jobs.begin(); i != jobs.end(); ++i) {
+		if(pool.cancel(*i)) {
+			(*i)->cancelled();
+			delete *i;
+		} else {
+			(*i)->wait();
+			delete *i;
+		}
+	}
+	
+	jobs.clear();
+}
+
+bool ResourcePrefetcher::isIdle() {
+	removeCompletedJobs();
+	return jobs.empty();
+}
+
+void ResourcePrefetcher::removeCompletedJobs() {
+	
+	std::vector<Job *>::iterator out = jobs.begin();
+	for(std::vector<Job *>::iterator i = jobs.begin(); i != jobs.end(); ++i) {
+		if((*i)->isDone()) {
+			delete *i;
+		} else {
+			*out++ = *i;
+		}
+	}
+	
+	jobs.erase(out, jobs.end());
+}
+
+ResourcePrefetcher * resourcePrefetcher = NULL;
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_RESOURCEPREFETCHER_H
+#define ARX_IO_RESOURCE_RESOURCEPREFETCHER_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "io/resource/ResourcePath.h"
+#include "platform/ThreadPool.h"
+
+class PakFile;
+class PakReader;
+
+/*!
+ * Loads and decompresses resources on worker threads ahead of time.
+ *
+ * Prefetched files are handed over to the \ref PakReader: the next
+ * \ref PakReader::readAlloc() call for a prefetched file returns the loaded contents,
+ * waiting for them if they are still being loaded. Files whose contents are
+ * directly available (see \ref PakFile::data()) are only paged in and not copied.
+ *
+ * The prefetcher itself must only be used from one thread. Files must not be
+ * added to or removed from the PakReader while files are being prefetched -
+ * call \ref cancel() first.
+ */
+class ResourcePrefetcher : private boost::noncopyable {
+	
+public:
+	
+	//! Notified about loaded files - called from the worker threads.
+	class Listener {
+		
+	public:
+		
+		virtual ~Listener() { }
+		
+		/*!
+		 * \param file    The resource that has been prefetched.
+		 * \param success false if the file could not be loaded.
+		 */
+		virtual void prefetched(const res::path & file, bool success) = 0;
+		
+	};
+	
+	/*!
+	 * \param reader      Resources to load files from.
+	 * \param threadCount Number of worker threads or 0 to use one per processor.
+	 */
+	explicit ResourcePrefetcher(PakReader * reader, size_t threadCount = 0);
+	
+	//! Cancels all queued files and waits for the remaining ones.
+	~ResourcePrefetcher();
+	
+	/*!
+	 * Start loading files in the background.
+	 *
+	 * Files that do not exist or that are already being prefetched are ignored.
+	 *
+	 * \param listener Optional listener to notify as files are loaded - must stay
+	 *                 valid until the files have been loaded or cancelled.
+	 */
+	void prefetch(const std::vector<res::path> & files, Listener * listener = NULL);
+	
+	void prefetch(const res::path & file, Listener * listener = NULL);
+	
+	//! Wait until all queued files have been loaded.
+	void wait();
+	
+	/*!
+	 * Remove all files that are not being loaded yet from the queue and wait for the
+	 * files that are already being loaded.
+	 */
+	void cancel();
+	
+	//! \return true if there are no queued files left.
+	bool isIdle();
+	
+private:
+	
+	class Job;
+	
+	PakReader & reader;
+	ThreadPool pool;
+	std::vector<Job *> jobs;
+	
+	void removeCompletedJobs();
+	
+};
+
+//! Prefetcher for the global \ref resources or NULL if not available.
+extern ResourcePrefetcher * resourcePrefetcher;
+
+#endif // ARX_IO_RESOURCE_RESOURCEPREFETCHER_H
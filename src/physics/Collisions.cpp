@@ -46,6 +46,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "physics/Collisions.h"
 
+#include "ai/PathFinderManager.h"
 #include "core/GameTime.h"
 #include "core/Core.h"
 #include "game/Damage.h"
@@ -1728,12 +1729,16 @@ void ANCHOR_BLOCK_Clear() {
 		ANCHOR_DATA * ad = &eb->anchors[k];
 		ad->flags &= ~ANCHOR_FLAG_BLOCKED;
 	}
+
+	EERIE_PATHFINDER_Invalidate();
 }
 
 void ANCHOR_BLOCK_By_IO(Entity * io, long status) {
 
 	EERIE_BACKGROUND * eb = ACTIVEBKG;
 
+	bool changed = false;
+
 	for(long k = 0; k < eb->nbanchors; k++) {
 		ANCHOR_DATA * ad = &eb->anchors[k];
 
@@ -1765,12 +1770,18 @@ void ANCHOR_BLOCK_By_IO(Entity * io, long status) {
 				}
 
 				if(PointIn2DPolyXZ(&ep, ad->pos.x, ad->pos.z)) {
+					AnchorFlags flags = ad->flags;
 					if(status)
 						ad->flags |= ANCHOR_FLAG_BLOCKED;
 					else
 						ad->flags &= ~ANCHOR_FLAG_BLOCKED;
+					changed = changed || ad->flags != flags;
 				}
 			}
 		}
-	}					
+	}
+
+	if(changed) {
+		EERIE_PATHFINDER_Invalidate();
+	}
 }
@@ -36,6 +36,10 @@
 #include <sys/utsname.h>
 #endif
 
+#if ARX_HAVE_SYSCONF
+#include <unistd.h>
+#endif
+
 // yes, we need stdio.h, POSIX doesn't know about cstdio
 #if ARX_HAVE_POPEN
 #include <stdio.h>
@@ -421,5 +425,27 @@ std::string getOSDistribution() {
 	return std::string();
 }
 
+unsigned getCPUCount() {
+	
+#if ARX_PLATFORM == ARX_PLATFORM_WIN32
+	
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	if(si.dwNumberOfProcessors > 0) {
+		return unsigned(si.dwNumberOfProcessors);
+	}
+	
+#elif ARX_HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+	
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if(count > 0) {
+		return unsigned(count);
+	}
+	
+#endif
+	
+	return 1;
+}
+
 
 } // namespace platform
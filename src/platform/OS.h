@@ -55,6 +55,13 @@ std::string getOSArchitecture();
  */
 std::string getOSDistribution();
 
+/*!
+ * \brief Get the number of processors available to the current process
+ *
+ * \return the number of online processors or 1 if it could not be determined.
+ */
+unsigned getCPUCount();
+
 } // namespace platform
 
 #endif // ARX_PLATFORM_OS_H
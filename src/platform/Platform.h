@@ -148,6 +148,19 @@ typedef double f64; // 64 bits double float
 	#define ARX_FORMAT_PRINTF(message_arg, param_vararg)
 #endif
 
+/*!
+ * \def ARX_THREAD_LOCAL
+ * \brief Declare a variable with thread storage duration
+ *
+ * Only usable for POD types with constant initializers.
+ * Not defined if the compiler does not support thread-local variables.
+ */
+#if ARX_COMPILER_MSVC
+	#define ARX_THREAD_LOCAL __declspec(thread)
+#elif ARX_HAVE_THREAD
+	#define ARX_THREAD_LOCAL __thread
+#endif
+
 /* ---------------------------------------------------------
                 Helper macros
 ------------------------------------------------------------*/
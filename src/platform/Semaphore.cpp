@@ -0,0 +1,98 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "platform/Semaphore.h"
+
+#if ARX_HAVE_PTHREADS
+
+Semaphore::Semaphore(size_t initial) : count(initial) {
+	const pthread_mutex_t mutex_init = PTHREAD_MUTEX_INITIALIZER;
+	mutex = mutex_init;
+	const pthread_cond_t cond_init = PTHREAD_COND_INITIALIZER;
+	cond = cond_init;
+}
+
+Semaphore::~Semaphore() {
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void Semaphore::wait() {
+	
+	pthread_mutex_lock(&mutex);
+	
+	while(count == 0) {
+		int rc = pthread_cond_wait(&cond, &mutex);
+		arx_assert(rc == 0);
+		ARX_UNUSED(rc);
+	}
+	
+	count--;
+	pthread_mutex_unlock(&mutex);
+}
+
+bool Semaphore::tryWait() {
+	
+	pthread_mutex_lock(&mutex);
+	
+	bool available = (count != 0);
+	if(available) {
+		count--;
+	}
+	
+	pthread_mutex_unlock(&mutex);
+	
+	return available;
+}
+
+void Semaphore::post() {
+	pthread_mutex_lock(&mutex);
+	count++;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+Semaphore::Semaphore(size_t initial) {
+	semaphore = CreateSemaphore(NULL, LONG(initial), LONG_MAX, NULL);
+	arx_assert(semaphore);
+}
+
+Semaphore::~Semaphore() {
+	CloseHandle(semaphore);
+}
+
+void Semaphore::wait() {
+	DWORD rc = WaitForSingleObject(semaphore, INFINITE);
+	arx_assert(rc == WAIT_OBJECT_0);
+	ARX_UNUSED(rc);
+}
+
+bool Semaphore::tryWait() {
+	return WaitForSingleObject(semaphore, 0) == WAIT_OBJECT_0;
+}
+
+void Semaphore::post() {
+	BOOL ret = ReleaseSemaphore(semaphore, 1, NULL);
+	arx_assert(ret);
+	ARX_UNUSED(ret);
+}
+
+#endif
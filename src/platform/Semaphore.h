@@ -0,0 +1,70 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_SEMAPHORE_H
+#define ARX_PLATFORM_SEMAPHORE_H
+
+#include <boost/noncopyable.hpp>
+
+#include "Configure.h"
+#include "platform/Platform.h"
+
+#if ARX_HAVE_PTHREADS
+#include <pthread.h>
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#else
+#error "Semaphores not supported: need ARX_HAVE_PTHREADS on non-Windows systems"
+#endif
+
+/*!
+ * Counting semaphore used to let threads sleep until work is available.
+ */
+class Semaphore : private boost::noncopyable {
+	
+private:
+	
+#if ARX_HAVE_PTHREADS
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	size_t count;
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+	HANDLE semaphore;
+#endif
+	
+public:
+	
+	explicit Semaphore(size_t initial = 0);
+	~Semaphore();
+	
+	//! Block until the count is positive, then decrement it.
+	void wait();
+	
+	/*!
+	 * Decrement the count if it is positive.
+	 * \return false if the count was zero.
+	 */
+	bool tryWait();
+	
+	//! Increment the count, waking up one waiting thread.
+	void post();
+	
+};
+
+#endif // ARX_PLATFORM_SEMAPHORE_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "platform/ThreadPool.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "platform/OS.h"
+#include "platform/Thread.h"
+
+class ThreadPoolWorker : public Thread {
+	
+	ThreadPool & pool;
+	
+public:
+	
+	explicit ThreadPoolWorker(ThreadPool & _pool) : pool(_pool) { }
+	
+	void run() {
+		while(ThreadPool::Job * job = pool.next()) {
+			job->run();
+			job->completed.post();
+		}
+	}
+	
+};
+
+ThreadPool::ThreadPool(size_t threadCount, const std::string & name) : stopping(false) {
+	
+	if(threadCount == 0) {
+		threadCount = platform::getCPUCount();
+	}
+	
+	workers.resize(threadCount);
+	for(size_t i = 0; i < threadCount; i++) {
+		workers[i] = new ThreadPoolWorker(*this);
+		std::ostringstream oss;
+		oss << name << ' ' << i;
+		workers[i]->setThreadName(oss.str());
+		workers[i]->start();
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	
+	{
+		Autolock lock(this->lock);
+		stopping = true;
+	}
+	
+	// Wake up every worker so that it notices that the pool is stopping.
+	for(size_t i = 0; i < workers.size(); i++) {
+		available.post();
+	}
+	
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i]->waitForCompletion();
+		delete workers[i];
+	}
+}
+
+void ThreadPool::submit(Job * job) {
+	
+	{
+		Autolock lock(this->lock);
+		queue.push_back(job);
+	}
+	
+	available.post();
+}
+
+bool ThreadPool::cancel(Job * job) {
+	
+	Autolock lock(this->lock);
+	
+	std::deque<Job *>::iterator it = std::find(queue.begin(), queue.end(), job);
+	if(it == queue.end()) {
+		return false;
+	}
+	
+	// The count in available is left as is - next() copes with an empty queue.
+	queue.erase(it);
+	
+	return true;
+}
+
+ThreadPool::Job * ThreadPool::next() {
+	
+	while(true) {
+		
+		available.wait();
+		
+		Autolock lock(this->lock);
+		
+		if(!queue.empty()) {
+			Job * job = queue.front();
+			queue.pop_front();
+			return job;
+		}
+		
+		if(stopping) {
+			return NULL;
+		}
+		
+		// The job for this wakeup has been cancelled.
+	}
+}
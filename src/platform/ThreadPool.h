@@ -0,0 +1,114 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_THREADPOOL_H
+#define ARX_PLATFORM_THREADPOOL_H
+
+#include <stddef.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "platform/Lock.h"
+#include "platform/Semaphore.h"
+
+class ThreadPoolWorker;
+
+/*!
+ * Fixed set of worker threads that run queued jobs in submission order.
+ */
+class ThreadPool : private boost::noncopyable {
+	
+public:
+	
+	/*!
+	 * Unit of work for a \ref ThreadPool.
+	 *
+	 * Jobs are owned by the code that submits them and must stay alive until they
+	 * have completed.
+	 */
+	class Job : private boost::noncopyable {
+		
+		Semaphore completed;
+		
+		friend class ThreadPoolWorker;
+		
+	public:
+		
+		virtual ~Job() { }
+		
+		//! Called on one of the worker threads.
+		virtual void run() = 0;
+		
+		//! Block until the job has been run - may be called multiple times.
+		void wait() {
+			completed.wait();
+			completed.post();
+		}
+		
+		//! \return true if the job has been run.
+		bool isDone() {
+			bool done = completed.tryWait();
+			if(done) {
+				completed.post();
+			}
+			return done;
+		}
+		
+	};
+	
+	/*!
+	 * \param threadCount Number of worker threads or 0 to use one per processor.
+	 * \param name        Name for the worker threads (for easier debugging).
+	 */
+	explicit ThreadPool(size_t threadCount = 0, const std::string & name = "worker");
+	
+	//! Run all jobs that are still queued and then stop the worker threads.
+	~ThreadPool();
+	
+	//! Queue a job to be run on one of the worker threads.
+	void submit(Job * job);
+	
+	/*!
+	 * Remove a job from the queue if it has not been started yet.
+	 * \return true if the job was removed - it will not be run.
+	 */
+	bool cancel(Job * job);
+	
+	size_t getThreadCount() const { return workers.size(); }
+	
+private:
+	
+	std::vector<ThreadPoolWorker *> workers;
+	
+	Lock lock;
+	Semaphore available;
+	std::deque<Job *> queue;
+	bool stopping;
+	
+	//! \return the next job to run or NULL if the pool is shutting down.
+	Job * next();
+	
+	friend class ThreadPoolWorker;
+	
+};
+
+#endif // ARX_PLATFORM_THREADPOOL_H
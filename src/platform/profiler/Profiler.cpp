@@ -21,165 +21,788 @@
 
 #if BUILD_PROFILER_INSTRUMENT
 
+#include <algorithm>
 #include <map>
 #include <iomanip>
+#include <sstream>
 #include <string.h>
 #include <vector>
 
 #include <boost/atomic.hpp>
 
+#include "Configure.h"
+
+#if ARX_HAVE_CLOCK_GETTIME
+#include <time.h>
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#endif
+
 #include "io/fs/FilePath.h"
 #include "io/fs/FileStream.h"
+#include "io/fs/Filesystem.h"
 #include "io/log/Logger.h"
+#include "platform/Lock.h"
+#include "platform/ProgramOptions.h"
 #include "util/String.h"
 
 #include "platform/profiler/ProfilerDataFormat.h"
+#include "platform/profiler/ProfilerTrace.h"
+
+//! Write Chrome trace JSON files instead of the binary .perf format
+static bool g_writeTrace = false;
+
+#if ARX_HAVE_CLOCK_GETTIME
+
+// Ticks are nanoseconds - prefer the raw clock as it is not slewed by NTP
+static clockid_t getProfilerClock() {
+#ifdef CLOCK_MONOTONIC_RAW
+	struct timespec ts;
+	if(!clock_gettime(CLOCK_MONOTONIC_RAW, &ts)) {
+		return CLOCK_MONOTONIC_RAW;
+	}
+#endif
+#ifdef CLOCK_MONOTONIC
+	return CLOCK_MONOTONIC;
+#else
+	return CLOCK_REALTIME;
+#endif
+}
+
+static const clockid_t g_clockId = getProfilerClock();
+
+u64 profiler::getTicks() {
+	struct timespec ts;
+	clock_gettime(g_clockId, &ts);
+	return u64(ts.tv_sec) * 1000000000ull + u64(ts.tv_nsec);
+}
+
+static u64 ticksToUs(u64 ticks) {
+	return ticks / 1000;
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+// Ticks are raw performance counter values
+static u64 getClockFrequency() {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart;
+}
+
+static const u64 g_clockFrequency = getClockFrequency();
+
+u64 profiler::getTicks() {
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+static u64 ticksToUs(u64 ticks) {
+	// Split the conversion to avoid overflows
+	u64 seconds = ticks / g_clockFrequency;
+	u64 remainder = ticks % g_clockFrequency;
+	return seconds * 1000000 + remainder * 1000000 / g_clockFrequency;
+}
+
+#else
+
+u64 profiler::getTicks() {
+	return platform::getTimeUs();
+}
+
+static u64 ticksToUs(u64 ticks) {
+	return ticks;
+}
+
+#endif
+
+//! Record one in this many profile scopes
+static boost::atomic<u32> g_sampleRate(1);
+
+#ifdef ARX_THREAD_LOCAL
+ARX_THREAD_LOCAL u32 profiler::detail::sampleCountdown = 0;
+#else
+static boost::atomic<u32> g_sampleCounter(0);
+#endif
+
+bool profiler::detail::sampleNext() {
+	
+	u32 rate = g_sampleRate.load(boost::memory_order_relaxed);
+	
+#ifdef ARX_THREAD_LOCAL
+	sampleCountdown = rate;
+	return true;
+#else
+	// Shared between all threads - slower, but still samples one in every n scopes
+	return rate <= 1 || g_sampleCounter.fetch_add(1, boost::memory_order_relaxed) % rate == 0;
+#endif
+}
+
+class ProfilerWriter;
 
 class Profiler {
 	
 public:
 	Profiler();
+	~Profiler();
 	
+	void start();
+	void stop();
 	void flush();
-	void reset();
 	
 	void registerThread(const std::string& threadName);
 	void unregisterThread();
 	
-	void addProfilePoint(const char* tag, thread_id_type threadId, u64 startTime, u64 endTime);
+	u16 internTag(const char* tag);
+	
+	void addProfilePoint(u16 tag, thread_id_type threadId, u64 startTicks, u64 endTicks);
+	void addFrameMarker();
+	void addCounter(u16 name, s64 value);
+	void addMemoryEvent(u16 tag, s64 size);
 	
 private:
-	static const u32 NB_POINTS = 40 * 1024;
+	static const size_t MAX_THREADS = 64;
+	static const size_t MAX_TAGS = 4096;
+	static const u32 NB_POINTS = 16 * 1024; // per thread, must be a power of two
+	
+	enum PointType {
+		Point_Scope,
+		Point_Frame,
+		Point_Counter,
+		Point_Memory
+	};
 	
 	struct ProfilePoint {
-		const char*    tag;
+		PointType      type;
+		u16            tag;
 		thread_id_type threadId;
-		u64            startTime;
+		u64            startTime; // in ticks
 		u64            endTime;
+		s64            value; // frame number, counter value or allocation size
 	};
-
+	
+	//! Collected points converted to the on-disk format, sorted by type
+	struct Records {
+		std::vector<SavedProfilePoint>        points;
+		std::vector<SavedProfilerFrame>       frames;
+		std::vector<SavedProfilerCounter>     counters;
+		std::vector<SavedProfilerMemoryEvent> memory;
+		
+		void clear() {
+			points.clear();
+			frames.clear();
+			counters.clear();
+			memory.clear();
+		}
+	};
+	
+	/*!
+	 * Single-producer single-consumer ring of profile points.
+	 * Only the owning thread writes points and only the writer thread reads them.
+	 * Once the owning thread has unregistered and the buffer has been drained,
+	 * it can be handed to a new thread.
+	 */
+	struct ThreadBuffer {
+		boost::atomic<bool>           active; // owned by a running thread
+		boost::atomic<thread_id_type> threadId;
+		boost::atomic<u32> head; // next point to write
+		boost::atomic<u32> tail; // next point to read
+		boost::atomic<u32> dropped;
+		ProfilePoint       points[NB_POINTS];
+	};
+	
 	struct ThreadInfo {
 		std::string    threadName;
 		thread_id_type threadId;
-		u64            startTime;
+		u64            startTime; // in ticks
 		u64            endTime;
 	};
 
 	typedef std::map<thread_id_type, ThreadInfo> ThreadInfos;
 	
-	ThreadInfos        m_threads;
-	ProfilePoint       m_points[NB_POINTS];
-	boost::atomic<int> m_writeIndex;
-	bool               m_canWrite;
+	Lock                  m_lock;
+	ThreadInfos           m_threads;
+	bool                  m_threadsChanged;
+	
+	ThreadBuffer*         m_buffers[MAX_THREADS];
+	boost::atomic<size_t> m_bufferCount;
+	boost::atomic<u32>    m_unbuffered; //!< Points dropped because all buffers were in use
+	
+	//! Interned tag names - only appended to, with m_lock held
+	const char*           m_tags[MAX_TAGS];
+	size_t                m_tagCount;
+	
+	boost::atomic<u32>    m_frame;
+	
+	ProfilerWriter*       m_writer;
+	
+#ifdef ARX_THREAD_LOCAL
+	//! Buffer last used by the current thread, checked before searching m_buffers
+	static ARX_THREAD_LOCAL ThreadBuffer* s_threadBuffer;
+#endif
+	
+	ThreadBuffer* findBuffer(thread_id_type threadId);
+	ThreadBuffer* addBuffer(thread_id_type threadId);
+	ThreadBuffer* getBuffer(thread_id_type threadId);
+	
+	void addPoint(const ProfilePoint& point);
+	
+	friend class ProfilerWriter;
+	
+	//! Move all buffered points to the output records, called from the writer thread.
+	void collectPoints(Records& records, u32& dropped);
+	
+	//! Get the thread infos if they changed since the last call or if force is true.
+	bool collectThreads(std::vector<SavedThreadInfo>& threads, bool force);
+};
+
+#ifdef ARX_THREAD_LOCAL
+ARX_THREAD_LOCAL Profiler::ThreadBuffer* Profiler::s_threadBuffer = NULL;
+#endif
+
+/*!
+ * Background thread that streams the collected profile points to disk.
+ */
+class ProfilerWriter : public StoppableThread {
+	
+public:
+	
+	ProfilerWriter(Profiler& profiler, bool trace)
+		: m_profiler(profiler)
+		, m_writeTrace(trace)
+		, m_trace(NULL)
+	{
+		m_rotate = false;
+		setThreadName("Profiler Writer");
+	}
+	
+	//! Finish the current file and continue in a new one.
+	void rotate() {
+		m_rotate = true;
+	}
+	
+private:
+	
+	Profiler&                m_profiler;
+	const bool               m_writeTrace;
+	ProfilerTraceWriter*     m_trace;
+	boost::atomic<bool>      m_rotate;
+	fs::ofstream             m_out;
+	fs::path                 m_filename;
+	u32                      m_dropped;
+	
+	Profiler::Records              m_records;
+	std::vector<SavedThreadInfo>   m_threads;
 	
-	void writeProfileLog();
+	void run();
+	
+	void openLog();
+	void closeLog();
+	void writePoints();
+	void writeThreads(bool force);
+	void writeChunk(u32 type, const void* data, size_t itemSize, size_t count);
+	void writeTrace();
 };
 
+void ProfilerWriter::run() {
+	
+	openLog();
+	
+	while(!isStopRequested()) {
+		
+		Thread::sleep(10);
+		
+		writeThreads(false);
+		writePoints();
+		
+		if(m_rotate.exchange(false)) {
+			closeLog();
+			openLog();
+		}
+	}
+	
+	closeLog();
+}
 
-Profiler::Profiler() {
-	m_writeIndex = 0;
-	m_canWrite = true;
-	memset(m_points, 0, sizeof(m_points));
+void ProfilerWriter::openLog() {
+	
+	// Don't overwrite the previous log if it was started in the same second
+	std::string basename = util::getDateTimeString();
+	const char* extension = m_writeTrace ? ".json" : ".perf";
+	m_filename = basename + extension;
+	for(int i = 1; fs::exists(m_filename); i++) {
+		std::ostringstream oss;
+		oss << basename << '-' << i << extension;
+		m_filename = oss.str();
+	}
+	
+	m_out.open(m_filename, std::ios::binary | std::ios::out | std::ios::trunc);
+	if(!m_out.is_open()) {
+		LogError << "Could not open profiler log " << m_filename;
+	}
+	
+	if(m_writeTrace) {
+		m_trace = new ProfilerTraceWriter(m_out);
+	} else {
+		SavedProfilerHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, profilerMagic, sizeof(header.magic));
+		header.version = profilerVersion;
+		m_out.write((const char*)&header, sizeof(SavedProfilerHeader));
+	}
+	
+	m_dropped = 0;
+	
+	writeThreads(true);
 }
 
-void Profiler::reset() {
-	m_writeIndex = 0;
-	memset(m_points, 0, sizeof(m_points));
+void ProfilerWriter::closeLog() {
+	
+	writePoints();
+	writeThreads(true);
+	
+	if(m_trace) {
+		m_trace->finish();
+		delete m_trace, m_trace = NULL;
+	}
+	
+	m_out.close();
+	
+	if(m_dropped) {
+		LogWarning << "Profiler buffers overflowed, dropped " << m_dropped << " points";
+	}
+	
+	LogInfo << "Wrote profiler log " << m_filename;
+}
+
+void ProfilerWriter::writePoints() {
+	
+	u32 dropped = 0;
+	m_records.clear();
+	m_profiler.collectPoints(m_records, dropped);
+	m_dropped += dropped;
+	
+	if(m_trace) {
+		writeTrace();
+		return;
+	}
+	
+	if(!m_records.points.empty()) {
+		writeChunk(ProfilerChunk_Points, &m_records.points[0], sizeof(SavedProfilePoint),
+		           m_records.points.size());
+	}
+	if(!m_records.frames.empty()) {
+		writeChunk(ProfilerChunk_Frames, &m_records.frames[0], sizeof(SavedProfilerFrame),
+		           m_records.frames.size());
+	}
+	if(!m_records.counters.empty()) {
+		writeChunk(ProfilerChunk_Counters, &m_records.counters[0], sizeof(SavedProfilerCounter),
+		           m_records.counters.size());
+	}
+	if(!m_records.memory.empty()) {
+		writeChunk(ProfilerChunk_Memory, &m_records.memory[0], sizeof(SavedProfilerMemoryEvent),
+		           m_records.memory.size());
+	}
+}
+
+void ProfilerWriter::writeThreads(bool force) {
+	
+	m_threads.clear();
+	if(!m_profiler.collectThreads(m_threads, force) || m_threads.empty()) {
+		return;
+	}
+	
+	if(m_trace) {
+		for(size_t i = 0; i < m_threads.size(); i++) {
+			m_trace->addThread(m_threads[i]);
+		}
+		m_out.flush();
+	} else {
+		writeChunk(ProfilerChunk_Threads, &m_threads[0], sizeof(SavedThreadInfo), m_threads.size());
+	}
+}
+
+void ProfilerWriter::writeChunk(u32 type, const void* data, size_t itemSize, size_t count) {
+	
+	SavedProfilerChunkHeader chunk;
+	chunk.type = type;
+	chunk.size = count;
+	m_out.write((const char*)&chunk, sizeof(SavedProfilerChunkHeader));
+	m_out.write((const char*)data, itemSize * count);
+	
+	// Keep the file readable even if the game crashes
+	m_out.flush();
+}
+
+void ProfilerWriter::writeTrace() {
+	
+	for(size_t i = 0; i < m_records.points.size(); i++) {
+		m_trace->addPoint(m_records.points[i]);
+	}
+	for(size_t i = 0; i < m_records.frames.size(); i++) {
+		m_trace->addFrame(m_records.frames[i]);
+	}
+	for(size_t i = 0; i < m_records.counters.size(); i++) {
+		m_trace->addCounter(m_records.counters[i]);
+	}
+	for(size_t i = 0; i < m_records.memory.size(); i++) {
+		m_trace->addMemoryEvent(m_records.memory[i]);
+	}
+	
+	m_out.flush();
+}
+
+
+Profiler::Profiler()
+	: m_threadsChanged(false)
+	, m_tagCount(1)
+	, m_writer(NULL)
+{
+	m_bufferCount = 0;
+	m_unbuffered = 0;
+	m_frame = 0;
+	memset(m_buffers, 0, sizeof(m_buffers));
+	memset(m_tags, 0, sizeof(m_tags));
+	m_tags[0] = "(other)"; // used once the tag table is full
+}
+
+Profiler::~Profiler() {
+	stop();
+	for(size_t i = 0; i < m_bufferCount; i++) {
+		delete m_buffers[i];
+	}
+}
+
+void Profiler::start() {
+	if(!m_writer) {
+		m_writer = new ProfilerWriter(*this, g_writeTrace);
+		m_writer->start();
+	}
+}
+
+void Profiler::stop() {
+	if(m_writer) {
+		m_writer->stop();
+		delete m_writer, m_writer = NULL;
+	}
+}
+
+void Profiler::flush() {
+	if(m_writer) {
+		m_writer->rotate();
+	}
+}
+
+Profiler::ThreadBuffer* Profiler::findBuffer(thread_id_type threadId) {
+	
+	size_t count = m_bufferCount.load(boost::memory_order_acquire);
+	for(size_t i = 0; i < count; i++) {
+		// Check active first so that we see the thread ID of a recycled buffer
+		if(m_buffers[i]->active.load(boost::memory_order_acquire)
+		   && m_buffers[i]->threadId.load(boost::memory_order_relaxed) == threadId) {
+			return m_buffers[i];
+		}
+	}
+	
+	return NULL;
+}
+
+Profiler::ThreadBuffer* Profiler::addBuffer(thread_id_type threadId) {
+	
+	Autolock lock(m_lock);
+	
+	// Only threads add their own buffer so no other thread can have added one for us.
+	// Reuse the buffer of a thread that has exited once all its points have been written.
+	size_t count = m_bufferCount.load(boost::memory_order_relaxed);
+	for(size_t i = 0; i < count; i++) {
+		ThreadBuffer* buffer = m_buffers[i];
+		if(!buffer->active.load(boost::memory_order_relaxed)
+		   && buffer->tail.load(boost::memory_order_acquire)
+		      == buffer->head.load(boost::memory_order_relaxed)) {
+			buffer->threadId.store(threadId, boost::memory_order_relaxed);
+			buffer->active.store(true, boost::memory_order_release);
+			return buffer;
+		}
+	}
+	
+	if(count == MAX_THREADS) {
+		return NULL;
+	}
+	
+	ThreadBuffer* buffer = new ThreadBuffer;
+	buffer->threadId.store(threadId, boost::memory_order_relaxed);
+	buffer->active.store(true, boost::memory_order_relaxed);
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->dropped = 0;
+	
+	m_buffers[count] = buffer;
+	m_bufferCount.store(count + 1, boost::memory_order_release);
+	
+	return buffer;
+}
+
+Profiler::ThreadBuffer* Profiler::getBuffer(thread_id_type threadId) {
+	
+#ifdef ARX_THREAD_LOCAL
+	ThreadBuffer* cached = s_threadBuffer;
+	if(cached && cached->active.load(boost::memory_order_acquire)
+	   && cached->threadId.load(boost::memory_order_relaxed) == threadId) {
+		return cached;
+	}
+#endif
+	
+	ThreadBuffer* buffer = findBuffer(threadId);
+	if(!buffer) {
+		buffer = addBuffer(threadId);
+	}
+	
+#ifdef ARX_THREAD_LOCAL
+	if(buffer && threadId == Thread::getCurrentThreadId()) {
+		s_threadBuffer = buffer;
+	}
+#endif
+	
+	return buffer;
 }
 
 void Profiler::registerThread(const std::string& threadName) {
+	
 	thread_id_type threadId = Thread::getCurrentThreadId();
+	
+	getBuffer(threadId);
+	
+	Autolock lock(m_lock);
 	ThreadInfo& threadInfo = m_threads[threadId];
 	threadInfo.threadName = threadName;
 	threadInfo.threadId = threadId;
-	threadInfo.startTime = platform::getTimeUs();
+	threadInfo.startTime = profiler::getTicks();
 	threadInfo.endTime = threadInfo.startTime;
+	m_threadsChanged = true;
 }
 	
 void Profiler::unregisterThread() {
+	
 	thread_id_type threadId = Thread::getCurrentThreadId();
+	
+	Autolock lock(m_lock);
 	ThreadInfo& threadInfo = m_threads[threadId];
-	threadInfo.endTime = platform::getTimeUs();
+	threadInfo.endTime = profiler::getTicks();
+	m_threadsChanged = true;
+	
+	// This thread will not add any more points - let the buffer be reused once it is drained
+	ThreadBuffer* buffer = findBuffer(threadId);
+	if(buffer) {
+		buffer->active.store(false, boost::memory_order_release);
+	}
+	
+#ifdef ARX_THREAD_LOCAL
+	s_threadBuffer = NULL;
+#endif
 }
 
-void Profiler::addProfilePoint(const char* tag, thread_id_type threadId, u64 startTime, u64 endTime) {
+void Profiler::addPoint(const ProfilePoint& point) {
+	
+	ThreadBuffer* buffer = getBuffer(point.threadId);
+	if(!buffer) {
+		m_unbuffered.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
 	
-	while(!m_canWrite);
+	u32 head = buffer->head.load(boost::memory_order_relaxed);
+	if(head - buffer->tail.load(boost::memory_order_acquire) >= NB_POINTS) {
+		buffer->dropped.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
 	
-	u32 pos = m_writeIndex.fetch_add(1);
+	buffer->points[head % NB_POINTS] = point;
 	
-	ProfilePoint& point = m_points[pos % NB_POINTS];
+	buffer->head.store(head + 1, boost::memory_order_release);
+}
+
+u16 Profiler::internTag(const char* tag) {
+	
+	arx_assert(tag != NULL && tag[0] != '\0');
+	
+	Autolock lock(m_lock);
+	
+	for(size_t i = 0; i < m_tagCount; i++) {
+		if(m_tags[i] == tag || !strcmp(m_tags[i], tag)) {
+			return u16(i);
+		}
+	}
+	
+	if(m_tagCount == MAX_TAGS) {
+		return 0;
+	}
+	
+	m_tags[m_tagCount] = tag;
+	return u16(m_tagCount++);
+}
+
+void Profiler::addProfilePoint(u16 tag, thread_id_type threadId, u64 startTicks, u64 endTicks) {
+	
+	ProfilePoint point;
+	point.type = Point_Scope;
 	point.tag = tag;
 	point.threadId = threadId;
-	point.startTime = startTime;
-	point.endTime = endTime;
+	point.startTime = startTicks;
+	point.endTime = endTicks;
+	point.value = 0;
+	
+	addPoint(point);
 }
 
-void Profiler::flush() {
+void Profiler::addFrameMarker() {
+	
+	ProfilePoint point;
+	point.type = Point_Frame;
+	point.tag = 0;
+	point.threadId = Thread::getCurrentThreadId();
+	point.startTime = profiler::getTicks();
+	point.endTime = point.startTime;
+	point.value = m_frame.fetch_add(1, boost::memory_order_relaxed);
 	
-	m_canWrite = false;
-	writeProfileLog();
-	reset();
-	m_canWrite = true;
+	addPoint(point);
 }
 
-void Profiler::writeProfileLog() {
+void Profiler::addCounter(u16 name, s64 value) {
 	
-	std::string filename = util::getDateTimeString() + ".perf";
-	fs::ofstream out(fs::path(filename), std::ios::binary | std::ios::out);
+	ProfilePoint point;
+	point.type = Point_Counter;
+	point.tag = name;
+	point.threadId = Thread::getCurrentThreadId();
+	point.startTime = profiler::getTicks();
+	point.endTime = point.startTime;
+	point.value = value;
 	
-	// Threads info
-	SavedThreadInfoHeader threadsHeader;
-	threadsHeader.size = m_threads.size();
-	out.write((const char*)&threadsHeader, sizeof(SavedThreadInfoHeader));
+	addPoint(point);
+}
+
+void Profiler::addMemoryEvent(u16 tag, s64 size) {
 	
-	for(ThreadInfos::const_iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
-		const ThreadInfo& threadInfo = it->second;
+	ProfilePoint point;
+	point.type = Point_Memory;
+	point.tag = tag;
+	point.threadId = Thread::getCurrentThreadId();
+	point.startTime = profiler::getTicks();
+	point.endTime = point.startTime;
+	point.value = size;
+	
+	addPoint(point);
+}
+
+void Profiler::collectPoints(Records& records, u32& dropped) {
+	
+	size_t count = m_bufferCount.load(boost::memory_order_acquire);
+	for(size_t i = 0; i < count; i++) {
+		ThreadBuffer& buffer = *m_buffers[i];
 		
-		SavedThreadInfo saved;
-		util::storeString(saved.threadName, threadInfo.threadName);
-		saved.threadId = threadInfo.threadId;
-		saved.startTime = threadInfo.startTime;
-		saved.endTime = threadInfo.endTime;
-		out.write((const char*)&saved, sizeof(SavedThreadInfo));
+		u32 tail = buffer.tail.load(boost::memory_order_relaxed);
+		u32 head = buffer.head.load(boost::memory_order_acquire);
+		
+		for(; tail != head; ++tail) {
+			const ProfilePoint& point = buffer.points[tail % NB_POINTS];
+			
+			switch(point.type) {
+				
+				case Point_Scope: {
+					SavedProfilePoint saved;
+					util::storeString(saved.tag, m_tags[point.tag]);
+					saved.threadId = point.threadId;
+					saved.startTime = ticksToUs(point.startTime);
+					saved.endTime = ticksToUs(point.endTime);
+					records.points.push_back(saved);
+					break;
+				}
+				
+				case Point_Frame: {
+					SavedProfilerFrame saved;
+					saved.threadId = point.threadId;
+					saved.time = ticksToUs(point.startTime);
+					saved.frame = u64(point.value);
+					records.frames.push_back(saved);
+					break;
+				}
+				
+				case Point_Counter: {
+					SavedProfilerCounter saved;
+					util::storeString(saved.name, m_tags[point.tag]);
+					saved.threadId = point.threadId;
+					saved.time = ticksToUs(point.startTime);
+					saved.value = point.value;
+					records.counters.push_back(saved);
+					break;
+				}
+				
+				case Point_Memory: {
+					SavedProfilerMemoryEvent saved;
+					util::storeString(saved.tag, m_tags[point.tag]);
+					saved.threadId = point.threadId;
+					saved.time = ticksToUs(point.startTime);
+					saved.size = point.value;
+					records.memory.push_back(saved);
+					break;
+				}
+				
+			}
+		}
+		
+		buffer.tail.store(tail, boost::memory_order_release);
+		
+		dropped += buffer.dropped.exchange(0, boost::memory_order_relaxed);
 	}
 	
-	// Profile points
-	u32 index = 0;
-	u32 numItems = m_writeIndex;
+	dropped += m_unbuffered.exchange(0, boost::memory_order_relaxed);
+}
+
+bool Profiler::collectThreads(std::vector<SavedThreadInfo>& threads, bool force) {
 	
-	if(numItems >= NB_POINTS) {
-		index = numItems;
-		numItems = NB_POINTS;
-	}
+	Autolock lock(m_lock);
 	
-	// Threads info
-	SavedProfilePointHeader pointsHeader;
-	pointsHeader.size = numItems;
-	out.write((const char*)&pointsHeader, sizeof(SavedProfilePointHeader));
+	if(!m_threadsChanged && !force) {
+		return false;
+	}
+	m_threadsChanged = false;
 	
-	for(u32 i = 0; i < numItems; ++i, ++index) {
-		ProfilePoint& point = m_points[index % NB_POINTS];
-		
-		SavedProfilePoint saved;
-		util::storeString(saved.tag, point.tag);
-		saved.threadId = point.threadId;
-		saved.startTime = point.startTime;
-		saved.endTime = point.endTime;
+	for(ThreadInfos::const_iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
+		const ThreadInfo& threadInfo = it->second;
 		
-		out.write((const char*)&saved, sizeof(SavedProfilePoint));
+		SavedThreadInfo saved;
+		util::storeString(saved.threadName, threadInfo.threadName);
+		saved.threadId = threadInfo.threadId;
+		saved.startTime = ticksToUs(threadInfo.startTime);
+		saved.endTime = ticksToUs(threadInfo.endTime);
+		threads.push_back(saved);
 	}
 	
-	out.close();
+	return true;
 }
 
 
 
 static Profiler g_profiler;
 
+static void enableTraceFormat() {
+	g_writeTrace = true;
+}
+
+ARX_PROGRAM_OPTION("profile-trace", "",
+                   "Write profiler logs in the Chrome trace JSON format", &enableTraceFormat);
+
+ARX_PROGRAM_OPTION("profile-sample-rate", "",
+                   "Only record every N-th profile scope", &profiler::setSampleRate, "N");
+
 void profiler::initialize() {
 	LogInfo << "Profiler enabled";
 	g_profiler.registerThread("main");
+	g_profiler.start();
+}
+
+void profiler::shutdown() {
+	g_profiler.unregisterThread();
+	g_profiler.stop();
 }
 
 void profiler::flush() {
@@ -194,8 +817,32 @@ void profiler::unregisterThread() {
 	g_profiler.unregisterThread();
 }
 
-void profiler::addProfilePoint(const char * tag, thread_id_type threadId, u64 startTime, u64 endTime) {
-	g_profiler.addProfilePoint(tag, threadId, startTime, endTime);
+u16 profiler::internTag(const char * tag) {
+	return g_profiler.internTag(tag);
+}
+
+void profiler::addProfilePoint(u16 tag, thread_id_type threadId, u64 startTicks, u64 endTicks) {
+	g_profiler.addProfilePoint(tag, threadId, startTicks, endTicks);
+}
+
+void profiler::addFrameMarker() {
+	g_profiler.addFrameMarker();
+}
+
+void profiler::addCounter(u16 name, s64 value) {
+	g_profiler.addCounter(name, value);
+}
+
+void profiler::addMemoryEvent(u16 tag, s64 size) {
+	g_profiler.addMemoryEvent(tag, size);
+}
+
+void profiler::setSampleRate(u32 rate) {
+	g_sampleRate.store(std::max(rate, u32(1)), boost::memory_order_relaxed);
+}
+
+u32 profiler::getSampleRate() {
+	return g_sampleRate.load(boost::memory_order_relaxed);
 }
 
 #else
@@ -203,6 +850,9 @@ void profiler::addProfilePoint(const char * tag, thread_id_type threadId, u64 st
 void profiler::initialize() {
 }
 
+void profiler::shutdown() {
+}
+
 void profiler::flush() {
 }
 
@@ -213,11 +863,41 @@ void profiler::registerThread(const std::string & threadName) {
 void profiler::unregisterThread() {
 }
 
-void profiler::addProfilePoint(const char * tag, thread_id_type threadId, u64 startTime, u64 endTime) {
+u16 profiler::internTag(const char * tag) {
+	ARX_UNUSED(tag);
+	return 0;
+}
+
+u64 profiler::getTicks() {
+	return 0;
+}
+
+void profiler::addProfilePoint(u16 tag, thread_id_type threadId, u64 startTicks, u64 endTicks) {
 	ARX_UNUSED(tag);
 	ARX_UNUSED(threadId);
-	ARX_UNUSED(startTime);
-	ARX_UNUSED(endTime);
+	ARX_UNUSED(startTicks);
+	ARX_UNUSED(endTicks);
+}
+
+void profiler::addFrameMarker() {
+}
+
+void profiler::addCounter(u16 name, s64 value) {
+	ARX_UNUSED(name);
+	ARX_UNUSED(value);
+}
+
+void profiler::addMemoryEvent(u16 tag, s64 size) {
+	ARX_UNUSED(tag);
+	ARX_UNUSED(size);
+}
+
+void profiler::setSampleRate(u32 rate) {
+	ARX_UNUSED(rate);
+}
+
+u32 profiler::getSampleRate() {
+	return 1;
 }
 
 #endif // BUILD_PROFILER_INSTRUMENT
@@ -26,45 +26,141 @@
 
 namespace profiler {
 	
-	//! Initialize the Profiler
+	/*!
+	 * Initialize the Profiler
+	 *
+	 * Profile points are collected in per-thread buffers and continuously streamed to
+	 * a .perf file in the current working directory by a background thread.
+	 */
 	void initialize();
 	
-	//! Write the collected profile data to disk
+	//! Stop the background writer and finish the current .perf file
+	void shutdown();
+
+	//! Finish the current .perf file and continue writing profile data to a new one
 	void flush();
 	
 	void registerThread(const std::string& threadName);
 	void unregisterThread();
 	
-	void addProfilePoint(const char* tag, thread_id_type threadId, u64 startTime, u64 endTime);
+	/*!
+	 * Get the id for a tag name
+	 *
+	 * Profile buffers only store tag ids - names are resolved by the background writer.
+	 * Interning the same name again returns the same id. The profile macros call this
+	 * once per call site and cache the result.
+	 *
+	 * \param tag Name of the tag, must be a string literal
+	 */
+	u16 internTag(const char* tag);
+	
+	/*!
+	 * Get a timestamp for profile points
+	 *
+	 * This uses the cheapest monotonic clock available and the unit is platform-specific.
+	 * Timestamps are converted to microseconds when writing the log.
+	 */
+	u64 getTicks();
+	
+	void addProfilePoint(u16 tag, thread_id_type threadId, u64 startTicks, u64 endTicks);
+	
+	//! Mark the start of a new frame
+	void addFrameMarker();
+	
+	//! Record the current value of a counter
+	void addCounter(u16 name, s64 value);
+	
+	/*!
+	 * Record an allocation (positive size) or free (negative size)
+	 *
+	 * The profiler UI graphs the running total for each tag.
+	 */
+	void addMemoryEvent(u16 tag, s64 size);
+	
+	/*!
+	 * Only record every n-th profile scope on each thread
+	 *
+	 * Sampling makes it affordable to profile scopes in inner loops.
+	 * Frame markers, counters and memory events are always recorded.
+	 *
+	 * \param rate 1 to record all scopes
+	 */
+	void setSampleRate(u32 rate);
+	u32 getSampleRate();
 }
 
 #if BUILD_PROFILER_INSTRUMENT
 
+namespace profiler { namespace detail {
+
+#ifdef ARX_THREAD_LOCAL
+//! Number of scopes until the next one is recorded on the current thread
+extern ARX_THREAD_LOCAL u32 sampleCountdown;
+#endif
+
+//! Decide if the next scope should be recorded, slow path for \ref isSampled()
+bool sampleNext();
+
+//! \return true if the current profile scope should be recorded
+inline bool isSampled() {
+#ifdef ARX_THREAD_LOCAL
+	if(sampleCountdown > 1) {
+		sampleCountdown--;
+		return false;
+	}
+#endif
+	return sampleNext();
+}
+
+} } // namespace profiler::detail
+
 class ProfileScope {
 public:
-	explicit ProfileScope(const char* tag)
+	explicit ProfileScope(u16 tag)
 		: m_tag(tag)
-		, m_startTime(platform::getTimeUs())
-	{
-		arx_assert(tag != 0 && tag[0] != '\0');
-	}
+		, m_startTime(profiler::detail::isSampled() ? profiler::getTicks() : 0)
+	{ }
 	
 	~ProfileScope() {
-		profiler::addProfilePoint(m_tag, Thread::getCurrentThreadId(), m_startTime, platform::getTimeUs());
+		if(m_startTime != 0) {
+			profiler::addProfilePoint(m_tag, Thread::getCurrentThreadId(), m_startTime,
+			                          profiler::getTicks());
+		}
 	}
 	
 private:
-	const char* m_tag;
-	u64         m_startTime;
+	u16 m_tag;
+	u64 m_startTime; // 0 if the scope is not sampled
 };
 
-#define ARX_PROFILE(tag)           ProfileScope profileScope##__LINE__(#tag)
-#define ARX_PROFILE_FUNC()         ProfileScope profileScope##__LINE__(__FUNCTION__)
+#define ARX_PROFILE_SCOPE(name) \
+	static const u16 BOOST_PP_CAT(profileTag, __LINE__) = profiler::internTag(name); \
+	ProfileScope BOOST_PP_CAT(profileScope, __LINE__)(BOOST_PP_CAT(profileTag, __LINE__))
+
+#define ARX_PROFILE(tag)           ARX_PROFILE_SCOPE(#tag)
+#define ARX_PROFILE_FUNC()         ARX_PROFILE_SCOPE(__FUNCTION__)
+#define ARX_PROFILE_FRAME()        profiler::addFrameMarker()
+#define ARX_PROFILE_COUNTER(name, value) do { \
+		static const u16 profileTag = profiler::internTag(#name); \
+		profiler::addCounter(profileTag, s64(value)); \
+	} while(false)
+#define ARX_PROFILE_ALLOC(tag, size) do { \
+		static const u16 profileTag = profiler::internTag(#tag); \
+		profiler::addMemoryEvent(profileTag, s64(size)); \
+	} while(false)
+#define ARX_PROFILE_FREE(tag, size) do { \
+		static const u16 profileTag = profiler::internTag(#tag); \
+		profiler::addMemoryEvent(profileTag, -s64(size)); \
+	} while(false)
 
 #else
 
 #define ARX_PROFILE(tag)           ARX_DISCARD(tag)
 #define ARX_PROFILE_FUNC()         ARX_DISCARD()
+#define ARX_PROFILE_FRAME()        ARX_DISCARD()
+#define ARX_PROFILE_COUNTER(name, value) ARX_DISCARD(name, value)
+#define ARX_PROFILE_ALLOC(tag, size)     ARX_DISCARD(tag, size)
+#define ARX_PROFILE_FREE(tag, size)      ARX_DISCARD(tag, size)
 
 #endif // BUILD_PROFILER_INSTRUMENT
 
@@ -22,8 +22,40 @@
 
 #include "platform/Platform.h"
 
+/*
+ * A profiler log starts with a SavedProfilerHeader followed by any number of chunks,
+ * each consisting of a SavedProfilerChunkHeader and an array of items.
+ * Chunks are appended while profiling so a log that was cut short is still readable.
+ * Thread infos can be repeated, later entries replace earlier ones with the same id.
+ * Version 2 added frame markers, counter samples and memory events.
+ *
+ * Old logs have no header and contain a SavedThreadInfoHeader followed by the thread
+ * infos and a SavedProfilePointHeader followed by the profile points.
+ */
+
+static const char profilerMagic[8] = { 'A', 'R', 'X', 'P', 'R', 'O', 'F', '\0' };
+static const u32 profilerVersion = 2;
+
+enum ProfilerChunkType {
+	ProfilerChunk_Threads  = 1, //!< Array of SavedThreadInfo
+	ProfilerChunk_Points   = 2, //!< Array of SavedProfilePoint
+	ProfilerChunk_Frames   = 3, //!< Array of SavedProfilerFrame
+	ProfilerChunk_Counters = 4, //!< Array of SavedProfilerCounter
+	ProfilerChunk_Memory   = 5  //!< Array of SavedProfilerMemoryEvent
+};
+
 #pragma pack(push,1)
 
+struct SavedProfilerHeader {
+	char magic[8];
+	u32  version;
+};
+
+struct SavedProfilerChunkHeader {
+	u32  type;
+	u64  size;
+};
+
 struct SavedThreadInfoHeader {
 	u64  size;
 };
@@ -46,6 +78,26 @@ struct SavedProfilePoint {
 	u64  endTime;
 };
 
+struct SavedProfilerFrame {
+	u64  threadId;
+	u64  time;
+	u64  frame;
+};
+
+struct SavedProfilerCounter {
+	char name[32];
+	u64  threadId;
+	u64  time;
+	s64  value;
+};
+
+struct SavedProfilerMemoryEvent {
+	char tag[32];
+	u64  threadId;
+	u64  time;
+	s64  size; //!< Positive for allocations, negative for frees
+};
+
 #pragma pack(pop)
 
 #endif // ARX_PLATFORM_PROFILER_PROFILERDATAFORMAT_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "platform/profiler/ProfilerTrace.h"
+
+#include "util/String.h"
+
+static std::string quoted(const std::string & str) {
+	return '"' + util::escapeString(str, "\\\"") + '"';
+}
+
+ProfilerTraceWriter::ProfilerTraceWriter(std::ostream & out)
+	: m_out(out)
+	, m_empty(true)
+{
+	m_out << "[";
+}
+
+u32 ProfilerTraceWriter::getThreadId(u64 threadId) {
+	
+	ThreadIds::const_iterator it = m_threadIds.find(threadId);
+	if(it != m_threadIds.end()) {
+		return it->second;
+	}
+	
+	u32 id = u32(m_threadIds.size()) + 1;
+	m_threadIds[threadId] = id;
+	return id;
+}
+
+void ProfilerTraceWriter::beginEvent(const std::string & name, char phase, u64 threadId,
+                                     u64 time) {
+	
+	if(!m_empty) {
+		m_out << ",";
+	}
+	m_empty = false;
+	
+	m_out << "\n{\"name\":" << quoted(name) << ",\"ph\":\"" << phase << "\",\"pid\":1"
+	      << ",\"tid\":" << getThreadId(threadId) << ",\"ts\":" << time;
+}
+
+void ProfilerTraceWriter::addThread(const SavedThreadInfo & thread) {
+	
+	// Thread infos can be repeated with updated times, only the name is relevant here
+	beginEvent("thread_name", 'M', thread.threadId, thread.startTime);
+	m_out << ",\"args\":{\"name\":" << quoted(util::loadString(thread.threadName)) << "}}";
+}
+
+void ProfilerTraceWriter::addPoint(const SavedProfilePoint & point) {
+	
+	beginEvent(util::loadString(point.tag), 'X', point.threadId, point.startTime);
+	m_out << ",\"dur\":" << (point.endTime - point.startTime) << "}";
+}
+
+void ProfilerTraceWriter::addFrame(const SavedProfilerFrame & frame) {
+	
+	beginEvent("Frame", 'i', frame.threadId, frame.time);
+	m_out << ",\"s\":\"g\",\"args\":{\"frame\":" << frame.frame << "}}";
+}
+
+void ProfilerTraceWriter::addCounter(const SavedProfilerCounter & counter) {
+	
+	beginEvent(util::loadString(counter.name), 'C', counter.threadId, counter.time);
+	m_out << ",\"args\":{\"value\":" << counter.value << "}}";
+}
+
+void ProfilerTraceWriter::addMemoryEvent(const SavedProfilerMemoryEvent & event) {
+	
+	std::string tag = util::loadString(event.tag);
+	
+	s64 & total = m_memory[tag];
+	total += event.size;
+	
+	beginEvent("Memory: " + tag, 'C', event.threadId, event.time);
+	m_out << ",\"args\":{\"bytes\":" << total << "}}";
+}
+
+void ProfilerTraceWriter::finish() {
+	m_out << "\n]\n";
+	m_out.flush();
+}
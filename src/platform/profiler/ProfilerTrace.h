@@ -0,0 +1,77 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_PROFILER_PROFILERTRACE_H
+#define ARX_PLATFORM_PROFILER_PROFILERTRACE_H
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include "platform/Platform.h"
+#include "platform/profiler/ProfilerDataFormat.h"
+
+/*!
+ * Writes profiler data in the Chrome Trace Event JSON format.
+ *
+ * The output can be loaded by chrome://tracing, the Perfetto UI and other timeline
+ * tools. Events are written as soon as they are added so the trace can be streamed.
+ * Viewers accept traces without the closing bracket, so a trace that was cut short
+ * is still usable.
+ *
+ * Thread ids are replaced with small sequential numbers as the original ids may
+ * not be representable as JSON numbers. Memory events are converted to counters
+ * holding the running total for each tag.
+ */
+class ProfilerTraceWriter : private boost::noncopyable {
+	
+public:
+	
+	//! Start a new trace - writes the opening bracket
+	explicit ProfilerTraceWriter(std::ostream & out);
+	
+	void addThread(const SavedThreadInfo & thread);
+	void addPoint(const SavedProfilePoint & point);
+	void addFrame(const SavedProfilerFrame & frame);
+	void addCounter(const SavedProfilerCounter & counter);
+	void addMemoryEvent(const SavedProfilerMemoryEvent & event);
+	
+	//! Write the closing bracket, no more events may be added afterwards
+	void finish();
+	
+private:
+	
+	typedef std::map<u64, u32> ThreadIds;
+	typedef std::map<std::string, s64> MemoryTotals;
+	
+	std::ostream & m_out;
+	bool           m_empty;
+	ThreadIds      m_threadIds;
+	MemoryTotals   m_memory;
+	
+	u32 getThreadId(u64 threadId);
+	
+	//! Start a new event with the common fields
+	void beginEvent(const std::string & name, char phase, u64 threadId, u64 time);
+	
+};
+
+#endif // ARX_PLATFORM_PROFILER_PROFILERTRACE_H
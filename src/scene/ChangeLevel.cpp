@@ -46,6 +46,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "scene/ChangeLevel.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <cstdio>
@@ -83,6 +84,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/SaveBlock.h"
 #include "io/log/Logger.h"
 
+#include "platform/OS.h"
+#include "platform/ThreadPool.h"
+
 #include "scene/Interactive.h"
 #include "scene/GameSound.h"
 #include "scene/LoadLevel.h"
@@ -126,6 +130,7 @@ static float ARX_CHANGELEVEL_DesiredTime = 0;
 static long CONVERT_CREATED = 0;
 long DONT_WANT_PLAYER_INZONE = 0;
 static SaveBlock * g_currentSavedGame = NULL;
+static ThreadPool * g_saveCompressionPool = NULL;
 
 static ARX_CHANGELEVEL_IO_INDEX * idx_io = NULL;
 static ARX_CHANGELEVEL_INVENTORY_DATA_SAVE ** Gaids = NULL;
@@ -207,6 +212,8 @@ bool ARX_Changelevel_CurGame_Clear() {
 		delete g_currentSavedGame, g_currentSavedGame = NULL;
 	}
 	
+	delete g_saveCompressionPool, g_saveCompressionPool = NULL;
+	
 	if(CURRENT_GAME_FILE.empty()) {
 		CURRENT_GAME_FILE = fs::paths.user / "current.sav";
 	}
@@ -231,7 +238,13 @@ static bool openCurrentSavedGameFile() {
 		return true;
 	}
 	
-	g_currentSavedGame = new SaveBlock(CURRENT_GAME_FILE);
+	if(!g_saveCompressionPool) {
+		// Leave one processor for the main thread
+		size_t threads = std::max(platform::getCPUCount(), 2u) - 1;
+		g_saveCompressionPool = new ThreadPool(threads, "save");
+	}
+	
+	g_currentSavedGame = new SaveBlock(CURRENT_GAME_FILE, g_saveCompressionPool);
 	
 	if(!g_currentSavedGame->open(true)) {
 		LogError << "Error writing to save block " << CURRENT_GAME_FILE;
@@ -289,6 +302,12 @@ void currentSavedGameRemoveEntity(const std::string & idString) {
 
 extern long JUST_RELOADED;
 
+static std::string getLevelFile(long num) {
+	char levelId[256];
+	GetLevelNameByNum(num, levelId);
+	return std::string("graph/levels/level") + levelId + "/level" + levelId + ".dlf";
+}
+
 void ARX_CHANGELEVEL_Change(const std::string & level, const std::string & target, long angle) {
 	
 	LogDebug("ARX_CHANGELEVEL_Change " << level << " " << target << " " << angle);
@@ -323,6 +342,9 @@ void ARX_CHANGELEVEL_Change(const std::string & level, const std::string & targe
 	
 	ARX_PLAYER_Reset_Fall();
 	
+	// Start loading the new level while the current one is being saved
+	DanaePrefetchLevel(getLevelFile(num));
+	
 	arxtime.pause();
 	progressBarAdvance();
 	LoadLevelScreen(num);
@@ -607,9 +629,7 @@ static void ARX_CHANGELEVEL_Push_Globals() {
 		}
 	}
 	
-	g_currentSavedGame->save("globals", dat, pos);
-	
-	delete[] dat;
+	g_currentSavedGame->saveAsync("globals", dat, pos);
 }
 
 template <size_t N>
@@ -805,9 +825,7 @@ static long ARX_CHANGELEVEL_Push_Player(long level) {
 	
 	LastValidPlayerPos = asp->LAST_VALID_POS.toVec3();
 	
-	g_currentSavedGame->save("player", dat, pos);
-	
-	delete[] dat;
+	g_currentSavedGame->saveAsync("player", dat, pos);
 	
 	for(size_t i = 1; i < entities.size(); i++) {
 		const EntityHandle handle = EntityHandle(i);
@@ -1459,9 +1477,7 @@ static long ARX_CHANGELEVEL_Push_IO(const Entity * io, long level) {
 		LogError << "SaveBuffer Overflow " << pos << " >> " << allocsize;
 	}
 	
-	g_currentSavedGame->save(savefile, dat, pos);
-	
-	delete[] dat;
+	g_currentSavedGame->saveAsync(savefile, dat, pos);
 	
 	return 1;
 }
@@ -1575,9 +1591,7 @@ static long ARX_CHANGELEVEL_Pop_Zones_n_Lights(ARX_CHANGELEVEL_INDEX * asi, long
 static long ARX_CHANGELEVEL_Pop_Level(ARX_CHANGELEVEL_INDEX * asi, long num,
                                       bool firstTime) {
 	
-	char levelId[256];
-	GetLevelNameByNum(num, levelId);
-	std::string levelFile = std::string("graph/levels/level") + levelId + "/level" + levelId + ".dlf";
+	std::string levelFile = getLevelFile(num);
 	
 	LOAD_N_DONT_ERASE = 1;
 	
@@ -1862,18 +1876,20 @@ static long ARX_CHANGELEVEL_Pop_Player() {
 	return 1;
 }
 
-static bool loadScriptVariables(SCRIPT_VARIABLES& var, const char * dat, size_t & pos, VariableType ttext, VariableType tlong, VariableType tfloat) {
+static bool loadScriptVariables(SCRIPT_VARIABLES& var, size_t count, const char * dat, size_t & pos, VariableType ttext, VariableType tlong, VariableType tfloat) {
+	
+	var.clear();
 	
-	for(size_t i = 0; i < var.size(); i++) {
+	for(size_t i = 0; i < count; i++) {
 		
 		const ARX_CHANGELEVEL_VARIABLE_SAVE * avs;
 		avs = reinterpret_cast<const ARX_CHANGELEVEL_VARIABLE_SAVE *>(dat + pos);
 		pos += sizeof(ARX_CHANGELEVEL_VARIABLE_SAVE);
 		
-		var[i].name = boost::to_lower_copy(util::loadString(avs->name));
+		std::string name = boost::to_lower_copy(util::loadString(avs->name));
 			
-		if(var[i].name.find_first_not_of("abcdefghijklmnopqrstuvwxyz_0123456789", 1) != std::string::npos) {
-			LogWarning << "Unexpected variable name \"" << var[i].name.substr(1) << '"';
+		if(name.find_first_not_of("abcdefghijklmnopqrstuvwxyz_0123456789", 1) != std::string::npos) {
+			LogWarning << "Unexpected variable name \"" << name.substr(1) << '"';
 		}
 		
 		VariableType type;
@@ -1887,27 +1903,28 @@ static bool loadScriptVariables(SCRIPT_VARIABLES& var, const char * dat, size_t
 			type = tlong;
 		} else {
 			LogError << "Unknown script variable type: " << avs->type;
-			var.resize(i);
 			return false;
 		}
 		
-		var[i].fval = avs->fval;
-		var[i].ival = (long)avs->fval;
-		var[i].type = type;
+		SCRIPT_VAR & v = var.get(name);
+		
+		v.fval = avs->fval;
+		v.ival = (long)avs->fval;
+		v.type = type;
 		
 		if(type == ttext) {
-			if(var[i].ival) {
-				var[i].text = boost::to_lower_copy(util::loadString(dat + pos, (long)avs->fval));
+			if(v.ival) {
+				v.text = boost::to_lower_copy(util::loadString(dat + pos, (long)avs->fval));
 				pos += (long)avs->fval;
-				if(var[i].text[0] == '\xCC') {
-					var[i].text[0] = 0;
+				if(v.text[0] == '\xCC') {
+					v.text[0] = 0;
 				}
 			}
 		}
 		
 		LogDebug(((type & (TYPE_G_TEXT|TYPE_G_LONG|TYPE_G_FLOAT)) ? "global " : "local ") \
 		<< ((type & (TYPE_L_TEXT|TYPE_G_TEXT)) ? "text" : (type & (TYPE_L_LONG|TYPE_G_LONG)) ? "long" : (type & (TYPE_L_FLOAT|TYPE_G_FLOAT)) ? "float" : "unknown") \
-		<< " \"" << var[i].name.substr(1) << "\" = " << var[i].fval << ' ' << var[i].text \
+		<< " \"" << v.name.substr(1) << "\" = " << v.fval << ' ' << v.text \
 		);
 		
 	}
@@ -1923,10 +1940,7 @@ static bool loadScriptData(EERIE_SCRIPT & script, const char * dat, size_t & pos
 	
 	script.allowevents = DisabledEvents::load(ass->allowevents); // TODO save/load flags
 
-	script.lvar.clear();
-	script.lvar.resize(ass->nblvar);
-
-	return loadScriptVariables(script.lvar, dat, pos,
+	return loadScriptVariables(script.lvar, ass->nblvar, dat, pos,
 	                           TYPE_L_TEXT, TYPE_L_LONG, TYPE_L_FLOAT);
 }
 
@@ -2136,35 +2150,31 @@ static Entity * ARX_CHANGELEVEL_Pop_IO(const std::string & idString, EntityInsta
 			
 			short sFlags = checked_range_cast<short>(ats->flags);
 			
-			long num = ARX_SCRIPT_Timer_GetFree();
-			if(num == -1) {
+			std::string name = boost::to_lower_copy(util::loadString(ats->name));
+			SCR_TIMER * st = createScriptTimer(io, name);
+			if(!st) {
 				continue;
 			}
 			
-			ActiveTimers++;
-			
 			if(ats->script) {
-				scr_timer[num].es = &io->over_script;
+				st->es = &io->over_script;
 			} else {
-				scr_timer[num].es = &io->script;
+				st->es = &io->script;
 			}
 			
-			scr_timer[num].flags = sFlags;
-			scr_timer[num].exist = 1;
-			scr_timer[num].io = io;
-			scr_timer[num].msecs = ats->msecs;
-			scr_timer[num].name = boost::to_lower_copy(util::loadString(ats->name));
-			scr_timer[num].pos = ats->pos;
+			st->flags = sFlags;
+			st->msecs = ats->msecs;
+			st->pos = ats->pos;
 			// TODO if the script has changed since the last save, this position may be invalid
 			
 			float tt = ARX_CHANGELEVEL_DesiredTime + ats->tim;
 			if(tt < 0) {
-				scr_timer[num].tim = 0;
+				st->tim = 0;
 			} else {
-				scr_timer[num].tim = checked_range_cast<unsigned long>(tt);
+				st->tim = checked_range_cast<unsigned long>(tt);
 			}
 			
-			scr_timer[num].times = ats->times;
+			st->times = ats->times;
 		}
 		
 		if(!loadScriptData(io->script, dat, pos) || !loadScriptData(io->over_script, dat, pos)) {
@@ -2583,10 +2593,8 @@ static void ARX_CHANGELEVEL_Pop_Globals() {
 		return;
 	}
 	
-	svar.clear();
-	svar.resize(acsg->nb_globals);
-		
-	bool ret = loadScriptVariables(svar, dat, pos, TYPE_G_TEXT, TYPE_G_LONG, TYPE_G_FLOAT);
+	bool ret = loadScriptVariables(svar, acsg->nb_globals, dat, pos,
+	                               TYPE_G_TEXT, TYPE_G_LONG, TYPE_G_FLOAT);
 	if(!ret) {
 		LogError << "Error loading globals";
 	}
@@ -2701,11 +2709,7 @@ static bool ARX_CHANGELEVEL_PopLevel(long instance, bool reloadflag) {
 	
 	if(firstTime) {
 		unsigned long ulDTime = checked_range_cast<unsigned long>(ARX_CHANGELEVEL_DesiredTime);
-		for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-			if(scr_timer[i].exist) {
-				scr_timer[i].tim = ulDTime;
-			}
-		}
+		ARX_SCRIPT_Timer_SetStartTime(ulDTime);
 	} else {
 		LogDebug("Before ARX_CHANGELEVEL_PopAllIO");
 		ARX_CHANGELEVEL_PopAllIO(&asi);
@@ -2930,7 +2934,6 @@ long ARX_CHANGELEVEL_GetInfo(const fs::path & savefile, std::string & name, floa
 	
 	ARX_CHANGELEVEL_PLAYER_LEVEL_DATA pld;
 	
-	// IMPROVE this will load the whole save file FAT just to get one file!
 	if(ARX_CHANGELEVEL_Get_Player_LevelData(pld, savefile)) {
 		name = util::loadString(pld.name);
 		version = pld.version;
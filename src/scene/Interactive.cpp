@@ -58,6 +58,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <glm/gtx/norm.hpp>
 
+#include "ai/PathFinderManager.h"
 #include "ai/Paths.h"
 
 #include "animation/Animation.h"
@@ -105,7 +106,6 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "physics/Box.h"
 #include "physics/Clothes.h"
 
-#include "platform/Thread.h"
 #include "platform/profiler/Profiler.h"
 
 #include "scene/ChangeLevel.h"
@@ -232,11 +232,7 @@ void ARX_INTERACTIVE_DestroyDynamicInfo(Entity * io)
 	}
 	
 	if(io->ioflags & IO_NPC) {
-		// to check again later...
-		long count = 50;
-		while((io->_npcdata->pathfind.pathwait == 1) && count--) {
-			Thread::sleep(1);
-		}
+		EERIE_PATHFINDER_Cancel(io);
 		free(io->_npcdata->pathfind.list);
 		io->_npcdata->pathfind = IO_PATHFIND();
 	}
@@ -1155,19 +1151,14 @@ void ARX_INTERACTIVE_TeleportBehindTarget(Entity * io)
 		return;
 
 	if(ARX_SCRIPT_GetSystemIOScript(io, "_r_a_t_") < 0) {
-		long num = ARX_SCRIPT_Timer_GetFree();
+		SCR_TIMER * st = createScriptTimer(io, "_r_a_t_");
 
-		if(num != -1) {
+		if(st) {
 			EntityHandle t = io->index();
-			ActiveTimers++;
-			scr_timer[num].es = NULL;
-			scr_timer[num].exist = 1;
-			scr_timer[num].io = io;
-			scr_timer[num].msecs = Random::get(3000, 6000);
-			scr_timer[num].name = "_r_a_t_";
-			scr_timer[num].pos = -1; 
-			scr_timer[num].tim = (unsigned long)(arxtime);
-			scr_timer[num].times = 1;
+			st->es = NULL;
+			st->msecs = Random::get(3000, 6000);
+			st->pos = -1;
+			st->times = 1;
 			entities[t]->show = SHOW_FLAG_TELEPORTING;
 			AddRandomSmoke(io, 10);
 			ARX_PARTICLES_Add_Smoke(&io->pos, 3, 20);
@@ -82,6 +82,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/fs/SystemPaths.h"
 #include "io/resource/ResourcePath.h"
 #include "io/resource/PakReader.h"
+#include "io/resource/ResourcePrefetcher.h"
 #include "io/Blast.h"
 #include "io/Implode.h"
 #include "io/log/Logger.h"
@@ -486,10 +487,76 @@ Vec3f MSP;
 
 extern long FASTmse;
 
+//! Drop prefetched level files that have not been used.
+static void releasePrefetchedLevel() {
+	
+	if(resourcePrefetcher) {
+		resourcePrefetcher->cancel();
+	}
+	
+	resources->discardPrefetched();
+}
+
+//! Calls releasePrefetchedLevel() when leaving the scope.
+struct PrefetchedLevelReleaser {
+	~PrefetchedLevelReleaser() {
+		releasePrefetchedLevel();
+	}
+};
+
+void DanaePrefetchLevel(const res::path & file) {
+	
+	if(!resourcePrefetcher) {
+		return;
+	}
+	
+	std::vector<res::path> files;
+	files.push_back(file);
+	files.push_back(res::path(file).set_ext("llf"));
+	files.push_back("game" / file.parent() / "fast.fts");
+	
+	resourcePrefetcher->prefetch(files);
+}
+
+//! Get the class of an entity stored in a level file.
+static res::path getEntityClassPath(const DANAE_LS_INTER * dli) {
+	
+	std::string pathstr = boost::to_lower_copy(util::loadString(dli->name));
+	
+	size_t pos = pathstr.find("graph");
+	if(pos != std::string::npos) {
+		pathstr = pathstr.substr(pos);
+	}
+	
+	return res::path::load(pathstr).remove_ext();
+}
+
+//! Prefetch the models of the entities in a level file while the scene is loaded.
+static void prefetchLevelEntities(const DANAE_LS_INTER * dli, long count) {
+	
+	if(!resourcePrefetcher) {
+		return;
+	}
+	
+	std::vector<res::path> files;
+	files.reserve(count);
+	for(long i = 0; i < count; i++) {
+		// Same path as used by ARX_FTL_Load()
+		files.push_back((res::path("game") / getEntityClassPath(&dli[i])) + ".ftl");
+	}
+	
+	resourcePrefetcher->prefetch(files);
+}
+
 bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 	
 	LogInfo << "Loading Level " << file;
 	
+	// Load the lighting and scene files in the background while the level file is
+	// being processed. This does nothing if the level has already been prefetched.
+	DanaePrefetchLevel(file);
+	PrefetchedLevelReleaser releasePrefetched;
+	
 	CURRENTLEVEL = GetLevelNumByName(file.string());
 	
 	res::path lightingFileName = res::path(file).set_ext("llf");
@@ -544,6 +611,11 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		return false;
 	}
 	
+	if(loadEntities && dlh.nb_inter > 0) {
+		size_t inter = pos + (dlh.nb_scn > 0 ? sizeof(DANAE_LS_SCENE) : 0);
+		prefetchLevelEntities(reinterpret_cast<const DANAE_LS_INTER *>(dat + inter), dlh.nb_inter);
+	}
+	
 	LogDebug("Loading Scene");
 	
 	// Loading Scene
@@ -622,15 +694,7 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		pos += sizeof(DANAE_LS_INTER);
 		
 		if(loadEntities) {
-			
-			std::string pathstr = boost::to_lower_copy(util::loadString(dli->name));
-			
-			size_t pos = pathstr.find("graph");
-			if(pos != std::string::npos) {
-				pathstr = pathstr.substr(pos);
-			}
-			
-			res::path classPath = res::path::load(pathstr).remove_ext();
+			res::path classPath = getEntityClassPath(dli);
 			LoadInter_Ex(classPath, dli->ident, dli->pos.toVec3(), dli->angle, trans);
 		}
 	}
@@ -824,12 +888,11 @@ bool DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		
 		// using compression
 		if(dlh.version >= 1.44f) {
-			char * compressed = lightingFile->readAlloc();
-			dat = (char*)blastMemAlloc(compressed, lightingFile->size(), FileSize);
+			char * compressed = resources->readAlloc(lightingFileName, FileSize);
+			dat = (char*)blastMemAlloc(compressed, FileSize, FileSize);
 			free(compressed);
 		} else {
-			dat = lightingFile->readAlloc();
-			FileSize = lightingFile->size();
+			dat = resources->readAlloc(lightingFileName, FileSize);
 		}
 	}
 	// TODO size ignored
@@ -63,6 +63,13 @@ namespace fs { class path; }
 long DanaeSaveLevel(const fs::path & file);
 #endif
 
+/*!
+ * Start loading the level, lighting and scene files for a level in the background.
+ * The entity models are prefetched by DanaeLoadLevel() once the level file is read.
+ * \param file The level (.dlf) file that will be passed to DanaeLoadLevel().
+ */
+void DanaePrefetchLevel(const res::path & file);
+
 bool DanaeLoadLevel(const res::path & file, bool loadEntities = true);
 void DanaeClearLevel(long flags = 0);
 void RestoreLastLoadedLightning(EERIE_BACKGROUND & eb);
@@ -52,9 +52,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdio>
 #include <algorithm>
 #include <limits>
+#include <map>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 #include "ai/Paths.h"
 
@@ -85,6 +88,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "scene/Interactive.h"
 
 #include "script/ScriptEvent.h"
+#include "script/ScriptUtils.h"
 
 
 #define MAX_SSEPARAMS 5
@@ -101,8 +105,71 @@ long FORBID_SCRIPT_IO_CREATION = 0;
 SCR_TIMER * scr_timer = NULL;
 long ActiveTimers = 0;
 
+//! Length of the "on " or ">>" prefix for strings that are stored in EERIE_SCRIPT::offsets
+static size_t getOffsetPrefixLength(const char * begin, const char * end) {
+	if(end - begin >= 3 && begin[0] == 'o' && begin[1] == 'n' && begin[2] == ' ') {
+		return 3;
+	} else if(end - begin >= 2 && begin[0] == '>' && begin[1] == '>') {
+		return 2;
+	}
+	return 0;
+}
+
+//! Find all event handlers and labels - must give the same results as the search below
+static void computeOffsets(EERIE_SCRIPT & es) {
+	
+	es.offsets.clear();
+	
+	const char * data = es.data;
+	const char * end = es.data + es.size;
+	
+	bool comment = false;
+	for(const char * p = data; p != end; p++) {
+		
+		if(*p == '\n') {
+			comment = false;
+			continue;
+		} else if(comment) {
+			continue;
+		} else if(p[0] == '/' && p + 1 != end && p[1] == '/') {
+			comment = true;
+			continue;
+		}
+		
+		size_t prefix = getOffsetPrefixLength(p, end);
+		if(!prefix) {
+			continue;
+		}
+		
+		const char * name = p + prefix;
+		while(name != end && ((unsigned char)*name) > 32) {
+			name++;
+		}
+		if(name == end) {
+			// Not followed by a separator
+			continue;
+		}
+		
+		// Only the first occurrence is used
+		es.offsets.insert(std::make_pair(std::string(p, name), long(p - data)));
+	}
+	
+}
+
 long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str) {
 	
+	size_t prefix = getOffsetPrefixLength(str.data(), str.data() + str.length());
+	if(prefix && !es->offsets.empty()) {
+		bool separator = false;
+		for(size_t i = prefix; i < str.length(); i++) {
+			separator = separator || ((unsigned char)str[i]) <= 32;
+		}
+		if(!separator) {
+			SCRIPT_OFFSETS::const_iterator it = es->offsets.find(str);
+			return (it == es->offsets.end()) ? -1 : it->second;
+		}
+	}
+	
 	// TODO(script-parser) remove, respect quoted strings
 	
 	const char * start = es->data;
@@ -293,814 +360,983 @@ void ReleaseScript(EERIE_SCRIPT * es) {
 	
 	ARX_SCRIPT_ReleaseLabels(es);
 	memset(es->shortcut, 0, sizeof(long) * MAX_SHORTCUT);
+	
+	es->offsets.clear();
+	es->tokens.clear();
 }
 
-ValueType getSystemVar(const EERIE_SCRIPT * es, Entity * entity, const std::string & name,
-                       std::string& txtcontent, float * fcontent,long * lcontent) {
+typedef std::map<std::string, std::pair<SystemVariable, bool> > SystemVariables;
+static SystemVariables systemVariables;
+
+void registerSystemVariable(const std::string & name, SystemVariable handler, bool prefix) {
 	
 	arx_assert(!name.empty() && name[0] == '^', "bad system variable: \"%s\"", name.c_str());
 	
-	char c = (name.length() < 2) ? '\0' : name[1];
-	switch(c) {
+	typedef std::pair<SystemVariables::iterator, bool> Res;
+	
+	Res res = systemVariables.insert(std::make_pair(name, std::make_pair(handler, prefix)));
+	
+	if(!res.second) {
+		LogError << "Duplicate system variable name: " + name;
+	}
+	
+}
+
+/*!
+ * Find the handler for a system variable
+ *
+ * This is the longest registered name that is either equal to the variable name or,
+ * if it is registered as a prefix, starts the variable name.
+ */
+static SystemVariable findSystemVariable(const std::string & name) {
+	
+	SystemVariables::const_iterator it = systemVariables.upper_bound(name);
+	
+	while(it != systemVariables.begin()) {
 		
-		case '$': {
-			
-			if(name == "^$param1") {
-				txtcontent = SSEPARAMS[0];
-				return TYPE_TEXT;
-			}
-			
-			if(name == "^$param2") {
-				txtcontent = SSEPARAMS[1];
-				return TYPE_TEXT;
-			}
-			
-			if(name == "^$param3") {
-				txtcontent = SSEPARAMS[2];
-				return TYPE_TEXT;
-			}
-			
-			if(name == "^$objontop") {
-				txtcontent = "none";
-				if(entity) {
-					MakeTopObjString(entity, txtcontent);
-				}
-				return TYPE_TEXT;
-			}
-			
-			break;
+		--it;
+		
+		const std::string & key = it->first;
+		size_t common = 0;
+		while(common < key.length() && common < name.length() && key[common] == name[common]) {
+			common++;
 		}
 		
-		case '&': {
-			
-			if(name == "^&param1") {
-				*fcontent = (float)atof(SSEPARAMS[0]);
-				return TYPE_FLOAT;
-			}
-			
-			if(name == "^&param2") {
-				*fcontent = (float)atof(SSEPARAMS[1]);
-				return TYPE_FLOAT;
-			}
-			
-			if(name == "^&param3") {
-				*fcontent = (float)atof(SSEPARAMS[2]);
-				return TYPE_FLOAT;
+		if(common == key.length()) {
+			if(common == name.length() || it->second.second) {
+				return it->second.first;
 			}
-			
-			if(name == "^&playerdist") {
-				if(entity) {
-					*fcontent = fdist(player.pos, entity->pos);
-					return TYPE_FLOAT;
-				}
-			}
-			
-			break;
+			// Exact name that is shorter than the variable
+			common--;
 		}
 		
-		case '#': {
-			
-			if(name == "^#playerdist") {
-				if(entity) {
-					*lcontent = (long)fdist(player.pos, entity->pos);
-					return TYPE_LONG;
-				}
-			}
-			
-			if(name == "^#param1") {
-				*lcontent = atol(SSEPARAMS[0]);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#param2") {
-				*lcontent = atol(SSEPARAMS[1]);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#param3") {
-				*lcontent = atol(SSEPARAMS[2]);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#timer1") {
-				if(!entity || entity->script.timers[0] == 0) {
-					*lcontent = 0;
-				} else {
-					*lcontent = long((unsigned long)(arxtime) - es->timers[0]);
-				}
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#timer2") {
-				if(!entity || entity->script.timers[1] == 0) {
-					*lcontent = 0;
-				} else {
-					*lcontent = long((unsigned long)(arxtime) - es->timers[1]);
-				}
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#timer3") {
-				if(!entity || entity->script.timers[2] == 0) {
-					*lcontent = 0;
-				} else {
-					*lcontent = long((unsigned long)(arxtime) - es->timers[2]);
-				}
-				return TYPE_LONG;
-			}
-			
-			if(name == "^#timer4") {
-				if(!entity || entity->script.timers[3] == 0) {
-					*lcontent = 0;
-				} else {
-					*lcontent = long((unsigned long)(arxtime) - es->timers[3]);
-				}
-				return TYPE_LONG;
-			}
-			
-			break;
+		// Any remaining candidates must be a prefix of the common part
+		it = systemVariables.upper_bound(name.substr(0, common));
+	}
+	
+	return NULL;
+}
+
+static ValueType getParam(const EERIE_SCRIPT *, Entity *, const std::string & name,
+                          std::string & txtcontent, float * fcontent, long * lcontent) {
+	
+	const char * param = SSEPARAMS[name[7] - '1'];
+	
+	switch(name[1]) {
+		case '$': {
+			txtcontent = param;
+			return TYPE_TEXT;
+		}
+		case '&': {
+			*fcontent = (float)atof(param);
+			return TYPE_FLOAT;
+		}
+		default: {
+			*lcontent = atol(param);
+			return TYPE_LONG;
 		}
+	}
+}
+
+static ValueType getTimer(const EERIE_SCRIPT * es, Entity * entity, const std::string & name,
+                          std::string &, float *, long * lcontent) {
+	
+	size_t i = name[7] - '1';
+	
+	if(!entity || entity->script.timers[i] == 0) {
+		*lcontent = 0;
+	} else {
+		*lcontent = long((unsigned long)(arxtime) - es->timers[i]);
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getObjOnTop(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                             std::string & txtcontent, float *, long *) {
+	
+	txtcontent = "none";
+	if(entity) {
+		MakeTopObjString(entity, txtcontent);
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getPlayerDistFloat(const EERIE_SCRIPT *, Entity * entity,
+                                    const std::string &, std::string &, float * fcontent,
+                                    long * lcontent) {
+	
+	if(entity) {
+		*fcontent = fdist(player.pos, entity->pos);
+		return TYPE_FLOAT;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getPlayerDistLong(const EERIE_SCRIPT *, Entity * entity,
+                                   const std::string &, std::string &, float *,
+                                   long * lcontent) {
+	
+	if(entity) {
+		*lcontent = (long)fdist(player.pos, entity->pos);
+		return TYPE_LONG;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getGore(const EERIE_SCRIPT *, Entity *, const std::string &, std::string &,
+                         float *, long * lcontent) {
+	
+	*lcontent = 1;
+	return TYPE_LONG;
+}
+
+static ValueType getGameDays(const EERIE_SCRIPT *, Entity *, const std::string &,
+                             std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 86400000);
+	return TYPE_LONG;
+}
+
+static ValueType getGameHours(const EERIE_SCRIPT *, Entity *, const std::string &,
+                              std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 3600000);
+	return TYPE_LONG;
+}
+
+static ValueType getGameMinutes(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 60000);
+	return TYPE_LONG;
+}
+
+static ValueType getGameSeconds(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 1000);
+	return TYPE_LONG;
+}
+
+static ValueType getAmount(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                           std::string &, float * fcontent, long *) {
+	
+	if(entity && (entity->ioflags & IO_ITEM)) {
+		*fcontent = entity->_itemdata->count;
+	} else {
+		*fcontent = 0;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getArxDays(const EERIE_SCRIPT *, Entity *, const std::string &,
+                            std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 7200000);
+	return TYPE_LONG;
+}
+
+static ValueType getArxHours(const EERIE_SCRIPT *, Entity *, const std::string &,
+                             std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 600000);
+	return TYPE_LONG;
+}
+
+static ValueType getArxMinutes(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 10000);
+	return TYPE_LONG;
+}
+
+static ValueType getArxSeconds(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 1000) * 6;
+	return TYPE_LONG;
+}
+
+static ValueType getArxTimeHours(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                 std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 600000);
+	while(*lcontent > 12) {
+		*lcontent -= 12;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getArxTimeMinutes(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                   std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) / 10000);
+	while(*lcontent > 60) {
+		*lcontent -= 60;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getArxTimeSeconds(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                   std::string &, float *, long * lcontent) {
+	
+	*lcontent = static_cast<long>(float(arxtime) * 6 / 1000);
+	while(*lcontent > 60) {
+		*lcontent -= 60;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getRealDist(const EERIE_SCRIPT *, Entity * entity,
+                             const std::string & name, std::string &, float * fcontent,
+                             long * lcontent) {
+	
+	if(entity) {
+		const char * obj = name.c_str() + 10;
 		
-		case 'g': {
-			
-			if(name == "^gore") {
-				*lcontent = 1;
-				return TYPE_LONG;
-			}
-			
-			if(name == "^gamedays") {
-				*lcontent = static_cast<long>(float(arxtime) / 86400000);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^gamehours") {
-				*lcontent = static_cast<long>(float(arxtime) / 3600000);
-				return TYPE_LONG;
+		if(!strcmp(obj, "player")) {
+			if(entity->requestRoomUpdate) {
+				UpdateIORoom(entity);
 			}
-			
-			if(name == "^gameminutes") {
-				*lcontent = static_cast<long>(float(arxtime) / 60000);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^gameseconds") {
-				*lcontent = static_cast<long>(float(arxtime) / 1000);
-				return TYPE_LONG;
-			}
-			
-			break;
+			long Player_Room = ARX_PORTALS_GetRoomNumForPosition(player.pos, 1);
+			*fcontent = SP_GetRoomDist(entity->pos, player.pos, entity->room, Player_Room);
+			return TYPE_FLOAT;
 		}
 		
-		case 'a': {
-			
-			if(boost::starts_with(name, "^amount")) {
-				if(entity && (entity->ioflags & IO_ITEM)) {
-					*fcontent = entity->_itemdata->count;
-				} else {
-					*fcontent = 0;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(name == "^arxdays") {
-				*lcontent = static_cast<long>(float(arxtime) / 7200000);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxhours") {
-				*lcontent = static_cast<long>(float(arxtime) / 600000);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxminutes") {
-				*lcontent = static_cast<long>(float(arxtime) / 10000);
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxseconds") {
-				*lcontent = static_cast<long>(float(arxtime) / 1000) * 6;
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxtime_hours") {
-				*lcontent = static_cast<long>(float(arxtime) / 600000);
-				while(*lcontent > 12) {
-					*lcontent -= 12;
-				}
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxtime_minutes") {
-				*lcontent = static_cast<long>(float(arxtime) / 10000);
-				while(*lcontent > 60) {
-					*lcontent -= 60;
+		EntityHandle t = entities.getById(obj);
+		if(ValidIONum(t)) {
+			if((entity->show == SHOW_FLAG_IN_SCENE
+			    || entity->show == SHOW_FLAG_IN_INVENTORY)
+			   && (entities[t]->show == SHOW_FLAG_IN_SCENE
+			       || entities[t]->show == SHOW_FLAG_IN_INVENTORY)) {
+				
+				Vec3f pos  = GetItemWorldPosition(entity);
+				Vec3f pos2 = GetItemWorldPosition(entities[t]);
+				
+				if(entity->requestRoomUpdate) {
+					UpdateIORoom(entity);
 				}
-				return TYPE_LONG;
-			}
-			
-			if(name == "^arxtime_seconds") {
-				*lcontent = static_cast<long>(float(arxtime) * 6 / 1000);
-				while(*lcontent > 60) {
-					*lcontent -= 60;
+				
+				if(entities[t]->requestRoomUpdate) {
+					UpdateIORoom(entities[t]);
 				}
-				return TYPE_LONG;
+				
+				*fcontent = SP_GetRoomDist(pos, pos2, entity->room, entities[t]->room);
+				
+			} else {
+				// Out of this world item
+				*fcontent = 99999999999.f;
 			}
-			
-			break;
+			return TYPE_FLOAT;
 		}
 		
-		case 'r': {
-			
-			if(boost::starts_with(name, "^realdist_")) {
-				if(entity) {
-					const char * obj = name.c_str() + 10;
-					
-					if(!strcmp(obj, "player")) {
-						if(entity->requestRoomUpdate) {
-							UpdateIORoom(entity);
-						}
-						long Player_Room = ARX_PORTALS_GetRoomNumForPosition(player.pos, 1);
-						*fcontent = SP_GetRoomDist(entity->pos, player.pos, entity->room, Player_Room);
-						return TYPE_FLOAT;
-					}
-					
-					EntityHandle t = entities.getById(obj);
-					if(ValidIONum(t)) {
-						if((entity->show == SHOW_FLAG_IN_SCENE
-						    || entity->show == SHOW_FLAG_IN_INVENTORY)
-						   && (entities[t]->show == SHOW_FLAG_IN_SCENE
-						       || entities[t]->show == SHOW_FLAG_IN_INVENTORY)) {
-							
-							Vec3f pos  = GetItemWorldPosition(entity);
-							Vec3f pos2 = GetItemWorldPosition(entities[t]);
-							
-							if(entity->requestRoomUpdate) {
-								UpdateIORoom(entity);
-							}
-							
-							if(entities[t]->requestRoomUpdate) {
-								UpdateIORoom(entities[t]);
-							}
-							
-							*fcontent = SP_GetRoomDist(pos, pos2, entity->room, entities[t]->room);
-							
-						} else {
-							// Out of this world item
-							*fcontent = 99999999999.f;
-						}
-						return TYPE_FLOAT;
-					}
-					
-					*fcontent = 99999999999.f;
-					return TYPE_FLOAT;
-				}
-			}
-			
-			if(boost::starts_with(name, "^repairprice_")) {
-				EntityHandle t = entities.getById(name.substr(13));
-				if(ValidIONum(t)) {
-					*fcontent = ARX_DAMAGES_ComputeRepairPrice(entities[t], entity);
-				} else {
-					*fcontent = 0;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^rnd_")) {
-				const char * max = name.c_str() + 5;
-				// TODO should max be inclusive or exclusive?
-				// if inclusive, use proper integer random, otherwise fix rnd()?
-				if(max[0]) {
-					float t = (float)atof(max);
-					*fcontent = t * rnd();
-					return TYPE_FLOAT;
-				}
-				*fcontent = 0;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^rune_")) {
-				std::string temp = name.substr(6);
-				*lcontent = 0;
-				if(temp == "aam") {
-					*lcontent = player.rune_flags & FLAG_AAM;
-				} else if(temp == "cetrius") {
-					*lcontent = player.rune_flags & FLAG_CETRIUS;
-				} else if(temp == "comunicatum") {
-					*lcontent = player.rune_flags & FLAG_COMUNICATUM;
-				} else if(temp == "cosum") {
-					*lcontent = player.rune_flags & FLAG_COSUM;
-				} else if(temp == "folgora") {
-					*lcontent = player.rune_flags & FLAG_FOLGORA;
-				} else if(temp == "fridd") {
-					*lcontent = player.rune_flags & FLAG_FRIDD;
-				} else if(temp == "kaom") {
-					*lcontent = player.rune_flags & FLAG_KAOM;
-				} else if(temp == "mega") {
-					*lcontent = player.rune_flags & FLAG_MEGA;
-				} else if(temp == "morte") {
-					*lcontent = player.rune_flags & FLAG_MORTE;
-				} else if(temp == "movis") {
-					*lcontent = player.rune_flags & FLAG_MOVIS;
-				} else if(temp == "nhi") {
-					*lcontent = player.rune_flags & FLAG_NHI;
-				} else if(temp == "rhaa") {
-					*lcontent = player.rune_flags & FLAG_RHAA;
-				} else if(temp == "spacium") {
-					*lcontent = player.rune_flags & FLAG_SPACIUM;
-				} else if(temp == "stregum") {
-					*lcontent = player.rune_flags & FLAG_STREGUM;
-				} else if(temp == "taar") {
-					*lcontent = player.rune_flags & FLAG_TAAR;
-				} else if(temp == "tempus") {
-					*lcontent = player.rune_flags & FLAG_TEMPUS;
-				} else if(temp == "tera") {
-					*lcontent = player.rune_flags & FLAG_TERA;
-				} else if(temp == "vista") {
-					*lcontent = player.rune_flags & FLAG_VISTA;
-				} else if(temp == "vitae") {
-					*lcontent = player.rune_flags & FLAG_VITAE;
-				} else if(temp == "yok") {
-					*lcontent = player.rune_flags & FLAG_YOK;
-				}
-				return TYPE_LONG;
-			}
-			
-			break;
+		*fcontent = 99999999999.f;
+		return TYPE_FLOAT;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getRepairPrice(const EERIE_SCRIPT *, Entity * entity,
+                                const std::string & name, std::string &, float * fcontent,
+                                long *) {
+	
+	EntityHandle t = entities.getById(name.substr(13));
+	if(ValidIONum(t)) {
+		*fcontent = ARX_DAMAGES_ComputeRepairPrice(entities[t], entity);
+	} else {
+		*fcontent = 0;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getRandom(const EERIE_SCRIPT *, Entity *, const std::string & name,
+                           std::string &, float * fcontent, long *) {
+	
+	const char * max = name.c_str() + 5;
+	// TODO should max be inclusive or exclusive?
+	// if inclusive, use proper integer random, otherwise fix rnd()?
+	if(max[0]) {
+		float t = (float)atof(max);
+		*fcontent = t * rnd();
+		return TYPE_FLOAT;
+	}
+	*fcontent = 0;
+	return TYPE_FLOAT;
+}
+
+static ValueType getRune(const EERIE_SCRIPT *, Entity *, const std::string & name,
+                         std::string &, float *, long * lcontent) {
+	
+	std::string temp = name.substr(6);
+	*lcontent = 0;
+	if(temp == "aam") {
+		*lcontent = player.rune_flags & FLAG_AAM;
+	} else if(temp == "cetrius") {
+		*lcontent = player.rune_flags & FLAG_CETRIUS;
+	} else if(temp == "comunicatum") {
+		*lcontent = player.rune_flags & FLAG_COMUNICATUM;
+	} else if(temp == "cosum") {
+		*lcontent = player.rune_flags & FLAG_COSUM;
+	} else if(temp == "folgora") {
+		*lcontent = player.rune_flags & FLAG_FOLGORA;
+	} else if(temp == "fridd") {
+		*lcontent = player.rune_flags & FLAG_FRIDD;
+	} else if(temp == "kaom") {
+		*lcontent = player.rune_flags & FLAG_KAOM;
+	} else if(temp == "mega") {
+		*lcontent = player.rune_flags & FLAG_MEGA;
+	} else if(temp == "morte") {
+		*lcontent = player.rune_flags & FLAG_MORTE;
+	} else if(temp == "movis") {
+		*lcontent = player.rune_flags & FLAG_MOVIS;
+	} else if(temp == "nhi") {
+		*lcontent = player.rune_flags & FLAG_NHI;
+	} else if(temp == "rhaa") {
+		*lcontent = player.rune_flags & FLAG_RHAA;
+	} else if(temp == "spacium") {
+		*lcontent = player.rune_flags & FLAG_SPACIUM;
+	} else if(temp == "stregum") {
+		*lcontent = player.rune_flags & FLAG_STREGUM;
+	} else if(temp == "taar") {
+		*lcontent = player.rune_flags & FLAG_TAAR;
+	} else if(temp == "tempus") {
+		*lcontent = player.rune_flags & FLAG_TEMPUS;
+	} else if(temp == "tera") {
+		*lcontent = player.rune_flags & FLAG_TERA;
+	} else if(temp == "vista") {
+		*lcontent = player.rune_flags & FLAG_VISTA;
+	} else if(temp == "vitae") {
+		*lcontent = player.rune_flags & FLAG_VITAE;
+	} else if(temp == "yok") {
+		*lcontent = player.rune_flags & FLAG_YOK;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getInZone(const EERIE_SCRIPT *, Entity * entity, const std::string & name,
+                           std::string &, float *, long * lcontent) {
+	
+	const char * zone = name.c_str() + 8;
+	ARX_PATH * ap = ARX_PATH_GetAddressByName(zone);
+	*lcontent = 0;
+	if(entity && ap) {
+		if(ARX_PATH_IsPosInZone(ap, entity->pos)) {
+			*lcontent = 1;
 		}
-		
-		case 'i': {
-			
-			if(boost::starts_with(name, "^inzone_")) {
-				const char * zone = name.c_str() + 8;
-				ARX_PATH * ap = ARX_PATH_GetAddressByName(zone);
-				*lcontent = 0;
-				if(entity && ap) {
-					if(ARX_PATH_IsPosInZone(ap, entity->pos)) {
-						*lcontent = 1;
-					}
-				}
-				return TYPE_LONG;
-			}
-			
-			if(boost::starts_with(name, "^ininitpos")) {
-				*lcontent = 0;
-				if(entity) {
-					Vec3f pos = GetItemWorldPosition(entity);
-					if(pos == entity->initpos)
-						*lcontent = 1;
-				}
-				return TYPE_LONG;
-			}
-			
-			if(boost::starts_with(name, "^inplayerinventory")) {
-				*lcontent = 0;
-				if(entity && (entity->ioflags & IO_ITEM) && IsInPlayerInventory(entity)) {
-					*lcontent = 1;
-				}
-				return TYPE_LONG;
-			}
-			
-			break;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getInInitPos(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                              std::string &, float *, long * lcontent) {
+	
+	*lcontent = 0;
+	if(entity) {
+		Vec3f pos = GetItemWorldPosition(entity);
+		if(pos == entity->initpos)
+			*lcontent = 1;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getInPlayerInventory(const EERIE_SCRIPT *, Entity * entity,
+                                      const std::string &, std::string &, float *,
+                                      long * lcontent) {
+	
+	*lcontent = 0;
+	if(entity && (entity->ioflags & IO_ITEM) && IsInPlayerInventory(entity)) {
+		*lcontent = 1;
+	}
+	return TYPE_LONG;
+}
+
+static ValueType getBehavior(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                             std::string & txtcontent, float *, long *) {
+	
+	txtcontent = "";
+	if(entity && (entity->ioflags & IO_NPC)) {
+		if(entity->_npcdata->behavior & BEHAVIOUR_LOOK_AROUND) {
+			txtcontent += "l";
 		}
-		
-		case 'b': {
-			
-			if(boost::starts_with(name, "^behavior")) {
-				txtcontent = "";
-				if(entity && (entity->ioflags & IO_NPC)) {
-					if(entity->_npcdata->behavior & BEHAVIOUR_LOOK_AROUND) {
-						txtcontent += "l";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_SNEAK) {
-						txtcontent += "s";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_DISTANT) {
-						txtcontent += "d";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_MAGIC) {
-						txtcontent += "m";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_FIGHT) {
-						txtcontent += "f";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_GO_HOME) {
-						txtcontent += "h";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_FRIENDLY) {
-						txtcontent += "r";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_MOVE_TO) {
-						txtcontent += "t";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_FLEE) {
-						txtcontent += "e";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_LOOK_FOR) {
-						txtcontent += "o";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_HIDE) {
-						txtcontent += "i";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_WANDER_AROUND) {
-						txtcontent += "w";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_GUARD) {
-						txtcontent += "u";
-					}
-					if(entity->_npcdata->behavior & BEHAVIOUR_STARE_AT) {
-						txtcontent += "a";
-					}
-				}
-				return TYPE_TEXT;
-			}
-			
-			break;
+		if(entity->_npcdata->behavior & BEHAVIOUR_SNEAK) {
+			txtcontent += "s";
 		}
-		
-		case 's': {
-			
-			if(boost::starts_with(name, "^sender")) {
-				if(!EVENT_SENDER) {
-					txtcontent = "none";
-				} else if(EVENT_SENDER == entities.player()) {
-					txtcontent = "player";
-				} else {
-					txtcontent = EVENT_SENDER->idString();
-				}
-				return TYPE_TEXT;
-			}
-			
-			if(boost::starts_with(name, "^scale")) {
-				*fcontent = (entity) ? entity->scale * 100.f : 0.f;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^speaking")) {
-				if(entity) {
-					for(size_t i = 0; i < MAX_ASPEECH; i++) {
-						if(aspeech[i].exist && entity == aspeech[i].io) {
-							*lcontent = 1;
-							return TYPE_LONG;
-						}
-					}
-				}
-				*lcontent = 0;
-				return TYPE_LONG;
-			}
-			
-			break;
+		if(entity->_npcdata->behavior & BEHAVIOUR_DISTANT) {
+			txtcontent += "d";
 		}
-		
-		case 'm': {
-			
-			if(boost::starts_with(name, "^me")) {
-				if(!entity) {
-					txtcontent = "none";
-				} else if(entity == entities.player()) {
-					txtcontent = "player";
-				} else {
-					txtcontent = entity->idString();
-				}
-				return TYPE_TEXT;
-			}
-			
-			if(boost::starts_with(name, "^maxlife")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_NPC)) {
-					*fcontent = entity->_npcdata->lifePool.max;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^mana")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_NPC)) {
-					*fcontent = entity->_npcdata->manaPool.current;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^maxmana")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_NPC)) {
-					*fcontent = entity->_npcdata->manaPool.max;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^myspell_")) {
-				SpellType id = GetSpellId(name.substr(9));
-				if(id != SPELL_NONE) {
-					if(spells.ExistAnyInstanceForThisCaster(id, entity->index())) {
-						*lcontent = 1;
-						return TYPE_LONG;
-					}
-				}
-				*lcontent = 0;
+		if(entity->_npcdata->behavior & BEHAVIOUR_MAGIC) {
+			txtcontent += "m";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_FIGHT) {
+			txtcontent += "f";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_GO_HOME) {
+			txtcontent += "h";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_FRIENDLY) {
+			txtcontent += "r";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_MOVE_TO) {
+			txtcontent += "t";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_FLEE) {
+			txtcontent += "e";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_LOOK_FOR) {
+			txtcontent += "o";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_HIDE) {
+			txtcontent += "i";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_WANDER_AROUND) {
+			txtcontent += "w";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_GUARD) {
+			txtcontent += "u";
+		}
+		if(entity->_npcdata->behavior & BEHAVIOUR_STARE_AT) {
+			txtcontent += "a";
+		}
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getSender(const EERIE_SCRIPT *, Entity *, const std::string &,
+                           std::string & txtcontent, float *, long *) {
+	
+	if(!EVENT_SENDER) {
+		txtcontent = "none";
+	} else if(EVENT_SENDER == entities.player()) {
+		txtcontent = "player";
+	} else {
+		txtcontent = EVENT_SENDER->idString();
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getScale(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                          std::string &, float * fcontent, long *) {
+	
+	*fcontent = (entity) ? entity->scale * 100.f : 0.f;
+	return TYPE_FLOAT;
+}
+
+static ValueType getSpeaking(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                             std::string &, float *, long * lcontent) {
+	
+	if(entity) {
+		for(size_t i = 0; i < MAX_ASPEECH; i++) {
+			if(aspeech[i].exist && entity == aspeech[i].io) {
+				*lcontent = 1;
 				return TYPE_LONG;
 			}
-			
-			if(boost::starts_with(name, "^maxdurability")) {
-				*fcontent = (entity) ? entity->max_durability : 0.f;
-				return TYPE_FLOAT;
-			}
-			
-			break;
 		}
-		
-		case 'l': {
-			
-			if(boost::starts_with(name, "^life")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_NPC)) {
-					*fcontent = entity->_npcdata->lifePool.current;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^last_spawned")) {
-				txtcontent = (LASTSPAWNED) ? LASTSPAWNED->idString() : "none";
-				return TYPE_TEXT;
-			}
-			
-			break;
+	}
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getMe(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                       std::string & txtcontent, float *, long *) {
+	
+	if(!entity) {
+		txtcontent = "none";
+	} else if(entity == entities.player()) {
+		txtcontent = "player";
+	} else {
+		txtcontent = entity->idString();
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getMaxLife(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                            std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_NPC)) {
+		*fcontent = entity->_npcdata->lifePool.max;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getMana(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                         std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_NPC)) {
+		*fcontent = entity->_npcdata->manaPool.current;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getMaxMana(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                            std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_NPC)) {
+		*fcontent = entity->_npcdata->manaPool.max;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getMySpell(const EERIE_SCRIPT *, Entity * entity, const std::string & name,
+                            std::string &, float *, long * lcontent) {
+	
+	SpellType id = GetSpellId(name.substr(9));
+	if(id != SPELL_NONE) {
+		if(spells.ExistAnyInstanceForThisCaster(id, entity->index())) {
+			*lcontent = 1;
+			return TYPE_LONG;
 		}
+	}
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getMaxDurability(const EERIE_SCRIPT *, Entity * entity,
+                                  const std::string &, std::string &, float * fcontent,
+                                  long *) {
+	
+	*fcontent = (entity) ? entity->max_durability : 0.f;
+	return TYPE_FLOAT;
+}
+
+static ValueType getLife(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                         std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_NPC)) {
+		*fcontent = entity->_npcdata->lifePool.current;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getLastSpawned(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                std::string & txtcontent, float *, long *) {
+	
+	txtcontent = (LASTSPAWNED) ? LASTSPAWNED->idString() : "none";
+	return TYPE_TEXT;
+}
+
+static ValueType getDist(const EERIE_SCRIPT *, Entity * entity, const std::string & name,
+                         std::string &, float * fcontent, long * lcontent) {
+	
+	if(entity) {
+		const char * obj = name.c_str() + 6;
 		
-		case 'd': {
-			
-			if(boost::starts_with(name, "^dist_")) {
-				if(entity) {
-					const char * obj = name.c_str() + 6;
-					
-					if(!strcmp(obj, "player")) {
-						*fcontent = fdist(player.pos, entity->pos);
-						return TYPE_FLOAT;
-					}
-					
-					EntityHandle t = entities.getById(obj);
-					if(ValidIONum(t)) {
-						if((entity->show == SHOW_FLAG_IN_SCENE
-						    || entity->show == SHOW_FLAG_IN_INVENTORY)
-						   && (entities[t]->show == SHOW_FLAG_IN_SCENE
-						       || entities[t]->show == SHOW_FLAG_IN_INVENTORY)) {
-							Vec3f pos  = GetItemWorldPosition(entity);
-							Vec3f pos2 = GetItemWorldPosition(entities[t]);
-							*fcontent = fdist(pos, pos2);
-							return TYPE_FLOAT;
-						}
-					}
-					
-					*fcontent = 99999999999.f;
-					return TYPE_FLOAT;
-				}
-			}
-			
-			if(boost::starts_with(name, "^demo")) {
-				*lcontent = (resources->getReleaseType() & PakReader::Demo) ? 1 : 0;
-				return TYPE_LONG;
-			}
-			
-			if(boost::starts_with(name, "^durability")) {
-				*fcontent = (entity) ? entity->durability : 0.f;
-				return TYPE_FLOAT;
-			}
-			
-			break;
+		if(!strcmp(obj, "player")) {
+			*fcontent = fdist(player.pos, entity->pos);
+			return TYPE_FLOAT;
 		}
 		
-		case 'p': {
-			
-			if(boost::starts_with(name, "^price")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_ITEM)) {
-					*fcontent = static_cast<float>(entity->_itemdata->price);
-				}
+		EntityHandle t = entities.getById(obj);
+		if(ValidIONum(t)) {
+			if((entity->show == SHOW_FLAG_IN_SCENE
+			    || entity->show == SHOW_FLAG_IN_INVENTORY)
+			   && (entities[t]->show == SHOW_FLAG_IN_SCENE
+			       || entities[t]->show == SHOW_FLAG_IN_INVENTORY)) {
+				Vec3f pos  = GetItemWorldPosition(entity);
+				Vec3f pos2 = GetItemWorldPosition(entities[t]);
+				*fcontent = fdist(pos, pos2);
 				return TYPE_FLOAT;
 			}
-			
-			if(boost::starts_with(name, "^player_zone")) {
-				txtcontent = (player.inzone) ? player.inzone->name : "none";
-				return TYPE_TEXT;
-			}
-			
-			if(boost::starts_with(name, "^player_life")) {
-				*fcontent = player.Full_life; // TODO why not player.life like everywhere else?
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^poisoned")) {
-				*fcontent = 0;
-				if(entity && (entity->ioflags & IO_NPC)) {
-					*fcontent = entity->_npcdata->poisonned;
-				}
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^poisonous")) {
-				*fcontent = (entity) ? entity->poisonous : 0.f;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^possess_")) {
-				EntityHandle t = entities.getById(name.substr(9));
-				if(ValidIONum(t)) {
-					if(IsInPlayerInventory(entities[t])) {
-						*lcontent = 1;
-						return TYPE_LONG;
-					}
-					for(long i = 0; i < MAX_EQUIPED; i++) {
-						if(player.equiped[i] == t) {
-							*lcontent = 2;
-							return TYPE_LONG;
-						}
-					}
-				}
-				*lcontent = 0;
-				return TYPE_LONG;
-			}
-			
-			if(boost::starts_with(name, "^player_gold")) {
-				*fcontent = static_cast<float>(player.gold);
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_maxlife")) {
-				*fcontent = player.Full_maxlife;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_attribute_strength")) {
-				*fcontent = player.m_attributeFull.strength;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_attribute_dexterity")) {
-				*fcontent = player.m_attributeFull.dexterity;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_attribute_constitution")) {
-				*fcontent = player.m_attributeFull.constitution;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_attribute_mind")) {
-				*fcontent = player.m_attributeFull.mind;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_stealth")) {
-				*fcontent = player.m_skillFull.stealth;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_mecanism")) {
-				*fcontent = player.m_skillFull.mecanism;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_intuition")) {
-				*fcontent = player.m_skillFull.intuition;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_etheral_link")) {
-				*fcontent = player.m_skillFull.etheralLink;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_object_knowledge")) {
-				*fcontent = player.m_skillFull.objectKnowledge;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_casting")) {
-				*fcontent = player.m_skillFull.casting;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_projectile")) {
-				*fcontent = player.m_skillFull.projectile;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_close_combat")) {
-				*fcontent = player.m_skillFull.closeCombat;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_skill_defense")) {
-				*fcontent = player.m_skillFull.defense;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_hunger")) {
-				*fcontent = player.hunger;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^player_poison")) {
-				*fcontent = player.poison;
-				return TYPE_FLOAT;
-			}
-			
-			if(boost::starts_with(name, "^playercasting")) {
-				for(size_t i = 0; i < MAX_SPELLS; i++) {
-					const SpellBase * spell = spells[SpellHandle(i)];
-					
-					if(spell && spell->m_caster == PlayerEntityHandle) {
-						if(   spell->m_type == SPELL_LIFE_DRAIN
-						   || spell->m_type == SPELL_HARM
-						   || spell->m_type == SPELL_FIRE_FIELD
-						   || spell->m_type == SPELL_ICE_FIELD
-						   || spell->m_type == SPELL_LIGHTNING_STRIKE
-						   || spell->m_type == SPELL_MASS_LIGHTNING_STRIKE
-						) {
-							*lcontent = 1;
-							return TYPE_LONG;
-						}
-					}
-				}
-				*lcontent = 0;
-				return TYPE_LONG;
-			}
-			
-			if(boost::starts_with(name, "^playerspell_")) {
-				std::string temp = name.substr(13);
-				
-				SpellType id = GetSpellId(temp);
-				if(id != SPELL_NONE) {
-					if(spells.ExistAnyInstanceForThisCaster(id, PlayerEntityHandle)) {
-						*lcontent = 1;
-						return TYPE_LONG;
-					}
-				}
-				
-				if(temp == "invisibility" && entities.player()->invisibility > 0.3f) {
-					*lcontent = 1;
-					return TYPE_LONG;
-				}
-				
-				*lcontent = 0;
-				return TYPE_LONG;
-			}
-			
-			break;
 		}
 		
-		case 'n': {
-			
-			if(boost::starts_with(name, "^npcinsight")) {
-				Entity * ioo = ARX_NPC_GetFirstNPCInSight(entity);
-				if(!ioo) {
-					txtcontent = "none";
-				} else if(ioo == entities.player()) {
-					txtcontent = "player";
-				} else {
-					txtcontent = ioo->idString();
-				}
-				return TYPE_TEXT;
-			}
-			
-			break;
+		*fcontent = 99999999999.f;
+		return TYPE_FLOAT;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getDemo(const EERIE_SCRIPT *, Entity *, const std::string &, std::string &,
+                         float *, long * lcontent) {
+	
+	*lcontent = (resources->getReleaseType() & PakReader::Demo) ? 1 : 0;
+	return TYPE_LONG;
+}
+
+static ValueType getDurability(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                               std::string &, float * fcontent, long *) {
+	
+	*fcontent = (entity) ? entity->durability : 0.f;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPrice(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                          std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_ITEM)) {
+		*fcontent = static_cast<float>(entity->_itemdata->price);
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerZone(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string & txtcontent, float *, long *) {
+	
+	txtcontent = (player.inzone) ? player.inzone->name : "none";
+	return TYPE_TEXT;
+}
+
+static ValueType getPlayerLife(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.Full_life; // TODO why not player.life like everywhere else?
+	return TYPE_FLOAT;
+}
+
+static ValueType getPoisoned(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                             std::string &, float * fcontent, long *) {
+	
+	*fcontent = 0;
+	if(entity && (entity->ioflags & IO_NPC)) {
+		*fcontent = entity->_npcdata->poisonned;
+	}
+	return TYPE_FLOAT;
+}
+
+static ValueType getPoisonous(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                              std::string &, float * fcontent, long *) {
+	
+	*fcontent = (entity) ? entity->poisonous : 0.f;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPossess(const EERIE_SCRIPT *, Entity *, const std::string & name,
+                            std::string &, float *, long * lcontent) {
+	
+	EntityHandle t = entities.getById(name.substr(9));
+	if(ValidIONum(t)) {
+		if(IsInPlayerInventory(entities[t])) {
+			*lcontent = 1;
+			return TYPE_LONG;
 		}
-		
-		case 't': {
-			
-			if(boost::starts_with(name, "^target")) {
-				if(!entity) {
-					txtcontent = "none";
-				} else if(entity->targetinfo == PlayerEntityHandle) {
-					txtcontent = "player";
-				} else if(!ValidIONum(entity->targetinfo)) {
-					txtcontent = "none";
-				} else {
-					txtcontent = entities[entity->targetinfo]->idString();
-				}
-				return TYPE_TEXT;
+		for(long i = 0; i < MAX_EQUIPED; i++) {
+			if(player.equiped[i] == t) {
+				*lcontent = 2;
+				return TYPE_LONG;
 			}
-			
-			break;
 		}
+	}
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getPlayerGold(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string &, float * fcontent, long *) {
+	
+	*fcontent = static_cast<float>(player.gold);
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerMaxLife(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                  std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.Full_maxlife;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerStrength(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                   std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_attributeFull.strength;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerDexterity(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                    std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_attributeFull.dexterity;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerConstitution(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                       std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_attributeFull.constitution;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerMind(const EERIE_SCRIPT *, Entity *, const std::string &,
+                               std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_attributeFull.mind;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerStealth(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                  std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.stealth;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerMecanism(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                   std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.mecanism;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerIntuition(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                    std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.intuition;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerEtheralLink(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                      std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.etheralLink;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerObjectKnowledge(const EERIE_SCRIPT *, Entity *,
+                                          const std::string &, std::string &,
+                                          float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.objectKnowledge;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerCasting(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                  std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.casting;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerProjectile(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                     std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.projectile;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerCloseCombat(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                      std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.closeCombat;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerDefense(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                  std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.m_skillFull.defense;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerHunger(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                 std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.hunger;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerPoison(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                 std::string &, float * fcontent, long *) {
+	
+	*fcontent = player.poison;
+	return TYPE_FLOAT;
+}
+
+static ValueType getPlayerCastingSpell(const EERIE_SCRIPT *, Entity *, const std::string &,
+                                       std::string &, float *, long * lcontent) {
+	
+	for(size_t i = 0; i < MAX_SPELLS; i++) {
+		const SpellBase * spell = spells[SpellHandle(i)];
 		
-		case 'f': {
-			
-			if(boost::starts_with(name, "^focal")) {
-				if(entity && (entity->ioflags & IO_CAMERA)) {
-					*fcontent = entity->_camdata->cam.focal;
-					return TYPE_FLOAT;
-				}
-			}
-			
-			if(boost::starts_with(name, "^fighting")) {
-				*lcontent = long(ARX_PLAYER_IsInFightMode());
+		if(spell && spell->m_caster == PlayerEntityHandle) {
+			if(   spell->m_type == SPELL_LIFE_DRAIN
+			   || spell->m_type == SPELL_HARM
+			   || spell->m_type == SPELL_FIRE_FIELD
+			   || spell->m_type == SPELL_ICE_FIELD
+			   || spell->m_type == SPELL_LIGHTNING_STRIKE
+			   || spell->m_type == SPELL_MASS_LIGHTNING_STRIKE
+			) {
+				*lcontent = 1;
 				return TYPE_LONG;
 			}
-			
-			break;
 		}
-		
+	}
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getPlayerSpell(const EERIE_SCRIPT *, Entity *, const std::string & name,
+                                std::string &, float *, long * lcontent) {
+	
+	std::string temp = name.substr(13);
+	
+	SpellType id = GetSpellId(temp);
+	if(id != SPELL_NONE) {
+		if(spells.ExistAnyInstanceForThisCaster(id, PlayerEntityHandle)) {
+			*lcontent = 1;
+			return TYPE_LONG;
+		}
+	}
+	
+	if(temp == "invisibility" && entities.player()->invisibility > 0.3f) {
+		*lcontent = 1;
+		return TYPE_LONG;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getNPCInSight(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                               std::string & txtcontent, float *, long *) {
+	
+	Entity * ioo = ARX_NPC_GetFirstNPCInSight(entity);
+	if(!ioo) {
+		txtcontent = "none";
+	} else if(ioo == entities.player()) {
+		txtcontent = "player";
+	} else {
+		txtcontent = ioo->idString();
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getTarget(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                           std::string & txtcontent, float *, long *) {
+	
+	if(!entity) {
+		txtcontent = "none";
+	} else if(entity->targetinfo == PlayerEntityHandle) {
+		txtcontent = "player";
+	} else if(!ValidIONum(entity->targetinfo)) {
+		txtcontent = "none";
+	} else {
+		txtcontent = entities[entity->targetinfo]->idString();
+	}
+	return TYPE_TEXT;
+}
+
+static ValueType getFocal(const EERIE_SCRIPT *, Entity * entity, const std::string &,
+                          std::string &, float * fcontent, long * lcontent) {
+	
+	if(entity && (entity->ioflags & IO_CAMERA)) {
+		*fcontent = entity->_camdata->cam.focal;
+		return TYPE_FLOAT;
+	}
+	
+	*lcontent = 0;
+	return TYPE_LONG;
+}
+
+static ValueType getFighting(const EERIE_SCRIPT *, Entity *, const std::string &,
+                             std::string &, float *, long * lcontent) {
+	
+	*lcontent = long(ARX_PLAYER_IsInFightMode());
+	return TYPE_LONG;
+}
+
+void setupSystemVariables() {
+	
+	registerSystemVariable("^$param1", getParam);
+	registerSystemVariable("^$param2", getParam);
+	registerSystemVariable("^$param3", getParam);
+	registerSystemVariable("^$objontop", getObjOnTop);
+	registerSystemVariable("^&param1", getParam);
+	registerSystemVariable("^&param2", getParam);
+	registerSystemVariable("^&param3", getParam);
+	registerSystemVariable("^&playerdist", getPlayerDistFloat);
+	registerSystemVariable("^#playerdist", getPlayerDistLong);
+	registerSystemVariable("^#param1", getParam);
+	registerSystemVariable("^#param2", getParam);
+	registerSystemVariable("^#param3", getParam);
+	registerSystemVariable("^#timer1", getTimer);
+	registerSystemVariable("^#timer2", getTimer);
+	registerSystemVariable("^#timer3", getTimer);
+	registerSystemVariable("^#timer4", getTimer);
+	registerSystemVariable("^gore", getGore);
+	registerSystemVariable("^gamedays", getGameDays);
+	registerSystemVariable("^gamehours", getGameHours);
+	registerSystemVariable("^gameminutes", getGameMinutes);
+	registerSystemVariable("^gameseconds", getGameSeconds);
+	registerSystemVariable("^amount", getAmount, true);
+	registerSystemVariable("^arxdays", getArxDays);
+	registerSystemVariable("^arxhours", getArxHours);
+	registerSystemVariable("^arxminutes", getArxMinutes);
+	registerSystemVariable("^arxseconds", getArxSeconds);
+	registerSystemVariable("^arxtime_hours", getArxTimeHours);
+	registerSystemVariable("^arxtime_minutes", getArxTimeMinutes);
+	registerSystemVariable("^arxtime_seconds", getArxTimeSeconds);
+	registerSystemVariable("^realdist_", getRealDist, true);
+	registerSystemVariable("^repairprice_", getRepairPrice, true);
+	registerSystemVariable("^rnd_", getRandom, true);
+	registerSystemVariable("^rune_", getRune, true);
+	registerSystemVariable("^inzone_", getInZone, true);
+	registerSystemVariable("^ininitpos", getInInitPos, true);
+	registerSystemVariable("^inplayerinventory", getInPlayerInventory, true);
+	registerSystemVariable("^behavior", getBehavior, true);
+	registerSystemVariable("^sender", getSender, true);
+	registerSystemVariable("^scale", getScale, true);
+	registerSystemVariable("^speaking", getSpeaking, true);
+	registerSystemVariable("^me", getMe, true);
+	registerSystemVariable("^maxlife", getMaxLife, true);
+	registerSystemVariable("^mana", getMana, true);
+	registerSystemVariable("^maxmana", getMaxMana, true);
+	registerSystemVariable("^myspell_", getMySpell, true);
+	registerSystemVariable("^maxdurability", getMaxDurability, true);
+	registerSystemVariable("^life", getLife, true);
+	registerSystemVariable("^last_spawned", getLastSpawned, true);
+	registerSystemVariable("^dist_", getDist, true);
+	registerSystemVariable("^demo", getDemo, true);
+	registerSystemVariable("^durability", getDurability, true);
+	registerSystemVariable("^price", getPrice, true);
+	registerSystemVariable("^player_zone", getPlayerZone, true);
+	registerSystemVariable("^player_life", getPlayerLife, true);
+	registerSystemVariable("^poisoned", getPoisoned, true);
+	registerSystemVariable("^poisonous", getPoisonous, true);
+	registerSystemVariable("^possess_", getPossess, true);
+	registerSystemVariable("^player_gold", getPlayerGold, true);
+	registerSystemVariable("^player_maxlife", getPlayerMaxLife, true);
+	registerSystemVariable("^player_attribute_strength", getPlayerStrength, true);
+	registerSystemVariable("^player_attribute_dexterity", getPlayerDexterity, true);
+	registerSystemVariable("^player_attribute_constitution", getPlayerConstitution, true);
+	registerSystemVariable("^player_attribute_mind", getPlayerMind, true);
+	registerSystemVariable("^player_skill_stealth", getPlayerStealth, true);
+	registerSystemVariable("^player_skill_mecanism", getPlayerMecanism, true);
+	registerSystemVariable("^player_skill_intuition", getPlayerIntuition, true);
+	registerSystemVariable("^player_skill_etheral_link", getPlayerEtheralLink, true);
+	registerSystemVariable("^player_skill_object_knowledge", getPlayerObjectKnowledge, true);
+	registerSystemVariable("^player_skill_casting", getPlayerCasting, true);
+	registerSystemVariable("^player_skill_projectile", getPlayerProjectile, true);
+	registerSystemVariable("^player_skill_close_combat", getPlayerCloseCombat, true);
+	registerSystemVariable("^player_skill_defense", getPlayerDefense, true);
+	registerSystemVariable("^player_hunger", getPlayerHunger, true);
+	registerSystemVariable("^player_poison", getPlayerPoison, true);
+	registerSystemVariable("^playercasting", getPlayerCastingSpell, true);
+	registerSystemVariable("^playerspell_", getPlayerSpell, true);
+	registerSystemVariable("^npcinsight", getNPCInSight, true);
+	registerSystemVariable("^target", getTarget, true);
+	registerSystemVariable("^focal", getFocal, true);
+	registerSystemVariable("^fighting", getFighting, true);
+	
+}
+
+ValueType getSystemVar(const EERIE_SCRIPT * es, Entity * entity, const std::string & name,
+                       std::string& txtcontent, float * fcontent,long * lcontent) {
+	
+	arx_assert(!name.empty() && name[0] == '^', "bad system variable: \"%s\"", name.c_str());
+	
+	SystemVariable handler = findSystemVariable(name);
+	if(handler) {
+		return handler(es, entity, name, txtcontent, fcontent, lcontent);
 	}
 	
 	*lcontent = 0;
@@ -1120,42 +1356,41 @@ void CloneLocalVars(Entity * ioo, Entity * io) {
 	ioo->script.lvar = io->script.lvar;
 }
 
-static SCRIPT_VAR * GetFreeVarSlot(SCRIPT_VARIABLES& _svff) {
-	_svff.resize(_svff.size() + 1);
-	SCRIPT_VAR * v = &_svff.back();
-	return v;
-}
-
-static SCRIPT_VAR * GetVarAddress(SCRIPT_VARIABLES & svf, const std::string & name) {
+SCRIPT_VAR & SCRIPT_VARIABLES::get(const std::string & name) {
 	
-	for(SCRIPT_VARIABLES::iterator it = svf.begin(); it != svf.end(); ++it) {
-		if(it->type != TYPE_UNKNOWN) {
-			if(name == it->name) {
-				return &(*it);
-			}
-		}
+	std::pair<Index::iterator, bool> res;
+	res = m_index.insert(std::make_pair(name, m_variables.size()));
+	if(!res.second) {
+		return m_variables[res.first->second];
 	}
-
-	return NULL;
+	
+	m_variables.resize(m_variables.size() + 1);
+	SCRIPT_VAR & var = m_variables.back();
+	var.name = name;
+	return var;
 }
 
-static const SCRIPT_VAR * GetVarAddress(const SCRIPT_VARIABLES & svf,
-                                        const std::string & name) {
+bool SCRIPT_VARIABLES::erase(const std::string & name) {
 	
-	for(SCRIPT_VARIABLES::const_iterator it = svf.begin(); it != svf.end(); ++it) {
-		if(it->type != TYPE_UNKNOWN) {
-			if(name == it->name) {
-				return &(*it);
-			}
-		}
+	Index::iterator it = m_index.find(name);
+	if(it == m_index.end() || m_variables[it->second].type == TYPE_UNKNOWN) {
+		return false;
 	}
-
-	return NULL;
+	
+	// Keep the remaining variables in order - unset is rare enough to afford the shift
+	size_t i = it->second;
+	m_index.erase(it);
+	m_variables.erase(m_variables.begin() + i);
+	for(; i < m_variables.size(); i++) {
+		m_index[m_variables[i].name] = i;
+	}
+	
+	return true;
 }
 
 long GETVarValueLong(const SCRIPT_VARIABLES& svf, const std::string & name) {
 	
-	const SCRIPT_VAR * tsv = GetVarAddress(svf, name);
+	const SCRIPT_VAR * tsv = svf.find(name);
 
 	if (tsv == NULL) return 0;
 
@@ -1164,7 +1399,7 @@ long GETVarValueLong(const SCRIPT_VARIABLES& svf, const std::string & name) {
 
 float GETVarValueFloat(const SCRIPT_VARIABLES& svf, const std::string & name) {
 	
-	const SCRIPT_VAR * tsv = GetVarAddress(svf, name);
+	const SCRIPT_VAR * tsv = svf.find(name);
 
 	if (tsv == NULL) return 0;
 
@@ -1173,7 +1408,7 @@ float GETVarValueFloat(const SCRIPT_VARIABLES& svf, const std::string & name) {
 
 std::string GETVarValueText(const SCRIPT_VARIABLES& svf, const std::string & name) {
 	
-	const SCRIPT_VAR* tsv = GetVarAddress(svf, name);
+	const SCRIPT_VAR* tsv = svf.find(name);
 
 	if (!tsv) return "";
 
@@ -1225,14 +1460,14 @@ std::string GetVarValueInterpretedAsText(const std::string & temp1, const EERIE_
 		else if (temp1[0] == '@') t1 = GETVarValueFloat(esss->lvar, temp1);
 		else if (temp1[0] == '$')
 		{
-			const SCRIPT_VAR * var = GetVarAddress(svar, temp1);
+			const SCRIPT_VAR * var = svar.find(temp1);
 
 			if (!var) return "void";
 			else return var->text;
 		}
 		else if (temp1[0] == '\xA3')
 		{
-			const SCRIPT_VAR * var = GetVarAddress(esss->lvar, temp1);
+			const SCRIPT_VAR * var = esss->lvar.find(temp1);
 
 			if (!var) return "void";
 			else return var->text;
@@ -1280,17 +1515,7 @@ float GetVarValueInterpretedAsFloat(const std::string & temp1, const EERIE_SCRIP
 
 SCRIPT_VAR* SETVarValueLong(SCRIPT_VARIABLES& svf, const std::string& name, long val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name;
-	}
+	SCRIPT_VAR* tsv = &svf.get(name);
 
 	tsv->ival = val;
 	return tsv;
@@ -1298,17 +1523,7 @@ SCRIPT_VAR* SETVarValueLong(SCRIPT_VARIABLES& svf, const std::string& name, long
 
 SCRIPT_VAR* SETVarValueFloat(SCRIPT_VARIABLES& svf, const std::string& name, float val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name;
-	}
+	SCRIPT_VAR* tsv = &svf.get(name);
 
 	tsv->fval = val;
 	return tsv;
@@ -1316,17 +1531,7 @@ SCRIPT_VAR* SETVarValueFloat(SCRIPT_VARIABLES& svf, const std::string& name, flo
 
 SCRIPT_VAR* SETVarValueText(SCRIPT_VARIABLES& svf, const std::string& name, const std::string& val)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, name);
-
-	if (!tsv)
-	{
-		tsv = GetFreeVarSlot(svf);
-
-		if (!tsv)
-			return NULL;
-
-		tsv->name = name.c_str();
-	}
+	SCRIPT_VAR* tsv = &svf.get(name);
 	
 	tsv->text = val;
 	
@@ -1657,18 +1862,72 @@ ScriptResult SendInitScriptEvent(Entity * io) {
 	return ACCEPT;
 }
 
-//! Checks if timer named texx exists.
-static bool ARX_SCRIPT_Timer_Exist(const std::string & texx) {
+namespace {
+
+//! A scheduled run of a script timer, only valid if the generation still matches
+struct ScheduledTimer {
 	
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist) {
-			if(scr_timer[i].name == texx) {
-				return true;
-			}
-		}
+	unsigned long time;
+	long index;
+	u32 generation;
+	
+	ScheduledTimer(unsigned long time, long index, u32 generation)
+		: time(time), index(index), generation(generation) { }
+	
+	// Reversed so that the heap returns the earliest time first
+	bool operator<(const ScheduledTimer & other) const {
+		return time > other.time;
+	}
+	
+};
+
+} // anonymous namespace
+
+typedef boost::unordered_multiset<std::string> TimerNames;
+typedef boost::unordered_multimap<Entity *, long> TimersByEntity;
+
+static std::vector<u32> timerGenerations;
+static std::vector<long> freeTimers;
+static std::vector<ScheduledTimer> timerQueue;
+static std::vector<ScheduledTimer> newTimers; // Fire time is not known yet
+static TimerNames timerNames;
+static TimersByEntity timersByEntity;
+
+//! Queue a timer for its next run
+static void scheduleTimer(long index, u32 generation) {
+	
+	if(!scr_timer[index].exist || timerGenerations[index] != generation) {
+		return;
+	}
+	
+	const SCR_TIMER & st = scr_timer[index];
+	timerQueue.push_back(ScheduledTimer(st.tim + st.msecs, index, generation));
+	std::push_heap(timerQueue.begin(), timerQueue.end());
+}
+
+static void scheduleTimers(std::vector<ScheduledTimer> & timers) {
+	
+	for(size_t i = 0; i < timers.size(); i++) {
+		scheduleTimer(timers[i].index, timers[i].generation);
 	}
 	
-	return false;
+	timers.clear();
+}
+
+//! Get the timers of an entity, the list is valid until timers are added or removed
+static void getTimersForIO(Entity * io, std::vector<long> & result) {
+	
+	std::pair<TimersByEntity::const_iterator, TimersByEntity::const_iterator> range;
+	range = timersByEntity.equal_range(io);
+	
+	for(TimersByEntity::const_iterator it = range.first; it != range.second; ++it) {
+		result.push_back(it->second);
+	}
+}
+
+//! Checks if timer named texx exists.
+static bool ARX_SCRIPT_Timer_Exist(const std::string & texx) {
+	return timerNames.find(texx) != timerNames.end();
 }
 
 std::string ARX_SCRIPT_Timer_GetDefaultName() {
@@ -1684,17 +1943,48 @@ std::string ARX_SCRIPT_Timer_GetDefaultName() {
 	}
 }
 
-//*************************************************************************************
-// Get a free script timer
-//*************************************************************************************
-long ARX_SCRIPT_Timer_GetFree() {
+SCR_TIMER * createScriptTimer(Entity * io, const std::string & name) {
+	
+	if(freeTimers.empty()) {
+		return NULL;
+	}
+	
+	long index = freeTimers.back();
+	freeTimers.pop_back();
+	
+	SCR_TIMER & st = scr_timer[index];
+	arx_assert(!st.exist);
+	
+	st.reset();
+	st.exist = 1;
+	st.io = io;
+	st.name = name;
+	st.tim = (unsigned long)(arxtime);
+	
+	ActiveTimers++;
+	timerNames.insert(name);
+	timersByEntity.insert(std::make_pair(io, index));
+	newTimers.push_back(ScheduledTimer(0, index, timerGenerations[index]));
+	
+	return &st;
+}
+
+void ARX_SCRIPT_Timer_SetStartTime(unsigned long time) {
 	
 	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(!(scr_timer[i].exist))
-			return i;
+		if(scr_timer[i].exist) {
+			scr_timer[i].tim = time;
+		}
 	}
 	
-	return -1;
+	// Re-schedule all timers, including the ones that are already waiting
+	timerQueue.clear();
+	newTimers.clear();
+	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
+		if(scr_timer[i].exist) {
+			newTimers.push_back(ScheduledTimer(0, i, timerGenerations[i]));
+		}
+	}
 }
 
 //*************************************************************************************
@@ -1709,30 +1999,54 @@ long ARX_SCRIPT_CountTimers() {
 // Clears a timer by its Index (long timer_idx) on the timers list
 //*************************************************************************************
 void ARX_SCRIPT_Timer_ClearByNum(long timer_idx) {
-	if(scr_timer[timer_idx].exist) {
-		LogDebug("clearing timer " << scr_timer[timer_idx].name);
-		scr_timer[timer_idx].name.clear();
-		ActiveTimers--;
-		scr_timer[timer_idx].exist = 0;
+	
+	SCR_TIMER & st = scr_timer[timer_idx];
+	if(!st.exist) {
+		return;
+	}
+	
+	LogDebug("clearing timer " << st.name);
+	
+	timerNames.erase(timerNames.find(st.name));
+	
+	std::pair<TimersByEntity::iterator, TimersByEntity::iterator> range;
+	range = timersByEntity.equal_range(st.io);
+	for(TimersByEntity::iterator it = range.first; it != range.second; ++it) {
+		if(it->second == timer_idx) {
+			timersByEntity.erase(it);
+			break;
+		}
 	}
+	
+	// Invalidates all scheduled runs of this timer
+	timerGenerations[timer_idx]++;
+	freeTimers.push_back(timer_idx);
+	
+	st.name.clear();
+	ActiveTimers--;
+	st.exist = 0;
 }
 
 void ARX_SCRIPT_Timer_Clear_By_Name_And_IO(const std::string & timername, Entity * io) {
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist && scr_timer[i].io == io && scr_timer[i].name == timername) {
-			ARX_SCRIPT_Timer_ClearByNum(i);
+	
+	std::vector<long> timers;
+	getTimersForIO(io, timers);
+	
+	for(size_t i = 0; i < timers.size(); i++) {
+		if(scr_timer[timers[i]].name == timername) {
+			ARX_SCRIPT_Timer_ClearByNum(timers[i]);
 		}
 	}
 }
 
-void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io)
-{
-	for (long i = 0; i < MAX_TIMER_SCRIPT; i++)
-	{
-		if (scr_timer[i].exist)
-		{
-			if ((scr_timer[i].io == io) && (scr_timer[i].es == &io->over_script))
-				ARX_SCRIPT_Timer_ClearByNum(i);
+void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io) {
+	
+	std::vector<long> timers;
+	getTimersForIO(io, timers);
+	
+	for(size_t i = 0; i < timers.size(); i++) {
+		if(scr_timer[timers[i]].es == &io->over_script) {
+			ARX_SCRIPT_Timer_ClearByNum(timers[i]);
 		}
 	}
 }
@@ -1750,6 +2064,16 @@ void ARX_SCRIPT_Timer_FirstInit(long number)
 	delete[] scr_timer;
 	scr_timer = new SCR_TIMER[MAX_TIMER_SCRIPT];
 	ActiveTimers = 0;
+	
+	timerGenerations.assign(MAX_TIMER_SCRIPT, 0);
+	freeTimers.clear();
+	for(long i = MAX_TIMER_SCRIPT - 1; i >= 0; i--) {
+		freeTimers.push_back(i);
+	}
+	timerQueue.clear();
+	newTimers.clear();
+	timerNames.clear();
+	timersByEntity.clear();
 }
 
 void ARX_SCRIPT_Timer_ClearAll()
@@ -1759,23 +2083,29 @@ void ARX_SCRIPT_Timer_ClearAll()
 			ARX_SCRIPT_Timer_ClearByNum(i);
 
 	ActiveTimers = 0;
+	
+	timerQueue.clear();
+	newTimers.clear();
 }
 
 void ARX_SCRIPT_Timer_Clear_For_IO(Entity * io) {
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-		if(scr_timer[i].exist && scr_timer[i].io == io) {
-			ARX_SCRIPT_Timer_ClearByNum(i);
-		}
+	
+	std::vector<long> timers;
+	getTimersForIO(io, timers);
+	
+	for(size_t i = 0; i < timers.size(); i++) {
+		ARX_SCRIPT_Timer_ClearByNum(timers[i]);
 	}
 }
 
 long ARX_SCRIPT_GetSystemIOScript(Entity * io, const std::string & name) {
 	
-	if(ActiveTimers) {
-		for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
-			if(scr_timer[i].exist && scr_timer[i].io == io && scr_timer[i].name == name) {
-				return i;
-			}
+	std::pair<TimersByEntity::const_iterator, TimersByEntity::const_iterator> range;
+	range = timersByEntity.equal_range(io);
+	
+	for(TimersByEntity::const_iterator it = range.first; it != range.second; ++it) {
+		if(scr_timer[it->second].name == name) {
+			return it->second;
 		}
 	}
 	
@@ -1830,24 +2160,40 @@ void ARX_SCRIPT_Timer_Check() {
 	
 	ARX_PROFILE_FUNC();
 	
+	scheduleTimers(newTimers);
+	
 	if(!ActiveTimers) {
+		timerQueue.clear();
 		return;
 	}
 	
-	for(long i = 0; i < MAX_TIMER_SCRIPT; i++) {
+	// Timers are re-scheduled after the loop so that each one runs at most once per frame
+	static std::vector<ScheduledTimer> ranTimers;
+	
+	unsigned long now = static_cast<unsigned long>(arxtime);
+	
+	while(!timerQueue.empty() && timerQueue.front().time <= now) {
 		
+		std::pop_heap(timerQueue.begin(), timerQueue.end());
+		ScheduledTimer run = timerQueue.back();
+		timerQueue.pop_back();
+		
+		long i = run.index;
 		SCR_TIMER * st = &scr_timer[i];
-		if(!st->exist) {
+		if(!st->exist || timerGenerations[i] != run.generation) {
+			// Timer has been removed
 			continue;
 		}
 		
-		unsigned long now = static_cast<unsigned long>(arxtime);
 		unsigned long fire_time = st->tim + st->msecs;
-		if(fire_time > now) {
-			// Timer not ready to fire yet
+		if(fire_time != run.time) {
+			// Timer has been modified
+			scheduleTimer(i, run.generation);
 			continue;
 		}
 		
+		ranTimers.push_back(run);
+		
 		// Skip heartbeat timer events for far away objects
 		if((st->flags & 1) && !(st->io->gameFlags & GFLAG_ISINTREATZONE)) {
 			long increment = (now - st->tim) / st->msecs;
@@ -1888,6 +2234,8 @@ void ARX_SCRIPT_Timer_Check() {
 		}
 		
 	}
+	
+	scheduleTimers(ranTimers);
 }
 
 void ARX_SCRIPT_Init_Event_Stats() {
@@ -2038,6 +2386,9 @@ void loadScript(EERIE_SCRIPT & script, PakFile * file) {
 		script.timers[j] = 0;
 	}
 	
+	computeOffsets(script);
+	script::tokenize(script);
+	
 	ARX_SCRIPT_ComputeShortcuts(script);
 	
 }
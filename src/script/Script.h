@@ -52,6 +52,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <string>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
 #include "platform/Flags.h"
 
 class PakFile;
@@ -108,7 +110,82 @@ enum DisabledEvent {
 DECLARE_FLAGS(DisabledEvent, DisabledEvents)
 DECLARE_FLAGS_OPERATORS(DisabledEvents)
 
-typedef std::vector<SCRIPT_VAR> SCRIPT_VARIABLES;
+/*!
+ * Script variables, indexed by name.
+ *
+ * Variables are kept in insertion order for saving and debug output, lookups by name
+ * go through a hash index. Variables with type \ref TYPE_UNKNOWN are not returned
+ * by find().
+ */
+class SCRIPT_VARIABLES {
+	
+	typedef std::vector<SCRIPT_VAR> Variables;
+	typedef boost::unordered_map<std::string, size_t> Index;
+	
+	Variables m_variables;
+	Index m_index;
+	
+public:
+	
+	typedef Variables::const_iterator const_iterator;
+	
+	const_iterator begin() const { return m_variables.begin(); }
+	const_iterator end() const { return m_variables.end(); }
+	size_t size() const { return m_variables.size(); }
+	bool empty() const { return m_variables.empty(); }
+	const SCRIPT_VAR & operator[](size_t i) const { return m_variables[i]; }
+	
+	//! \return the variable with the given name or NULL if it does not exist
+	SCRIPT_VAR * find(const std::string & name) {
+		Index::const_iterator it = m_index.find(name);
+		if(it == m_index.end() || m_variables[it->second].type == TYPE_UNKNOWN) {
+			return NULL;
+		}
+		return &m_variables[it->second];
+	}
+	const SCRIPT_VAR * find(const std::string & name) const {
+		return const_cast<SCRIPT_VARIABLES *>(this)->find(name);
+	}
+	
+	/*!
+	 * Get the variable with the given name, adding it if it does not exist yet
+	 *
+	 * The returned reference is only valid until the next variable is added or removed.
+	 */
+	SCRIPT_VAR & get(const std::string & name);
+	
+	//! Remove the variable with the given name, \return false if it does not exist
+	bool erase(const std::string & name);
+	
+	void clear() {
+		m_variables.clear();
+		m_index.clear();
+	}
+	
+};
+
+namespace script {
+
+class Command;
+
+/*!
+ * A word in a script that can be read without expanding variables or comments.
+ *
+ * Tokens are found once when the script is loaded so that the interpreter does not
+ * need to re-scan and look up the same words each time they are executed.
+ */
+struct Token {
+	u32 start;         //!< Position of the first character
+	u32 end;           //!< Position after the last character
+	Command * command; //!< Command with this name (ignoring underscores) or NULL
+	float value;       //!< Numeric value of the word, only valid if literal is true
+	bool literal;      //!< The word is not a variable name
+};
+
+} // namespace script
+
+//! Positions of event handlers ("on event") and labels (">>label") in a script
+typedef boost::unordered_map<std::string, long> SCRIPT_OFFSETS;
 
 struct EERIE_SCRIPT {
 	size_t size;
@@ -121,6 +198,8 @@ struct EERIE_SCRIPT {
 	long shortcut[MAX_SHORTCUT];
 	long nb_labels;
 	LABEL_INFO * labels;
+	SCRIPT_OFFSETS offsets;
+	std::vector<script::Token> tokens; // sorted by position
 
 	EERIE_SCRIPT() : size(), data(), lastcall(), allowevents(), master(), nb_labels(), labels() {
 		memset(&timers, 0, sizeof(timers));
@@ -427,7 +506,19 @@ void ARX_SCRIPT_Timer_Check();
 void ARX_SCRIPT_Timer_FirstInit(long number);
 void ARX_SCRIPT_Timer_ClearAll();
 void ARX_SCRIPT_Timer_Clear_For_IO(Entity * io);
-long ARX_SCRIPT_Timer_GetFree();
+
+/*!
+ * Add a new script timer
+ *
+ * The timer starts at the current time. The caller must set the remaining fields
+ * before the next call to \ref ARX_SCRIPT_Timer_Check().
+ *
+ * \return the new timer or NULL if there are no free timer slots.
+ */
+SCR_TIMER * createScriptTimer(Entity * io, const std::string & name);
+
+//! Restart all existing timers at the given time
+void ARX_SCRIPT_Timer_SetStartTime(unsigned long time);
  
 void ARX_SCRIPT_SetMainEvent(Entity * io, const std::string & newevent);
 void ARX_SCRIPT_EventStackExecute(size_t limit = 20);
@@ -469,6 +560,26 @@ long GETVarValueLong(const SCRIPT_VARIABLES& svf, const std::string & name);
 float GETVarValueFloat(const SCRIPT_VARIABLES& svf, const std::string & name);
 std::string GETVarValueText(const SCRIPT_VARIABLES& svf, const std::string & name);
 
+/*!
+ * Handler for a system variable (^name)
+ *
+ * Sets txtcontent, fcontent or lcontent depending on the returned type.
+ */
+typedef ValueType (*SystemVariable)(const EERIE_SCRIPT * es, Entity * io,
+                                    const std::string & name, std::string & txtcontent,
+                                    float * fcontent, long * lcontent);
+
+/*!
+ * Register a system variable
+ *
+ * \param name   the variable name, including the '^'
+ * \param prefix if true, the handler is also used for all variables starting with name
+ */
+void registerSystemVariable(const std::string & name, SystemVariable handler,
+                            bool prefix = false);
+
+void setupSystemVariables();
+
 ValueType getSystemVar(const EERIE_SCRIPT * es, Entity * io, const std::string & name, std::string & txtcontent, float * fcontent, long * lcontent);
 void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io);
 void ARX_SCRIPT_Timer_Clear_By_Name_And_IO(const std::string & timername, Entity * io);
@@ -483,6 +594,8 @@ void Stack_SendIOScriptEvent(Entity * io, ScriptMessage msg, const std::string &
  * Finds the first occurence of str in the script that is followed
  * by a separator (a character of value less then or equal 32)
  * 
+ * Event handlers and labels are looked up in the offsets computed by loadScript().
+ *
  * \return The position of str in the script or -1 if str was not found.
  */
 long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str);
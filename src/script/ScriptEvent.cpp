@@ -377,36 +377,44 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 	
 	for(;;) {
 		
-		std::string word = context.getCommand(msg != SM_EXECUTELINE);
-		if(word.empty()) {
-			if(msg == SM_EXECUTELINE && context.pos != es->size) {
-				arx_assert(es->data[context.pos] == '\n');
-				LogDebug("<-- line end");
+		std::string word;
+		
+		// Most commands have already been looked up when the script was loaded
+		script::Command * known = context.getKnownCommand(msg != SM_EXECUTELINE);
+		if(!known) {
+			
+			word = context.getCommand(msg != SM_EXECUTELINE);
+			if(word.empty()) {
+				if(msg == SM_EXECUTELINE && context.pos != es->size) {
+					arx_assert(es->data[context.pos] == '\n');
+					LogDebug("<-- line end");
+					return ACCEPT;
+				}
+				ScriptEventWarning << "<-- reached script end without accept / refuse / return";
 				return ACCEPT;
 			}
-			ScriptEventWarning << "<-- reached script end without accept / refuse / return";
-			return ACCEPT;
+			
+			// Remove all underscores from the command.
+			word.resize(std::remove(word.begin(), word.end(), '_') - word.begin());
+			
+			known = findCommand(word);
 		}
 		
-		// Remove all underscores from the command.
-		word.resize(std::remove(word.begin(), word.end(), '_') - word.begin());
-		
-		Commands::const_iterator it = commands.find(word);
-		
-		if(it != commands.end()) {
+		if(known) {
 			
-			script::Command & command = *(it->second);
+			script::Command & command = *known;
 			
 			script::Command::Result res;
 			if(command.getEntityFlags()
 			   && (!io || (command.getEntityFlags() != script::Command::AnyEntity
 			               && !(command.getEntityFlags() & long(io->ioflags))))) {
+				word = command.getName();
 				ScriptEventWarning << "command " << command.getName() << " needs an IO of type "
 				                   << command.getEntityFlags();
 				context.skipCommand();
 				res = script::Command::Failed;
 			} else {
-				res = it->second->execute(context);
+				res = command.execute(context);
 			}
 			
 			if(res == script::Command::AbortAccept) {
@@ -476,10 +484,19 @@ void ScriptEvent::registerCommand(script::Command * command) {
 	
 }
 
+script::Command * ScriptEvent::findCommand(const std::string & name) {
+	
+	Commands::const_iterator it = commands.find(name);
+	
+	return (it != commands.end()) ? it->second : NULL;
+}
+
 void ScriptEvent::init() {
 	
 	size_t count = script::initSuppressions();
 	
+	setupSystemVariables();
+	
 	script::setupScriptedAnimation();
 	script::setupScriptedCamera();
 	script::setupScriptedControl();
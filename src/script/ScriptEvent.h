@@ -53,6 +53,9 @@ public:
 	
 	static void registerCommand(script::Command * command);
 	
+	//! \return the command with the given name (without underscores) or NULL
+	static script::Command * findCommand(const std::string & name);
+	
 	static void init();
 	
 private:
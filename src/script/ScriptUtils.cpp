@@ -19,6 +19,9 @@
 
 #include "script/ScriptUtils.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include <set>
 
 #include "game/Entity.h"
@@ -30,6 +33,66 @@ static inline bool isWhitespace(char c) {
 	return (((unsigned char)c) <= 32 || c == '(' || c == ')');
 }
 
+void tokenize(EERIE_SCRIPT & es) {
+	
+	std::vector<Token> tokens;
+	
+	const char * data = es.data;
+	size_t size = std::min(es.size, size_t(std::numeric_limits<u32>::max()));
+	
+	std::string word;
+	
+	for(size_t pos = 0; pos != size;) {
+		
+		if(isWhitespace(data[pos])) {
+			pos++;
+			continue;
+		}
+		
+		// Words with quotes, variables or comments are left to getWord() and getCommand()
+		size_t start = pos;
+		bool simple = true;
+		for(; pos != size && !isWhitespace(data[pos]); pos++) {
+			char c = data[pos];
+			if(c == '"' || c == '~' || (c == '/' && pos + 1 != size && data[pos + 1] == '/')) {
+				simple = false;
+			}
+		}
+		if(!simple) {
+			continue;
+		}
+		
+		word.assign(data + start, data + pos);
+		
+		Token token;
+		token.start = u32(start);
+		token.end = u32(pos);
+		token.literal = (word[0] != '^' && word[0] != '#' && word[0] != '\xA7'
+		                 && word[0] != '&' && word[0] != '@');
+		token.value = token.literal ? float(atof(word.c_str())) : 0.f;
+		word.resize(std::remove(word.begin(), word.end(), '_') - word.begin());
+		token.command = ScriptEvent::findCommand(word);
+		
+		tokens.push_back(token);
+	}
+	
+	es.tokens.swap(tokens);
+}
+
+struct TokenPositionCompare {
+	bool operator()(const Token & token, size_t pos) const {
+		return token.start < pos;
+	}
+};
+
+const Token * findToken(const EERIE_SCRIPT & es, size_t pos) {
+	
+	std::vector<Token>::const_iterator it;
+	it = std::lower_bound(es.tokens.begin(), es.tokens.end(), pos, TokenPositionCompare());
+	
+	return (it != es.tokens.end() && it->start == pos) ? &*it : NULL;
+}
+
 std::string loadUnlocalized(const std::string & str) {
 	
 	// if the section name has the qualifying brackets "[]", cut them off
@@ -49,12 +112,31 @@ std::string Context::getStringVar(const std::string & var) const {
 
 #define ScriptParserWarning ARX_LOG(isSuppressed(*this, "?") ? Logger::Debug : Logger::Warning) << ScriptContextPrefix(*this) << ": "
 
+Command * Context::getKnownCommand(bool skipNewlines) {
+	
+	skipWhitespace(skipNewlines);
+	
+	const Token * token = findToken(*script, pos);
+	if(!token || !token->command) {
+		return NULL;
+	}
+	
+	pos = token->end;
+	return token->command;
+}
+
 std::string Context::getCommand(bool skipNewlines) {
 	
 	const char * esdat = script->data;
 	
 	skipWhitespace(skipNewlines);
 	
+	const Token * token = findToken(*script, pos);
+	if(token) {
+		pos = token->end;
+		return std::string(esdat + token->start, esdat + token->end);
+	}
+	
 	std::string word;
 	
 	// now take chars until it finds a space or unused char
@@ -91,6 +173,12 @@ std::string Context::getWord() {
 	
 	const char * esdat = script->data;
 	
+	const Token * token = findToken(*script, pos);
+	if(token) {
+		pos = token->end;
+		return std::string(esdat + token->start, esdat + token->end);
+	}
+	
 	bool tilde = false; // number of tildes
 	
 	std::string word;
@@ -160,6 +248,12 @@ void Context::skipWord() {
 	
 	skipWhitespace();
 	
+	const Token * token = findToken(*script, pos);
+	if(token) {
+		pos = token->end;
+		return;
+	}
+	
 	const char * esdat = script->data;
 	
 	if(pos != script->size && esdat[pos] == '"') {
@@ -216,6 +310,15 @@ std::string Context::getFlags() {
 }
 
 float Context::getFloat() {
+	
+	skipWhitespace();
+	
+	const Token * token = findToken(*script, pos);
+	if(token && token->literal) {
+		pos = token->end;
+		return token->value;
+	}
+	
 	return getFloatVar(getWord());
 }
 
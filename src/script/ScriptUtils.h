@@ -102,6 +102,13 @@ public:
 	
 	std::string getCommand(bool skipNewlines = true);
 	
+	/*!
+	 * Read the next command name if it is known from the precomputed tokens.
+	 * \return the command or NULL if getCommand() needs to be used instead. In that
+	 *         case only whitespace has been skipped.
+	 */
+	Command * getKnownCommand(bool skipNewlines = true);
+	
 	void skipWhitespace(bool skipNewlines = false);
 	
 	inline Entity * getEntity() const { return entity; }
@@ -162,6 +169,15 @@ public:
 	inline long getEntityFlags() const { return entityFlags; }
 };
 
+/*!
+ * Find tokens that can be read without further processing and resolve command names.
+ * Only commands registered before this is called are resolved - see \ref ScriptEvent::init().
+ */
+void tokenize(EERIE_SCRIPT & es);
+
+//! \return the precomputed token starting at pos or NULL
+const Token * findToken(const EERIE_SCRIPT & es, size_t pos);
+
 bool isSuppressed(const Context & context, const std::string & command);
 
 bool isBlockEndSuprressed(const Context & context, const std::string & command);
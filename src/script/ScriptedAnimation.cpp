@@ -259,40 +259,32 @@ public:
 		
 		if(execute) {
 			
-			std::string timername = "anim_" + ARX_SCRIPT_Timer_GetDefaultName();
-			long num2 = ARX_SCRIPT_Timer_GetFree();
-			if(num2 < 0) {
-				ScriptError << "no free timer";
-				return Failed;
-			}
-			
 			size_t pos = context.skipCommand();
 			if(pos == size_t(-1)) {
 				ScriptWarning << "used -e flag without command to execute";
 				return Success;
 			}
 			
-			scr_timer[num2].reset();
-			ActiveTimers++;
-			scr_timer[num2].es = context.getScript();
-			scr_timer[num2].exist = 1;
-			scr_timer[num2].io = context.getEntity();
-			scr_timer[num2].msecs = 1000.f;
+			std::string timername = "anim_" + ARX_SCRIPT_Timer_GetDefaultName();
+			SCR_TIMER * st = createScriptTimer(context.getEntity(), timername);
+			if(!st) {
+				ScriptError << "no free timer";
+				return Failed;
+			}
+			
+			st->es = context.getScript();
+			st->msecs = 1000.f;
 			// Don't assume that we successfully set the animation - use the current animation
 			if(layer.cur_anim) {
 				arx_assert(layer.altidx_cur >= 0 && layer.altidx_cur < layer.cur_anim->alt_nb);
-				if(layer.cur_anim->anims[layer.altidx_cur]->anim_time > scr_timer[num2].msecs) {
-					scr_timer[num2].msecs = layer.cur_anim->anims[layer.altidx_cur]->anim_time;
+				if(layer.cur_anim->anims[layer.altidx_cur]->anim_time > st->msecs) {
+					st->msecs = layer.cur_anim->anims[layer.altidx_cur]->anim_time;
 				}
 			}
-			scr_timer[num2].name = timername;
-			scr_timer[num2].pos = pos;
-			scr_timer[num2].tim = (unsigned long)(arxtime);
-			scr_timer[num2].times = 1;
-			scr_timer[num2].longinfo = 0;
+			st->pos = pos;
+			st->times = 1;
 			
-			DebugScript(": scheduled timer #" << num2 << ' ' << timername << " in "
-			            << scr_timer[num2].msecs << "ms");
+			DebugScript(": scheduled timer " << timername << " in " << st->msecs << "ms");
 			
 		}
 		
@@ -879,23 +879,18 @@ void timerCommand(const std::string & timer, Context & context) {
 	
 	size_t pos = context.skipCommand();
 	
-	long num = ARX_SCRIPT_Timer_GetFree();
-	if(num == -1) {
+	SCR_TIMER * st = createScriptTimer(io, timername);
+	if(!st) {
 		ScriptError << "no free timer available";
 		return;
 	}
 	
-	ActiveTimers++;
-	scr_timer[num].es = context.getScript();
-	scr_timer[num].exist = 1;
-	scr_timer[num].io = io;
-	scr_timer[num].msecs = millisecons;
-	scr_timer[num].name = timername;
-	scr_timer[num].pos = pos;
-	scr_timer[num].tim = (unsigned long)(arxtime);
-	scr_timer[num].times = count;
-	
-	scr_timer[num].flags = (idle && io) ? 1 : 0;
+	st->es = context.getScript();
+	st->msecs = millisecons;
+	st->pos = pos;
+	st->times = count;
+	
+	st->flags = (idle && io) ? 1 : 0;
 	
 }
 
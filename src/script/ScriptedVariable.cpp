@@ -269,24 +269,6 @@ class UnsetCommand : public Command {
 		return (c == '$' || c == '#' || c == '&');
 	}
 	
-	// TODO move to variable context
-	static bool UNSETVar(SCRIPT_VARIABLES& svf, const std::string & name) {
-		
-		SCRIPT_VARIABLES::iterator it;
-		for(it = svf.begin(); it != svf.end(); ++it) {
-			if(it->type != 0 && name == it->name) {
-				break;
-			}
-		}
-		
-		if(it == svf.end())
-			return false;
-		
-		svf.erase(it);
-		
-		return true;
-	}
-	
 public:
 	
 	UnsetCommand() : Command("unset") { }
@@ -303,9 +285,9 @@ public:
 		}
 		
 		if(isGlobal(var[0])) {
-			UNSETVar(svar, var);
+			svar.erase(var);
 		} else {
-			UNSETVar(context.getMaster()->lvar, var);
+			context.getMaster()->lvar.erase(var);
 		}
 		
 		return Success;
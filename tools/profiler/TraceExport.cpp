@@ -0,0 +1,163 @@
+/*
+ * Copyright 2014 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <istream>
+
+#include "io/fs/FilePath.h"
+#include "io/fs/FileStream.h"
+#include "io/log/Logger.h"
+#include "platform/profiler/ProfilerDataFormat.h"
+#include "platform/profiler/ProfilerTrace.h"
+
+template <class T>
+static bool readItem(std::istream & in, T & item) {
+	return in.read(reinterpret_cast<char *>(&item), sizeof(T)).gcount() == std::streamsize(sizeof(T));
+}
+
+//! Convert a chunked profiler log, \return false if the log contains unknown chunks
+static bool convertChunks(std::istream & in, ProfilerTraceWriter & trace) {
+	
+	// Read chunks until the end of the file - the log may have been cut short
+	SavedProfilerChunkHeader chunk;
+	while(readItem(in, chunk)) {
+		for(u64 i = 0; i < chunk.size; i++) {
+			if(chunk.type == ProfilerChunk_Threads) {
+				SavedThreadInfo saved;
+				if(!readItem(in, saved)) {
+					return true;
+				}
+				trace.addThread(saved);
+			} else if(chunk.type == ProfilerChunk_Points) {
+				SavedProfilePoint saved;
+				if(!readItem(in, saved)) {
+					return true;
+				}
+				trace.addPoint(saved);
+			} else if(chunk.type == ProfilerChunk_Frames) {
+				SavedProfilerFrame saved;
+				if(!readItem(in, saved)) {
+					return true;
+				}
+				trace.addFrame(saved);
+			} else if(chunk.type == ProfilerChunk_Counters) {
+				SavedProfilerCounter saved;
+				if(!readItem(in, saved)) {
+					return true;
+				}
+				trace.addCounter(saved);
+			} else if(chunk.type == ProfilerChunk_Memory) {
+				SavedProfilerMemoryEvent saved;
+				if(!readItem(in, saved)) {
+					return true;
+				}
+				trace.addMemoryEvent(saved);
+			} else {
+				LogError << "Unknown profiler chunk type " << chunk.type;
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+//! Convert a profiler log in the old format without header
+static void convertLegacy(std::istream & in, ProfilerTraceWriter & trace) {
+	
+	SavedThreadInfoHeader threadsHeader;
+	if(!readItem(in, threadsHeader)) {
+		return;
+	}
+	for(u64 i = 0; i < threadsHeader.size; i++) {
+		SavedThreadInfo saved;
+		if(!readItem(in, saved)) {
+			return;
+		}
+		trace.addThread(saved);
+	}
+	
+	SavedProfilePointHeader pointsHeader;
+	if(!readItem(in, pointsHeader)) {
+		return;
+	}
+	for(u64 i = 0; i < pointsHeader.size; i++) {
+		SavedProfilePoint saved;
+		if(!readItem(in, saved)) {
+			return;
+		}
+		trace.addPoint(saved);
+	}
+}
+
+static void printHelp() {
+	printf("usage: arxprofexport <perffile> [<jsonfile>]\n");
+	printf("Convert a profiler log to the Chrome trace event format.\n");
+	printf("If no output file is given, the extension of the log is replaced with .json\n");
+}
+
+int main(int argc, char ** argv) {
+	
+	Logger::initialize();
+	
+	if(argc < 2 || argc > 3 || argv[1][0] == '-') {
+		printHelp();
+		return 1;
+	}
+	
+	fs::path input = argv[1];
+	fs::path output = (argc > 2) ? fs::path(argv[2]) : fs::path(input).set_ext("json");
+	
+	fs::ifstream in(input, std::ios::in | std::ios::binary);
+	if(!in.is_open()) {
+		LogError << "Could not open " << input;
+		return 1;
+	}
+	
+	fs::ofstream out(output, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!out.is_open()) {
+		LogError << "Could not open " << output;
+		return 1;
+	}
+	
+	ProfilerTraceWriter trace(out);
+	
+	bool success = true;
+	
+	SavedProfilerHeader header;
+	if(readItem(in, header) && !memcmp(header.magic, profilerMagic, sizeof(header.magic))) {
+		success = convertChunks(in, trace);
+	} else {
+		in.clear();
+		in.seekg(0);
+		convertLegacy(in, trace);
+	}
+	
+	trace.finish();
+	
+	if(!out.good()) {
+		LogError << "Error writing " << output;
+		return 1;
+	}
+	
+	LogInfo << "Wrote " << output;
+	
+	return success ? 0 : 1;
+}
@@ -21,6 +21,8 @@
 
 #include "ui_ArxProfiler.h"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 #include <QDebug>
@@ -36,6 +38,7 @@
 #include <QGraphicsTextItem>
 #include <QGraphicsRectItem>
 #include <QGraphicsItemGroup>
+#include <QPainterPath>
 
 #include "platform/profiler/ProfilerDataFormat.h"
 #include "util/String.h"
@@ -59,6 +62,63 @@ ArxProfiler::~ArxProfiler() {
 	delete ui;
 }
 
+static void loadThreadInfo(ThreadsData & threadsData, const SavedThreadInfo & saved) {
+	ThreadInfo& threadInfo = threadsData[saved.threadId].info;
+	threadInfo.threadId = saved.threadId;
+	threadInfo.threadName = QString::fromLatin1(util::loadString(saved.threadName).c_str());
+	threadInfo.startTime = saved.startTime;
+	threadInfo.endTime = saved.endTime;
+}
+
+static void loadProfilePoint(ThreadsData & threadsData, const SavedProfilePoint & saved) {
+	// TODO: String table ftw
+	ProfilePoint point;
+	point.tag = QString::fromLatin1(util::loadString(saved.tag).c_str());
+	point.threadId = saved.threadId;
+	point.startTime = saved.startTime;
+	point.endTime = saved.endTime;
+	
+	threadsData[point.threadId].profilePoints.push_back(point);
+}
+
+static void loadFrame(ProfileData & data, const SavedProfilerFrame & saved) {
+	FrameMarker marker;
+	marker.time = saved.time;
+	marker.frame = saved.frame;
+	data.frames.push_back(marker);
+}
+
+static void loadCounter(CountersData & counters, const char * name, quint64 time, qint64 value) {
+	CounterSample sample;
+	sample.time = time;
+	sample.value = value;
+	counters[QString::fromLatin1(name)].push_back(sample);
+}
+
+template <class T>
+static bool isEarlier(const T & a, const T & b) {
+	return a.time < b.time;
+}
+
+//! Convert memory events to a running total for each tag
+static void accumulateMemoryEvents(CountersData & counters, CountersData & events) {
+	for(CountersData::iterator it = events.begin(); it != events.end(); ++it) {
+		std::vector<CounterSample> & samples = it->second;
+		std::stable_sort(samples.begin(), samples.end(), isEarlier<CounterSample>);
+		qint64 total = 0;
+		for(size_t i = 0; i < samples.size(); i++) {
+			total += samples[i].value;
+			samples[i].value = total;
+		}
+		counters["Memory: " + it->first].swap(samples);
+	}
+}
+
+template <class T>
+static bool readItem(QFile & file, T & item) {
+	return file.read((char*)&item, sizeof(T)) == qint64(sizeof(T));
+}
+
 void ArxProfiler::openFile() {
 	QString fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "", tr("Ax performance log (*.perf)"));
 	
@@ -67,40 +127,93 @@ void ArxProfiler::openFile() {
 	if(!file.open(QIODevice::ReadOnly))
 		return;
 	
-	threadsData.clear();
+	profileData.threads.clear();
+	profileData.frames.clear();
+	profileData.counters.clear();
 	
-	SavedThreadInfoHeader theadsHeader;
-	file.read((char*)&theadsHeader, sizeof(SavedThreadInfoHeader));
+	ThreadsData & threadsData = profileData.threads;
+	CountersData memoryEvents;
 	
-	for(quint32 i = 0; i < theadsHeader.size; i++) 	{
-		SavedThreadInfo saved;
-		file.read((char*)&saved, sizeof(SavedThreadInfo));
+	SavedProfilerHeader header;
+	if(readItem(file, header) && !memcmp(header.magic, profilerMagic, sizeof(header.magic))) {
 		
-		ThreadInfo& threadInfo = threadsData[saved.threadId].info;
-		threadInfo.threadId = saved.threadId;
-		threadInfo.threadName = QString::fromLatin1(util::loadString(saved.threadName).c_str());
-		threadInfo.startTime = saved.startTime;
-		threadInfo.endTime = saved.endTime;
-	}
-	
-	SavedProfilePointHeader pointsHeader;
-	file.read((char*)&pointsHeader, sizeof(SavedProfilePointHeader));
-	
-	for(quint32 i = 0; i < pointsHeader.size; i++) {
-		SavedProfilePoint saved;
-		file.read((char*)&saved, sizeof(SavedProfilePoint));
+		// Read chunks until the end of the file - the log may have been cut short
+		SavedProfilerChunkHeader chunk;
+		bool valid = true;
+		while(valid && readItem(file, chunk)) {
+			for(quint64 i = 0; valid && i < chunk.size; i++) {
+				if(chunk.type == ProfilerChunk_Threads) {
+					SavedThreadInfo saved;
+					valid = readItem(file, saved);
+					if(valid) {
+						loadThreadInfo(threadsData, saved);
+					}
+				} else if(chunk.type == ProfilerChunk_Points) {
+					SavedProfilePoint saved;
+					valid = readItem(file, saved);
+					if(valid) {
+						loadProfilePoint(threadsData, saved);
+					}
+				} else if(chunk.type == ProfilerChunk_Frames) {
+					SavedProfilerFrame saved;
+					valid = readItem(file, saved);
+					if(valid) {
+						loadFrame(profileData, saved);
+					}
+				} else if(chunk.type == ProfilerChunk_Counters) {
+					SavedProfilerCounter saved;
+					valid = readItem(file, saved);
+					if(valid) {
+						std::string name = util::loadString(saved.name);
+						loadCounter(profileData.counters, name.c_str(), saved.time, saved.value);
+					}
+				} else if(chunk.type == ProfilerChunk_Memory) {
+					SavedProfilerMemoryEvent saved;
+					valid = readItem(file, saved);
+					if(valid) {
+						std::string tag = util::loadString(saved.tag);
+						loadCounter(memoryEvents, tag.c_str(), saved.time, saved.size);
+					}
+				} else {
+					qWarning() << "Unknown profiler chunk type" << chunk.type;
+					valid = false;
+				}
+			}
+		}
+		
+	} else {
+		
+		// Old format without header
+		file.seek(0);
+		
+		SavedThreadInfoHeader theadsHeader;
+		file.read((char*)&theadsHeader, sizeof(SavedThreadInfoHeader));
+		
+		for(quint32 i = 0; i < theadsHeader.size; i++) 	{
+			SavedThreadInfo saved;
+			file.read((char*)&saved, sizeof(SavedThreadInfo));
+			loadThreadInfo(threadsData, saved);
+		}
 		
-		// TODO: String table ftw
-		ProfilePoint point;
-		point.tag = QString::fromLatin1(util::loadString(saved.tag).c_str());
-		point.threadId = saved.threadId;
-		point.startTime = saved.startTime;
-		point.endTime = saved.endTime;
+		SavedProfilePointHeader pointsHeader;
+		file.read((char*)&pointsHeader, sizeof(SavedProfilePointHeader));
 		
-		threadsData[point.threadId].profilePoints.push_back(point);
+		for(quint32 i = 0; i < pointsHeader.size; i++) {
+			SavedProfilePoint saved;
+			file.read((char*)&saved, sizeof(SavedProfilePoint));
+			loadProfilePoint(threadsData, saved);
+		}
+		
+	}
+	
+	// Points from different threads are written in separate chunks
+	std::stable_sort(profileData.frames.begin(), profileData.frames.end(), isEarlier<FrameMarker>);
+	for(CountersData::iterator it = profileData.counters.begin(); it != profileData.counters.end(); ++it) {
+		std::stable_sort(it->second.begin(), it->second.end(), isEarlier<CounterSample>);
 	}
+	accumulateMemoryEvents(profileData.counters, memoryEvents);
 	
-	view->setData(&threadsData);
+	view->setData(&profileData);
 }
 
 
@@ -151,6 +264,8 @@ private:
 
 const quint32 ITEM_HEIGHT = 15;
 const quint32 THREAD_SPACING = 50;
+const quint32 COUNTER_HEIGHT = 60;
+const quint32 COUNTER_SPACING = 30;
 
 ProfilerView::ProfilerView(QWidget* parent)
 	: QGraphicsView(parent)
@@ -172,12 +287,12 @@ ProfilerView::ProfilerView(QWidget* parent)
 	setFont(font);
 }
 
-void ProfilerView::setData(ThreadsData * data) {
+void ProfilerView::setData(ProfileData * data) {
 	
 	quint64 firstTimestamp = std::numeric_limits<quint64>::max();
 	quint64 lastTimestamp = std::numeric_limits<quint64>::min();
 	
-	for(ThreadsData::const_iterator it = data->begin(); it != data->end(); ++it) {
+	for(ThreadsData::const_iterator it = data->threads.begin(); it != data->threads.end(); ++it) {
 		
 		if(it->second.profilePoints.empty()) {
 			continue;
@@ -192,6 +307,16 @@ void ProfilerView::setData(ThreadsData * data) {
 		}
 	}
 	
+	if(!data->frames.empty()) {
+		firstTimestamp = std::min(firstTimestamp, data->frames.front().time);
+		lastTimestamp = std::max(lastTimestamp, data->frames.back().time);
+	}
+	
+	for(CountersData::const_iterator it = data->counters.begin(); it != data->counters.end(); ++it) {
+		firstTimestamp = std::min(firstTimestamp, it->second.front().time);
+		lastTimestamp = std::max(lastTimestamp, it->second.back().time);
+	}
+	
 	m_scene->clear();
 	
 	// reverse iterate
@@ -200,7 +325,7 @@ void ProfilerView::setData(ThreadsData * data) {
 	QPen profilePointPen(Qt::black);
 	profilePointPen.setCosmetic(true);
 	
-	for(ThreadsData::iterator it = data->begin(); it != data->end(); ++it) {
+	for(ThreadsData::iterator it = data->threads.begin(); it != data->threads.end(); ++it) {
 		ThreadData& threadData = it->second;
 		
 		QGraphicsItemGroup * group = new QGraphicsItemGroup();
@@ -252,6 +377,56 @@ void ProfilerView::setData(ThreadsData * data) {
 		nextPos += threadData.maxDepth * ITEM_HEIGHT + THREAD_SPACING;
 	}
 	
+	// Counters are drawn as step graphs below the threads
+	
+	QPen counterPen(QColor(0, 0, 128));
+	counterPen.setCosmetic(true);
+	
+	m_counterLabels.clear();
+	
+	for(CountersData::const_iterator it = data->counters.begin(); it != data->counters.end(); ++it) {
+		const std::vector<CounterSample> & samples = it->second;
+		
+		qint64 minValue = std::numeric_limits<qint64>::max();
+		qint64 maxValue = std::numeric_limits<qint64>::min();
+		for(size_t i = 0; i < samples.size(); i++) {
+			minValue = std::min(minValue, samples[i].value);
+			maxValue = std::max(maxValue, samples[i].value);
+		}
+		qreal range = (maxValue > minValue) ? qreal(maxValue - minValue) : qreal(1);
+		
+		qreal top = nextPos + ITEM_HEIGHT;
+		
+		QPainterPath path;
+		for(size_t i = 0; i < samples.size(); i++) {
+			qreal x = samples[i].time - firstTimestamp;
+			qreal y = top + COUNTER_HEIGHT * (1 - (samples[i].value - minValue) / range);
+			if(i == 0) {
+				path.moveTo(x, y);
+			} else {
+				path.lineTo(x, path.currentPosition().y());
+				path.lineTo(x, y);
+			}
+		}
+		m_scene->addPath(path, counterPen);
+		
+		m_counterLabels.push_back(QString("%1 (%2 - %3)").arg(it->first).arg(minValue).arg(maxValue));
+		
+		nextPos += ITEM_HEIGHT + COUNTER_HEIGHT + COUNTER_SPACING;
+	}
+	
+	// Frame boundaries span all threads and counters
+	
+	QPen framePen(QColor(80, 80, 80));
+	framePen.setCosmetic(true);
+	framePen.setStyle(Qt::DotLine);
+	
+	for(std::vector<FrameMarker>::const_iterator it = data->frames.begin(); it != data->frames.end(); ++it) {
+		qreal x = it->time - firstTimestamp;
+		QGraphicsLineItem * line = m_scene->addLine(x, 0, x, nextPos, framePen);
+		line->setZValue(-1);
+	}
+	
 	setSceneRect(0, 0, lastTimestamp - firstTimestamp, nextPos);
 
 	scale(size().width() / (qreal)(lastTimestamp - firstTimestamp), 1.0);
@@ -274,7 +449,7 @@ void ProfilerView::paintEvent(QPaintEvent * event) {
 	
 	int nextY = 5;
 	
-	for(ThreadsData::iterator it = m_data->begin(); it != m_data->end(); ++it) {
+	for(ThreadsData::iterator it = m_data->threads.begin(); it != m_data->threads.end(); ++it) {
 		ThreadData& threadData = it->second;
 		
 		painter.drawLine(QPointF(0, nextY), QPointF(viewport()->width(), nextY));
@@ -283,6 +458,14 @@ void ProfilerView::paintEvent(QPaintEvent * event) {
 		nextY += threadData.maxDepth * ITEM_HEIGHT + THREAD_SPACING;
 	}
 	
+	for(size_t i = 0; i < m_counterLabels.size(); i++) {
+		
+		painter.drawLine(QPointF(0, nextY), QPointF(viewport()->width(), nextY));
+		painter.drawText(QPointF(0, nextY + 14), m_counterLabels[i]);
+		
+		nextY += ITEM_HEIGHT + COUNTER_HEIGHT + COUNTER_SPACING;
+	}
+	
 	painter.end();
 }
 
@@ -24,6 +24,7 @@
 #include <QGraphicsView>
 
 #include <map>
+#include <vector>
 
 struct ProfilePoint {
 	QString tag;
@@ -55,13 +56,31 @@ struct ThreadData {
 
 typedef std::map<quint64, ThreadData> ThreadsData;
 
+struct FrameMarker {
+	quint64 time;
+	quint64 frame;
+};
+
+struct CounterSample {
+	quint64 time;
+	qint64  value;
+};
+
+typedef std::map<QString, std::vector<CounterSample> > CountersData;
+
+struct ProfileData {
+	ThreadsData                threads;
+	std::vector<FrameMarker>   frames;
+	CountersData               counters; //!< Includes running totals of memory events
+};
+
 class ProfilerView : public QGraphicsView {
 	Q_OBJECT
 
 public:
 	ProfilerView(QWidget* parent = NULL);
 	
-	void setData(ThreadsData * data);
+	void setData(ProfileData * data);
 	
 protected:
 	void paintEvent(QPaintEvent *event);
@@ -70,8 +89,9 @@ protected:
 	virtual void keyPressEvent(QKeyEvent* event);
 	
 private:
-	ThreadsData * m_data;
+	ProfileData * m_data;
 	QGraphicsScene * m_scene;
+	std::vector<QString> m_counterLabels;
 	
 	QPointF viewCenter() const;
 	void zoomEvent(QPoint mousePos, bool zoomIn);
@@ -96,7 +116,7 @@ private:
 	Ui::ArxProfilerClass * ui;
 	ProfilerView * view;
 	
-	ThreadsData threadsData;
+	ProfileData profileData;
 };
 
 #endif // ARX_TOOLS_PROFILER_UI_ARXPROFILER_H
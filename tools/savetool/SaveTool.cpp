@@ -17,6 +17,7 @@
  * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
 #include <iostream>
 
 #include "io/SaveBlock.h"
@@ -60,15 +61,20 @@ static int main_extract(SaveBlock & save, int argc, char ** argv) {
 	for(vector<string>::iterator file = files.begin(); file != files.end(); ++file) {
 		
 		size_t size;
-		char * data = save.load(*file, size);
+		char * buffer = NULL;
+		const char * data = save.loadBorrowed(*file, size);
 		if(!data) {
-			cerr << "error loading " << *file << " from save" << endl;
-			continue;
+			data = buffer = save.load(*file, size);
+			if(!data) {
+				cerr << "error loading " << *file << " from save" << endl;
+				continue;
+			}
 		}
 		
 		fs::ofstream h(*file, std::ios_base::out | std::ios_base::binary);
 		if(!h.is_open()) {
 			cerr << "error opening " << *file << " for writing" << endl;
+			free(buffer);
 			continue;
 		}
 		
@@ -76,6 +82,7 @@ static int main_extract(SaveBlock & save, int argc, char ** argv) {
 			cerr << "error writing to " << *file << endl;
 		}
 		
+		free(buffer);
 	}
 	
 	return 0;
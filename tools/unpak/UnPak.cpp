@@ -22,7 +22,12 @@
 #include <cstdlib>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
+#include "io/Blast.h"
 #include "io/fs/FilePath.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/FileStream.h"
@@ -30,72 +35,338 @@
 #include "io/resource/PakEntry.h"
 #include "io/resource/ResourcePath.h"
 #include "io/log/Logger.h"
+#include "io/log/LogBackend.h"
+#include "platform/ThreadPool.h"
+#include "platform/Time.h"
 
 using std::transform;
 using std::ostringstream;
 using std::string;
 
-static void dump(PakDirectory & dir, const fs::path & dirname = fs::path()) {
+namespace {
+
+//! Counts errors reported by the resource code, such as corrupted compressed data.
+class ErrorCounter : public logger::Backend {
 	
-	fs::create_directories(dirname);
+public:
 	
-	for(PakDirectory::files_iterator i = dir.files_begin(); i != dir.files_end(); ++i) {
-		
-		fs::path filename = dirname / i->first;
+	size_t errors;
+	
+	ErrorCounter() : errors(0) { }
+	
+	void log(const logger::Source & file, int line, Logger::LogLevel level,
+	         const std::string & str) {
+		ARX_UNUSED(file), ARX_UNUSED(line), ARX_UNUSED(str);
+		if(level >= Logger::Error) {
+			errors++;
+		}
+	}
+	
+};
+
+/*!
+ * Decompress a single file and write it to disk.
+ *
+ * Each job only keeps the file it is working on in memory, so at most one file per
+ * worker thread is buffered at any time.
+ */
+class ExtractJob : public ThreadPool::Job {
+	
+	PakFile * file;
+	
+public:
+	
+	enum Status {
+		Success,
+		OpenFailed,
+		WriteFailed
+	};
+	
+	fs::path filename;
+	bool write;
+	
+	u64 time; //!< Time spent decompressing and writing the file in microseconds
+	Status status;
+	
+	ExtractJob(PakFile * _file, const fs::path & _filename, bool _write)
+		: file(_file), filename(_filename), write(_write), time(0), status(Success) { }
+	
+	size_t size() const { return file->size(); }
+	
+	void run() {
 		
-		PakFile * file = i->second;
+		u64 start = platform::getTimeUs();
 		
-		printf("%s\n", filename.string().c_str());
+		char * data = (file->size() > 0) ? file->readAlloc() : NULL;
 		
-		fs::ofstream ofs(filename, fs::fstream::out | fs::fstream::binary | fs::fstream::trunc);
-		if(!ofs.is_open()) {
-			printf("error opening file for writing: %s\n", filename.string().c_str());
-			exit(1);
+		if(write) {
+			fs::ofstream ofs(filename, fs::fstream::out | fs::fstream::binary | fs::fstream::trunc);
+			if(!ofs.is_open()) {
+				status = OpenFailed;
+			} else if(data && ofs.write(data, file->size()).fail()) {
+				status = WriteFailed;
+			}
 		}
 		
-		if(file->size() > 0) {
-			
-			char * data = (char*)file->readAlloc();
-			arx_assert(data != NULL);
+		free(data);
+		
+		time = platform::getElapsedUs(start);
+	}
+	
+};
+
+} // anonymous namespace
+
+/*!
+ * Collect jobs for all files in a directory and create the output directories.
+ */
+static void collect(PakDirectory & dir, std::vector<ExtractJob *> & jobs, bool write,
+                    const fs::path & dirname = fs::path()) {
+	
+	if(write) {
+		fs::create_directories(dirname);
+	}
+	
+	for(PakDirectory::files_iterator i = dir.files_begin(); i != dir.files_end(); ++i) {
+		jobs.push_back(new ExtractJob(i->second, dirname / i->first, write));
+	}
+	
+	for(PakDirectory::dirs_iterator i = dir.dirs_begin(); i != dir.dirs_end(); ++i) {
+		collect(i->second, jobs, write, dirname / i->first);
+	}
+	
+}
+
+struct ExtractResult {
+	
+	size_t files;
+	size_t bytes;
+	u64 time;
+	
+	ExtractResult() : files(0), bytes(0), time(0) { }
+	
+};
+
+static double throughput(size_t bytes, u64 time) {
+	return time ? double(bytes) / double(time) : 0.0; // bytes per microsecond = MB/s
+}
+
+/*!
+ * Decompress all files in a PAK archive on the worker threads.
+ * Results are reported in the original order as they become available.
+ * \return false if a file could not be written - remaining files are skipped.
+ */
+static bool extract(PakDirectory & pak, ThreadPool & pool, bool write,
+                    ExtractResult & result) {
+	
+	u64 start = platform::getTimeUs();
+	
+	std::vector<ExtractJob *> jobs;
+	collect(pak, jobs, write);
+	
+	for(size_t i = 0; i < jobs.size(); i++) {
+		pool.submit(jobs[i]);
+	}
+	
+	for(size_t i = 0; i < jobs.size(); i++) {
+		
+		ExtractJob & job = *jobs[i];
+		job.wait();
+		
+		printf("%s  %lu bytes  %.2f ms  %.1f MB/s\n", job.filename.string().c_str(),
+		       (unsigned long)job.size(), double(job.time) / 1000.0,
+		       throughput(job.size(), job.time));
+		
+		if(job.status != ExtractJob::Success) {
 			
-			if(ofs.write(data, file->size()).fail()) {
-				printf("error writing to file: %s\n", filename.string().c_str());
-				exit(1);
+			if(job.status == ExtractJob::OpenFailed) {
+				printf("error opening file for writing: %s\n", job.filename.string().c_str());
+			} else {
+				printf("error writing to file: %s\n", job.filename.string().c_str());
 			}
 			
-			free(data);
+			// Don't leave jobs behind that are still running on the worker threads
+			delete jobs[i];
+			for(size_t j = i + 1; j < jobs.size(); j++) {
+				if(!pool.cancel(jobs[j])) {
+					jobs[j]->wait();
+				}
+				delete jobs[j];
+			}
 			
+			return false;
+		}
+		
+		result.files++;
+		result.bytes += job.size();
+		
+		delete jobs[i];
+	}
+	
+	result.time += platform::getElapsedUs(start);
+	
+	return true;
+}
+
+struct BenchmarkResult {
+	
+	size_t files;
+	size_t bytes;
+	u64 referenceTime;
+	u64 tableTime;
+	size_t mismatches;
+	
+	BenchmarkResult() : files(0), bytes(0), referenceTime(0), tableTime(0),
+	                    mismatches(0) { }
+	
+};
+
+static char * timedRead(PakFile * file, bool reference, u64 & time) {
+	
+	blastUseReferenceDecoder(reference);
+	
+	u64 start = platform::getTimeUs();
+	char * data = file->readAlloc();
+	time += platform::getElapsedUs(start);
+	
+	return data;
+}
+
+/*!
+ * Decompress all files with both the reference and the table-driven decoder and
+ * compare the results. Files that are not compressed are skipped.
+ */
+static void benchmark(PakDirectory & dir, BenchmarkResult & result,
+                      const fs::path & dirname = fs::path()) {
+	
+	for(PakDirectory::files_iterator i = dir.files_begin(); i != dir.files_end(); ++i) {
+		
+		PakFile * file = i->second;
+		if(file->size() == 0 || !file->isCompressed()) {
+			continue;
+		}
+		
+		// Read the file once without timing it so that neither decoder pays for
+		// loading the compressed data from disk
+		free(file->readAlloc());
+		
+		char * reference = timedRead(file, true, result.referenceTime);
+		char * table = timedRead(file, false, result.tableTime);
+		
+		if(memcmp(reference, table, file->size()) != 0) {
+			printf("decoder mismatch: %s\n", (dirname / i->first).string().c_str());
+			result.mismatches++;
 		}
 		
+		free(reference);
+		free(table);
+		
+		result.files++;
+		result.bytes += file->size();
 	}
 	
 	for(PakDirectory::dirs_iterator i = dir.dirs_begin(); i != dir.dirs_end(); ++i) {
-		dump(i->second, dirname / i->first);
+		benchmark(i->second, result, dirname / i->first);
 	}
 	
 }
 
+static void printHelp() {
+	printf("usage: arxunpak [<options>] <pakfile> [<pakfile>...]\n");
+	printf("options:\n");
+	printf("  --verify       decompress all files without writing them\n");
+	printf("  --benchmark    compare the blast decoders on all compressed files\n");
+	printf("  -j <threads>   number of worker threads (default: one per processor)\n");
+}
+
 int main(int argc, char ** argv) {
 	
 	ARX_UNUSED(resources);
 	
 	Logger::initialize();
 	
-	if(argc < 2) {
-		printf("usage: unpak <pakfile> [<pakfile>...]\n");
+	bool verify = false;
+	bool bench = false;
+	size_t threads = 0;
+	
+	int first = 1;
+	for(; first < argc && argv[first][0] == '-'; first++) {
+		if(!strcmp(argv[first], "--verify")) {
+			verify = true;
+		} else if(!strcmp(argv[first], "--benchmark")) {
+			bench = true;
+		} else if(!strcmp(argv[first], "-j") && first + 1 < argc) {
+			threads = size_t(std::max(atoi(argv[++first]), 1));
+		} else {
+			printHelp();
+			return 1;
+		}
+	}
+	
+	if(argc <= first) {
+		printHelp();
 		return 1;
 	}
 	
-	for(int i = 1; i < argc; i++) {
+	ErrorCounter errors;
+	Logger::add(&errors);
+	
+	// The benchmark decodes on this thread and does not need any workers
+	boost::scoped_ptr<ThreadPool> pool;
+	if(!bench) {
+		pool.reset(new ThreadPool(threads, "unpak"));
+	}
+	
+	ExtractResult result;
+	BenchmarkResult benchResult;
+	
+	for(int i = first; i < argc; i++) {
 		
 		PakReader pak;
 		if(!pak.addArchive(argv[i])) {
 			printf("error opening PAK file\n");
+			Logger::remove(&errors);
 			return 1;
 		}
 		
-		dump(pak);
+		if(bench) {
+			benchmark(pak, benchResult);
+		} else if(!extract(pak, *pool, !verify, result)) {
+			Logger::remove(&errors);
+			return 1;
+		}
 		
 	}
 	
+	Logger::remove(&errors);
+	
+	if(bench) {
+		
+		printf("decompressed %lu files, %.1f MiB\n", (unsigned long)benchResult.files,
+		       double(benchResult.bytes) / (1024 * 1024));
+		printf("reference decoder: %8.1f MB/s\n",
+		       throughput(benchResult.bytes, benchResult.referenceTime));
+		printf("table decoder:     %8.1f MB/s\n",
+		       throughput(benchResult.bytes, benchResult.tableTime));
+		
+		if(benchResult.mismatches) {
+			printf("%lu files differ between decoders\n",
+			       (unsigned long)benchResult.mismatches);
+			return 1;
+		}
+		
+	} else {
+		
+		printf("%s %lu files, %.1f MiB in %.2f s using %lu threads: %.1f MB/s\n",
+		       verify ? "verified" : "extracted", (unsigned long)result.files,
+		       double(result.bytes) / (1024 * 1024), double(result.time) / 1000000.0,
+		       (unsigned long)pool->getThreadCount(), throughput(result.bytes, result.time));
+		
+	}
+	
+	if(errors.errors) {
+		printf("%lu errors\n", (unsigned long)errors.errors);
+		return 1;
+	}
+	
 }